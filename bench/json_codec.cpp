@@ -0,0 +1,286 @@
+// LLMJsonWriter and the in-place response reader against the nlohmann::json document path
+// they replaced: first that they agree, over fixtures/equivalence.jsonl and a writer round
+// trip, then what each costs per request body and per response line.
+//
+// fixtures/lenient.jsonl holds what the reader accepts on purpose and a full parser rejects:
+// a lone surrogate escape, a raw control character in a string, text after the object. A
+// reply is better kept than lost over those.
+//
+//     llmchat_bench_json [Fixtures=<dir>] [Iterations=<n>]
+
+#include "LLMChatJson.h"
+#include "LLMChatStream.h"
+#include "Configuration/Config.h"
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// What the module read from a response object before LLMResponseChunk, the baseline
+struct DomChunk
+{
+    bool parsed = false;
+    std::string text;
+    bool done = false;
+    bool hasError = false;
+    std::string error;
+    bool hasStats = false;
+    LLMGenerationStats stats;
+};
+
+static bool ReadDomStats(nlohmann::json const& document, LLMGenerationStats& stats)
+{
+    auto read = [&document](char const* field, uint64& value)
+    {
+        auto itr = document.find(field);
+        if (itr == document.end() || !itr->is_number_unsigned())
+            return false;
+        value = itr->get<uint64>();
+        return true;
+    };
+
+    bool timed = read("eval_duration", stats.outputNs);
+    read("eval_count", stats.outputTokens);
+    read("prompt_eval_count", stats.promptTokens);
+    read("prompt_eval_duration", stats.promptEvalNs);
+    return timed;
+}
+
+static DomChunk ParseDom(std::string_view line)
+{
+    DomChunk chunk;
+    nlohmann::json document = nlohmann::json::parse(line, nullptr, false);
+    if (document.is_discarded() || !document.is_object())
+        return chunk;
+
+    chunk.parsed = true;
+    if (document.contains("error"))
+    {
+        nlohmann::json const& error = document["error"];
+        chunk.hasError = true;
+        if (error.is_string())
+            chunk.error = error.get<std::string>();
+        else if (error.is_object() && error.contains("message") && error["message"].is_string())
+            chunk.error = error["message"].get<std::string>();
+        else
+            chunk.error = error.dump();
+        return chunk;
+    }
+
+    if (document.contains("response") && document["response"].is_string())
+        chunk.text = document["response"].get<std::string>();
+    else if (document.contains("message") && document["message"].is_object() &&
+        document["message"].contains("content") && document["message"]["content"].is_string())
+        chunk.text = document["message"]["content"].get<std::string>();
+    else if (document.contains("content") && document["content"].is_string())
+        chunk.text = document["content"].get<std::string>();
+    else if (document.contains("choices") && document["choices"].is_array() && !document["choices"].empty())
+    {
+        nlohmann::json const& choice = document["choices"][0];
+        if (choice.contains("delta") && choice["delta"].contains("content") && choice["delta"]["content"].is_string())
+            chunk.text = choice["delta"]["content"].get<std::string>();
+        else if (choice.contains("text") && choice["text"].is_string())
+            chunk.text = choice["text"].get<std::string>();
+    }
+
+    auto flag = [&document](char const* field)
+    {
+        return document.contains(field) && document[field].is_boolean() && document[field].get<bool>();
+    };
+    if (flag("done") || flag("stop"))
+    {
+        chunk.done = true;
+        chunk.hasStats = ReadDomStats(document, chunk.stats);
+    }
+    return chunk;
+}
+
+static DomChunk ParseReader(std::string_view line)
+{
+    DomChunk result;
+    LLMResponseChunk chunk;
+    result.parsed = LLMResponseChunk::Parse(line, chunk, result.text);
+    result.hasError = chunk.hasError;
+    result.error = chunk.error;
+    result.done = chunk.done;
+    result.hasStats = chunk.done && chunk.hasStats;
+    result.stats = chunk.stats;
+    return result;
+}
+
+static bool Same(DomChunk const& a, DomChunk const& b)
+{
+    if (a.parsed != b.parsed)
+        return false;
+    if (!a.parsed)
+        return true;
+    if (a.hasError || b.hasError)
+        return a.hasError == b.hasError && a.error == b.error;
+    if (a.text != b.text || a.done != b.done || a.hasStats != b.hasStats)
+        return false;
+    return !a.hasStats || (a.stats.outputNs == b.stats.outputNs && a.stats.outputTokens == b.stats.outputTokens &&
+        a.stats.promptTokens == b.stats.promptTokens && a.stats.promptEvalNs == b.stats.promptEvalNs);
+}
+
+static bool ReadFile(std::string const& path, std::string& contents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        fmt::print(stderr, "Cannot open {}\n", path);
+        return false;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+static std::vector<std::string> SplitLines(std::string const& text)
+{
+    std::vector<std::string> lines;
+    std::istringstream stream(text);
+    for (std::string line; std::getline(stream, line);)
+        lines.push_back(line);
+    return lines;
+}
+
+// A request body as LLMChatQueue::BuildRequestBody writes it
+static void WriteBody(std::string& body, std::string const& system, std::string const& user)
+{
+    LLMJsonWriter writer(body);
+    writer.BeginObject()
+        .Key("model").String("llama3.2")
+        .Key("system").String(system)
+        .Key("prompt").String(user)
+        .Key("raw").Bool(false)
+        .Key("stream").Bool(true)
+        .Key("options").BeginObject()
+            .Key("temperature").Double(0.7)
+            .Key("num_predict").Uint(100)
+            .Key("stop").BeginArray().String("\n\n").EndArray()
+        .EndObject()
+        .Key("keep_alive").String("30m")
+        .EndObject();
+}
+
+static nlohmann::json BuildDom(std::string const& system, std::string const& user)
+{
+    nlohmann::json body;
+    body["model"] = "llama3.2";
+    body["system"] = system;
+    body["prompt"] = user;
+    body["raw"] = false;
+    body["stream"] = true;
+    nlohmann::json& options = body["options"];
+    options["temperature"] = 0.7;
+    options["num_predict"] = 100;
+    options["stop"] = std::vector<std::string>{ "\n\n" };
+    body["keep_alive"] = "30m";
+    return body;
+}
+
+template <typename Run>
+static void Measure(char const* name, uint32 iterations, Run run)
+{
+    uint64 sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32 i = 0; i < iterations; ++i)
+        sink += run();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+    fmt::print("{:<36} {:>9.0f} ns   ({})\n", name, ns, sink / iterations);
+}
+
+int main(int argc, char** argv)
+{
+    if (!sConfigMgr->ParseArgs(argc, argv))
+        return 1;
+
+    std::string fixtures = sConfigMgr->GetOption<std::string>("Fixtures", LLMCHAT_BENCH_FIXTURES);
+    uint32 iterations = sConfigMgr->GetOption<uint32>("Iterations", 200000);
+
+    std::string corpus, lenient, stream, body;
+    if (!ReadFile(fixtures + "/equivalence.jsonl", corpus) || !ReadFile(fixtures + "/lenient.jsonl", lenient) ||
+        !ReadFile(fixtures + "/generate_stream.ndjson", stream) || !ReadFile(fixtures + "/generate_body.json", body))
+        return 1;
+
+    uint32 differ = 0;
+    std::vector<std::string> lines = SplitLines(corpus);
+    for (std::string const& line : lines)
+    {
+        DomChunk dom = ParseDom(line);
+        DomChunk reader = ParseReader(line);
+        if (Same(dom, reader))
+            continue;
+
+        ++differ;
+        fmt::print("differs: {}\n  dom:    parsed {} text [{}] error [{}] done {}\n  reader: parsed {} text [{}] error [{}] done {}\n",
+            line, dom.parsed, dom.text, dom.error, dom.done, reader.parsed, reader.text, reader.error, reader.done);
+    }
+    fmt::print("{} response objects, {} read differently\n", lines.size(), differ);
+
+    for (std::string const& line : SplitLines(lenient))
+    {
+        if (!ParseDom(line).parsed && ParseReader(line).parsed)
+            continue;
+
+        ++differ;
+        fmt::print("not read leniently: {}\n", line);
+    }
+
+    // Everything the writer has to escape, checked by parsing what it wrote
+    std::string tricky = "quote\" back\\ nl\n tab\t ctl\x01\x1f del\x7f \xC3\xA9 \xF0\x9F\x98\x80 </script>";
+    std::string written;
+    WriteBody(written, tricky, tricky);
+    nlohmann::json parsed = nlohmann::json::parse(written, nullptr, false);
+    bool writerMatches = !parsed.is_discarded() && parsed == BuildDom(tricky, tricky);
+    fmt::print("writer round trip {}\n\n", writerMatches ? "matches" : "DIFFERS");
+    if (!writerMatches)
+        ++differ;
+
+    // A 1500 character system prompt and a 250 character message, like the built-in templates
+    std::string system(1500, 'x'), user(250, 'y');
+    for (size_t i = 0; i < system.size(); i += 7)
+        system[i] = ' ';
+    system[700] = '\n';
+    user[100] = '"';
+
+    Measure("request body, nlohmann", iterations, [&] { return BuildDom(system, user).dump().size(); });
+    Measure("request body, writer", iterations, [&]
+    {
+        std::string out;
+        out.reserve(system.size() + user.size() + 256);
+        WriteBody(out, system, user);
+        return out.size();
+    });
+
+    std::vector<std::string> streamLines = SplitLines(stream);
+    std::string const& tokenLine = streamLines.front();
+    std::string const& finalLine = streamLines.back();
+    Measure("token line, nlohmann", iterations, [&] { return ParseDom(tokenLine).text.size(); });
+    Measure("token line, reader", iterations, [&] { return ParseReader(tokenLine).text.size(); });
+    Measure("final line with context, nlohmann", iterations / 10, [&] { return ParseDom(finalLine).stats.outputTokens; });
+    Measure("final line with context, reader", iterations / 10, [&] { return ParseReader(finalLine).stats.outputTokens; });
+    Measure("whole stream, nlohmann per line", iterations / 20, [&]
+    {
+        uint64 size = 0;
+        for (std::string const& line : streamLines)
+            size += ParseDom(line).text.size();
+        return size;
+    });
+    Measure("whole stream, decoder", iterations / 20, [&]
+    {
+        LLMChatStreamDecoder decoder;
+        std::string text;
+        decoder.Feed(stream, text);
+        decoder.Finish(text);
+        return text.size();
+    });
+    Measure("non-streamed body, nlohmann", iterations / 10, [&] { return ParseDom(body).text.size(); });
+    Measure("non-streamed body, reader", iterations / 10, [&] { return ParseReader(body).text.size(); });
+    return differ ? 1 : 0;
+}
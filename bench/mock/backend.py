@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Stand-in for an LLM server, for the engine drivers and for trying the module without a
+model. Answers every POST with a fixed reply after a delay: in the Ollama format, or the
+OpenAI one when the path ends in /chat/completions; whole or streamed, as the request's
+"stream" asks. GET /api/tags, /api/ps and /v1/models answer the warmup probes. Optionally
+serves HTTPS and requires a bearer token."""
+
+import argparse
+import json
+import random
+import ssl
+import sys
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+REPLY = "Well met! The road to Goldshire is long, but the inn there is worth it."
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    options = None
+
+    def do_GET(self):
+        if not self.authorized():
+            return
+        if self.path.startswith("/api/tags"):
+            self.send_json(200, {"models": [{"name": "mock"}]})
+        elif self.path.startswith("/api/ps"):
+            self.send_json(200, {"models": []})
+        elif self.path.startswith("/v1/models"):
+            self.send_json(200, {"object": "list", "data": [{"id": "mock", "object": "model"}]})
+        else:
+            self.send_json(404, {"error": "not found"})
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        try:
+            request = json.loads(self.rfile.read(length) or b"{}")
+        except ValueError:
+            self.send_json(400, {"error": "request body is not JSON"})
+            return
+        if not self.authorized():
+            return
+
+        options = Handler.options
+        openai = self.path.split("?")[0].endswith("/chat/completions")
+        time.sleep(options.delay + random.uniform(0, options.jitter))
+        if random.random() < options.error_rate:
+            self.send_json(500, {"error": {"message": "mock failure"}} if openai else {"error": "mock failure"})
+        elif request.get("stream", not openai):
+            self.send_stream(openai)
+        elif openai:
+            self.send_json(200, {"object": "chat.completion", "model": "mock",
+                                 "choices": [{"index": 0, "finish_reason": "stop",
+                                              "message": {"role": "assistant", "content": REPLY}}]})
+        else:
+            self.send_json(200, {"model": "mock", "response": REPLY, "done": True,
+                                 "eval_count": len(REPLY.split()), "eval_duration": 1000000})
+
+    def authorized(self):
+        key = Handler.options.api_key
+        if key and self.headers.get("Authorization") != "Bearer " + key:
+            self.send_json(401, {"error": {"message": "invalid api key"}})
+            return False
+        return True
+
+    def send_json(self, status, document):
+        body = json.dumps(document).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def send_stream(self, openai):
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream" if openai else "application/x-ndjson")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+
+        words = REPLY.split(" ")
+        for i, word in enumerate(words):
+            piece = word if i == 0 else " " + word
+            if openai:
+                self.send_event({"object": "chat.completion.chunk",
+                                 "choices": [{"index": 0, "delta": {"content": piece}, "finish_reason": None}]})
+            else:
+                self.send_chunk(json.dumps({"model": "mock", "response": piece, "done": False}) + "\n")
+            time.sleep(Handler.options.token_delay)
+
+        if openai:
+            self.send_event({"object": "chat.completion.chunk",
+                             "choices": [{"index": 0, "delta": {}, "finish_reason": "stop"}]})
+            self.send_chunk("data: [DONE]\n\n")
+        else:
+            self.send_chunk(json.dumps({"model": "mock", "response": "", "done": True,
+                                        "eval_count": len(words), "eval_duration": 1000000}) + "\n")
+        self.wfile.write(b"0\r\n\r\n")
+        self.wfile.flush()
+
+    def send_event(self, document):
+        self.send_chunk("data: " + json.dumps(document) + "\n\n")
+
+    def send_chunk(self, text):
+        data = text.encode()
+        self.wfile.write(b"%x\r\n%s\r\n" % (len(data), data))
+        self.wfile.flush()
+
+    def log_message(self, *args):
+        pass
+
+
+class Server(ThreadingHTTPServer):
+    daemon_threads = True
+
+    def handle_error(self, request, client_address):
+        # The module drops idle pooled connections and cancels requests by closing the socket
+        if not isinstance(sys.exc_info()[1], (ConnectionResetError, BrokenPipeError, ssl.SSLError)):
+            super().handle_error(request, client_address)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("port", type=int)
+    parser.add_argument("--delay", type=float, default=0.2, help="seconds before the reply starts")
+    parser.add_argument("--jitter", type=float, default=0.0, help="up to this many seconds more, at random")
+    parser.add_argument("--error-rate", type=float, default=0.0, help="share of requests answered with a 500")
+    parser.add_argument("--token-delay", type=float, default=0.02, help="seconds between streamed tokens")
+    parser.add_argument("--api-key", help="answer 401 unless sent 'Authorization: Bearer <key>'")
+    parser.add_argument("--tls-cert", help="serve HTTPS with this certificate chain (PEM)")
+    parser.add_argument("--tls-key", help="private key of --tls-cert")
+    options = parser.parse_args()
+
+    Handler.options = options
+    server = Server(("127.0.0.1", options.port), Handler)
+    if options.tls_cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(options.tls_cert, options.tls_key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Routing scenario: a fast backend, a slow one and one that is down, once per balancer
+# strategy. The fast one has to end up with most of the traffic every time.
+#
+#     mock/routing.sh <path to llmchat_bench_routing> [Key=Value ...]
+
+set -e
+
+driver="$1"
+shift
+here="$(cd "$(dirname "$0")" && pwd)"
+
+python3 "$here/backend.py" 18101 --delay 0.05 &
+fast=$!
+python3 "$here/backend.py" 18102 --delay 0.4 &
+slow=$!
+trap 'kill $fast $slow 2>/dev/null' EXIT
+sleep 1
+
+# Nothing listens on 18103
+endpoints="http://127.0.0.1:18101/api/generate|fast|1, http://127.0.0.1:18102/api/generate|slow|1, http://127.0.0.1:18103/api/generate|down|1"
+
+for strategy in least-outstanding ewma; do
+    "$driver" "LLMChat.Endpoints=$endpoints" "LLMChat.Balancer.Strategy=$strategy" Expect=fast "$@"
+    echo
+done
@@ -0,0 +1,43 @@
+#!/bin/sh
+# HTTPS scenario: an OpenAI-compatible backend behind TLS with a certificate from a throwaway
+# CA, requiring a bearer token. Requests must succeed with the CA in LLMChat.Tls.CaFile and
+# LLMChat.ApiKey set, and fail with either missing.
+#
+#     mock/tls.sh <path to llmchat_bench_routing> [Key=Value ...]
+
+set -e
+
+driver="$1"
+shift
+here="$(cd "$(dirname "$0")" && pwd)"
+certs="$(mktemp -d)"
+
+openssl req -x509 -newkey rsa:2048 -nodes -days 2 -subj "/CN=mod-llm-chat test CA" \
+    -keyout "$certs/ca.key" -out "$certs/ca.pem" 2>/dev/null
+openssl req -newkey rsa:2048 -nodes -subj "/CN=localhost" \
+    -keyout "$certs/server.key" -out "$certs/server.csr" 2>/dev/null
+printf 'subjectAltName=DNS:localhost\n' > "$certs/server.ext"
+openssl x509 -req -days 2 -in "$certs/server.csr" -CA "$certs/ca.pem" -CAkey "$certs/ca.key" \
+    -CAcreateserial -extfile "$certs/server.ext" -out "$certs/server.pem" 2>/dev/null
+
+python3 "$here/backend.py" 18443 --delay 0.05 --api-key secret \
+    --tls-cert "$certs/server.pem" --tls-key "$certs/server.key" &
+server=$!
+trap 'kill $server 2>/dev/null; rm -rf "$certs"' EXIT
+sleep 1
+
+endpoint="LLMChat.Endpoints=https://localhost:18443/v1/chat/completions|mock|1"
+
+"$driver" "$endpoint" "LLMChat.Tls.CaFile=$certs/ca.pem" LLMChat.ApiKey=secret Expect=mock "$@"
+echo
+
+echo "Without the CA, the certificate must be refused:"
+if "$driver" "$endpoint" LLMChat.ApiKey=secret Expect=mock Requests=3 "$@" 2>/dev/null; then
+    exit 1
+fi
+echo
+
+echo "Without the key, the backend must refuse the requests:"
+if "$driver" "$endpoint" "LLMChat.Tls.CaFile=$certs/ca.pem" Expect=mock Requests=3 "$@" 2>/dev/null; then
+    exit 1
+fi
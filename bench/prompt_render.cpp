@@ -0,0 +1,211 @@
+// Render cost per request of the prompt templates, against the fmt::format builders they
+// replaced. Without a prompt directory it also checks that the built-in templates still
+// render what those builders wrote, and fails when they do not.
+//
+//     llmchat_bench_prompt [LLMChat.Prompt.Directory=<dir>] [Iterations=<n>]
+
+#include "LLMChatCharacter.h"
+#include "LLMChatPromptTemplate.h"
+#include "mod-llm-chat-config.h"
+#include "Configuration/Config.h"
+#include <fmt/format.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct BenchPrompt
+{
+    std::string system;
+    std::string user;
+};
+
+static char const* const CHAT_RULES =
+    "You are a WoW player chatting in game as the character described below. "
+    "Respond to the message you are given matching its tone and attitude - if they're friendly, be friendly back. "
+    "If they're rude or hostile, you can be snarky, defensive, or even toxic back. If they're joking, joke back. "
+    "Show faction pride when appropriate - defend your faction if they insult it, mock the opposite faction if they deserve it. "
+    "Consider level differences in your response - be more respectful to higher levels, maybe cocky to lower levels. "
+    "If they ask about locations or directions, give accurate guidance based on both your current location and theirs. "
+    "For questions about where things are, provide specific directions relative to known landmarks, flight paths, or major cities. "
+    "Don't hold back or filter your responses - be authentic to how real WoW players would actually respond. "
+    "Keep responses short and natural.\n\n"
+    "Important: Match the tone and intensity of the message you received. Write exactly like a real player would - "
+    "be raw and unfiltered, using common WoW chat style and slang. Don't worry about being polite or politically correct. "
+    "Remember your faction loyalty - Alliance vs Horde rivalry is a core part of WoW culture. "
+    "When giving directions or location info, be specific and accurate to WoW geography. "
+    "You can mix in light roleplay elements if it fits, but focus on sounding like a real player in their natural habitat.";
+
+static char const* const GROUP_RULES =
+    "You are writing chat replies for several WoW players who all just read the same chat message.\n"
+    "Write one short reply for each player, each in that player's own voice and from their own race, class, "
+    "level and faction point of view. Replies should not repeat each other; later speakers may react to earlier ones. "
+    "Match the tone and attitude of the message - friendly back to friendly, snarky or toxic back to rude. "
+    "Write exactly like real players would - raw and unfiltered, using common WoW chat style and slang. "
+    "Keep every reply short and natural.\n"
+    "Answer with JSON only, in exactly this form: "
+    "{\"replies\":[{\"speaker\":\"<player name>\",\"text\":\"<reply>\"}]}";
+
+// The builders as they were before the templates, the baseline
+static BenchPrompt FormatChatPrompt(CharacterDetails const& bot, CharacterDetails const& sender, std::string const& message)
+{
+    BenchPrompt prompt;
+    prompt.system = fmt::format("{}\n\nYou are playing {} - a level {} {} {} of the {} faction.{}",
+        CHAT_RULES, bot.name, bot.level, bot.raceName, bot.className, bot.faction,
+        !bot.guildName.empty() ? fmt::format(" Member of <{}>.", bot.guildName) : "");
+
+    prompt.user = fmt::format(
+        "You're currently in {}{}{}.\n"
+        "You're responding to {} - a level {} {} {} of the {} faction who is currently in {}{}.\n"
+        "Here's the message: {}",
+        bot.location,
+        bot.isInCombat ? fmt::format(", in combat ({}% health)", bot.healthPct) : "",
+        !bot.targetName.empty() ? fmt::format(", targeting {}", bot.targetName) : "",
+        sender.name, sender.level, sender.raceName, sender.className, sender.faction, sender.location,
+        !sender.guildName.empty() ? fmt::format("\nMember of <{}>", sender.guildName) : "",
+        message);
+    return prompt;
+}
+
+static BenchPrompt FormatGroupPrompt(std::vector<CharacterDetails const*> const& bots, CharacterDetails const& sender,
+    std::string const& message, std::string const& chatType)
+{
+    std::string speakers;
+    for (CharacterDetails const* bot : bots)
+        speakers += fmt::format("- {}: a level {} {} {} of the {} faction, currently in {}{}{}\n",
+            bot->name, bot->level, bot->raceName, bot->className, bot->faction, bot->location,
+            !bot->guildName.empty() ? fmt::format(", member of <{}>", bot->guildName) : "",
+            bot->isInCombat ? fmt::format(", in combat ({}% health)", bot->healthPct) : "");
+
+    BenchPrompt prompt;
+    prompt.system = GROUP_RULES;
+    prompt.user = fmt::format(
+        "The {} chat message is from {} - a level {} {} {} of the {} faction who is currently in {}{}.\n"
+        "The players replying are:\n{}"
+        "Here's the message: {}",
+        chatType, sender.name, sender.level, sender.raceName, sender.className, sender.faction, sender.location,
+        !sender.guildName.empty() ? fmt::format("\nMember of <{}>", sender.guildName) : "",
+        speakers, message);
+    return prompt;
+}
+
+// What LLMChatQueue::BuildPrompt and BuildGroupPrompt render before any trimming
+static BenchPrompt RenderPrompt(LLMPromptTemplates const& templates, LLMPromptTemplateId system, LLMPromptTemplateId user,
+    LLMPromptContext const& context)
+{
+    BenchPrompt prompt;
+    prompt.system = templates.Get(system).Render(context);
+    prompt.user = templates.Get(user).Render(context);
+    return prompt;
+}
+
+static CharacterDetails MakeCharacter(std::string name, bool guild, bool combat, bool target)
+{
+    CharacterDetails details;
+    details.name = std::move(name);
+    details.level = 42;
+    details.className = "Warrior";
+    details.raceName = "Orc";
+    details.faction = "Horde";
+    details.location = "Orgrimmar";
+    details.guildName = guild ? "Bloodfang" : "";
+    details.isInCombat = combat;
+    details.healthPct = combat ? 63.5f : 100.0f;
+    details.targetName = target ? "Hogger" : "";
+    return details;
+}
+
+template <typename Build>
+static void Measure(char const* name, uint32 iterations, Build build)
+{
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32 i = 0; i < iterations; ++i)
+    {
+        BenchPrompt prompt = build();
+        sink += prompt.system.size() + prompt.user.size();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+    fmt::print("{:<26} {:>8.0f} ns/request   ({} bytes)\n", name, ns, sink / iterations);
+}
+
+int main(int argc, char** argv)
+{
+    if (!sConfigMgr->ParseArgs(argc, argv))
+        return 1;
+
+    LLMChatConfig::Load();
+    std::shared_ptr<LLMPromptTemplates const> templates = LLMPromptTemplates::Current();
+    uint32 iterations = sConfigMgr->GetOption<uint32>("Iterations", 200000);
+
+    // Every combination of the optional parts, one bot and four
+    bool compare = sConfigMgr->GetOption<std::string>("LLMChat.Prompt.Directory", "").empty();
+    uint32 cases = 0, differ = 0;
+    for (uint32 mask = 0; compare && mask < 16; ++mask)
+    {
+        CharacterDetails sender = MakeCharacter("Sender", mask & 1, false, false);
+        std::vector<CharacterDetails> characters;
+        characters.push_back(MakeCharacter("Bot", mask & 2, mask & 4, mask & 8));
+        for (uint32 i = 1; i < 4; ++i)
+            characters.push_back(MakeCharacter(fmt::format("Bot{}", i), (mask + i) & 1, (mask + i) & 2, false));
+
+        std::vector<CharacterDetails const*> bots;
+        for (CharacterDetails const& character : characters)
+            bots.push_back(&character);
+
+        LLMPromptContext context;
+        context.bot = bots.front();
+        context.sender = &sender;
+        context.message = "where is the AH?";
+        context.chatType = "Say";
+
+        BenchPrompt expected = FormatChatPrompt(*bots.front(), sender, "where is the AH?");
+        BenchPrompt rendered = RenderPrompt(*templates, LLM_PROMPT_CHAT_SYSTEM, LLM_PROMPT_CHAT_USER, context);
+        ++cases;
+        if (expected.system != rendered.system || expected.user != rendered.user)
+        {
+            ++differ;
+            fmt::print("chat case {} differs:\n  fmt:      {}\n  template: {}\n", mask, expected.user, rendered.user);
+        }
+
+        context.bots = bots;
+        expected = FormatGroupPrompt(bots, sender, "where is the AH?", "Say");
+        rendered = RenderPrompt(*templates, LLM_PROMPT_GROUP_SYSTEM, LLM_PROMPT_GROUP_USER, context);
+        ++cases;
+        if (expected.system != rendered.system || expected.user != rendered.user)
+        {
+            ++differ;
+            fmt::print("group case {} differs:\n  fmt:      {}\n  template: {}\n", mask, expected.user, rendered.user);
+        }
+    }
+    if (compare)
+        fmt::print("{} cases, {} render differently from the fmt builders\n\n", cases, differ);
+
+    CharacterDetails sender = MakeCharacter("Sender", true, false, false);
+    std::vector<CharacterDetails> characters;
+    characters.push_back(MakeCharacter("Bot", true, true, true));
+    for (uint32 i = 1; i < 5; ++i)
+        characters.push_back(MakeCharacter(fmt::format("Bot{}", i), i & 1, i & 2, false));
+
+    std::vector<CharacterDetails const*> bots;
+    for (CharacterDetails const& character : characters)
+        bots.push_back(&character);
+    std::string message = "anyone want to run deadmines?";
+
+    LLMPromptContext chat;
+    chat.bot = bots.front();
+    chat.sender = &sender;
+    chat.message = message;
+    chat.chatType = "Say";
+
+    LLMPromptContext group = chat;
+    group.bots = bots;
+
+    Measure("chat, fmt", iterations, [&] { return FormatChatPrompt(*bots.front(), sender, message); });
+    Measure("chat, template", iterations,
+        [&] { return RenderPrompt(*templates, LLM_PROMPT_CHAT_SYSTEM, LLM_PROMPT_CHAT_USER, chat); });
+    Measure("group of 5, fmt", iterations, [&] { return FormatGroupPrompt(bots, sender, message, "Say"); });
+    Measure("group of 5, template", iterations,
+        [&] { return RenderPrompt(*templates, LLM_PROMPT_GROUP_SYSTEM, LLM_PROMPT_GROUP_USER, group); });
+    return differ ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+// Routing over several backends: sends requests through LLMChatEngine the way the queue
+// worker does, to the endpoints in LLMChat.Endpoints, and reports where they went. Meant to
+// run against mock/backend.py servers of different speeds, with one endpoint left down;
+// mock/routing.sh sets that up, and mock/tls.sh runs it against an HTTPS endpoint.
+//
+//     llmchat_bench_routing LLMChat.Endpoints=<url|model|weight, ...> [LLMChat.Balancer.Strategy=ewma]
+//         [Requests=200] [IntervalMs=10] [Expect=<model>]
+//
+// A request counts as served when the reply decodes to text. With Expect set it fails unless
+// the backend serving that model served more requests than any other.
+
+#include "LLMChatBackends.h"
+#include "LLMChatConnectionPool.h"
+#include "LLMChatEngine.h"
+#include "LLMChatStream.h"
+#include "mod-llm-chat-config.h"
+#include "Configuration/Config.h"
+#include <fmt/format.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+
+int main(int argc, char** argv)
+{
+    if (!sConfigMgr->ParseArgs(argc, argv))
+        return 1;
+
+    uint32 total = sConfigMgr->GetOption<uint32>("Requests", 200);
+    std::chrono::milliseconds interval(sConfigMgr->GetOption<uint32>("IntervalMs", 10));
+    std::string expect = sConfigMgr->GetOption<std::string>("Expect", "");
+
+    LLMChatConfig::Load();
+    if (!LLMChatEngine::Initialize())
+        return 1;
+
+    std::mutex mutex;
+    std::map<std::string, uint32> served;
+    std::atomic<uint32> finished{0};
+    uint32 unrouted = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32 i = 0; i < total; ++i)
+    {
+        while (!LLMChatEngine::HasCapacity())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        std::shared_ptr<LLMBackend> backend = LLMChatBackends::Select();
+        if (!backend)
+        {
+            ++unrouted;
+            ++finished;
+            continue;
+        }
+
+        auto request = std::make_shared<LLMHttpRequest>();
+        request->backend = backend;
+        request->endpoint = backend->endpoint;
+        request->body = R"({"model":"mock","prompt":"hello","stream":false})";
+        request->deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        request->onComplete = [&, name = backend->model](LLMHttpResult const& result)
+        {
+            LLMResponseChunk chunk;
+            std::string text;
+            bool ok = result.success && result.status == 200 && LLMResponseChunk::Parse(result.body, chunk, text) &&
+                !chunk.hasError && !text.empty();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ++served[ok ? name : name + " (failed)"];
+            ++finished;
+        };
+        LLMChatEngine::Submit(std::move(request));
+        std::this_thread::sleep_for(interval);
+    }
+
+    while (finished < total)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fmt::print("{} requests in {:.1f}s, {}\n", total, seconds, LLMChatBackends::GetStrategyName(sLLMConfig->Balancer.Strategy));
+    for (auto const& [name, count] : served)
+        fmt::print("  {:<16} {:>5}\n", name, count);
+    if (unrouted)
+        fmt::print("  {:<16} {:>5}\n", "no backend", unrouted);
+
+    for (std::shared_ptr<LLMBackend> const& backend : LLMChatBackends::GetBackends())
+        fmt::print("{:<20} {:<8} requests {:>4}, failures {:>4}, ejections {}, ewma {:.0f} ms, limit {}, breaker {}\n",
+            backend->name, backend->model, backend->requests.load(), backend->failures.load(), backend->ejections.load(),
+            backend->ewmaLatencyMs.load(), backend->limit.Get(), LLMChatCircuitBreaker::GetStateName(backend->breaker.GetState()));
+
+    LLMPoolStats pool = LLMChatConnectionPool::GetStats();
+    fmt::print("connections: {} reused, {} opened; TLS: {} full handshakes, {} resumed\n", pool.hits, pool.misses,
+        pool.tlsHandshakes, pool.tlsResumed);
+
+    LLMChatEngine::Shutdown();
+
+    if (expect.empty())
+        return 0;
+
+    uint32 best = served[expect];
+    for (auto const& [name, count] : served)
+        if (name != expect && count >= best)
+        {
+            fmt::print("FAIL: {} served {}, not fewer than {} with {}\n", name, count, expect, best);
+            return 1;
+        }
+    return 0;
+}
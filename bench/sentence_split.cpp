@@ -0,0 +1,141 @@
+// LLMChatSentenceSplitter, which cuts a streamed reply into chat lines: first that it emits
+// and packs lines the way the queue paces them, then what it costs per generated token.
+//
+//     llmchat_bench_split [Iterations=<n>]
+
+#include "LLMChatStream.h"
+#include "Configuration/Config.h"
+#include <fmt/format.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct SplitStep
+{
+    char const* text;
+    bool lineDue;
+    std::vector<std::string> expected;     // Lines the step emits
+};
+
+struct SplitCase
+{
+    char const* name;
+    std::vector<SplitStep> steps;
+    std::vector<std::string> flushed;      // Lines Flush emits at the end
+};
+
+static std::string Join(std::vector<std::string> const& lines)
+{
+    std::string joined;
+    for (std::string const& line : lines)
+        joined += fmt::format("[{}]", line);
+    return joined;
+}
+
+static bool Run(SplitCase const& split)
+{
+    LLMChatSentenceSplitter splitter(40);
+    bool same = true;
+    for (size_t i = 0; i < split.steps.size(); ++i)
+    {
+        std::vector<std::string> lines;
+        splitter.Append(split.steps[i].text, split.steps[i].lineDue, lines);
+        if (lines == split.steps[i].expected)
+            continue;
+
+        same = false;
+        fmt::print("{}, step {}: expected {} got {}\n", split.name, i, Join(split.steps[i].expected), Join(lines));
+    }
+
+    std::vector<std::string> lines;
+    splitter.Flush(lines);
+    if (lines != split.flushed)
+    {
+        same = false;
+        fmt::print("{}, flush: expected {} got {}\n", split.name, Join(split.flushed), Join(lines));
+    }
+    return same;
+}
+
+int main(int argc, char** argv)
+{
+    if (!sConfigMgr->ParseArgs(argc, argv))
+        return 1;
+
+    uint32 iterations = sConfigMgr->GetOption<uint32>("Iterations", 20000);
+
+    std::vector<SplitCase> cases =
+    {
+        {
+            "second sentence once the line is due",
+            {
+                { "Hello there. How", true, { "Hello there." } },
+                { " are you? I", true, { "How are you?" } },
+            },
+            { "I" },
+        },
+        {
+            "packed while the line before waits",
+            {
+                { "Hi. Nice ", true, { "Hi." } },
+                { "day. Good ", false, {} },
+                { "luck. Bye", false, {} },
+            },
+            { "Nice day. Good luck. Bye" },
+        },
+        {
+            "packed sentences go out once due",
+            {
+                { "Hi. One. Two. ", true, { "Hi." } },
+                { "Thr", true, { "One. Two." } },
+                { "ee. Four. ", false, {} },
+            },
+            { "Three. Four." },
+        },
+        {
+            "full line goes out while waiting",
+            {
+                { "Hi. This sentence is twenty-nine. ", false, { "Hi." } },
+                { "And this one does not fit. ", false, { "This sentence is twenty-nine." } },
+            },
+            { "And this one does not fit." },
+        },
+        {
+            "cached reply replayed at once",
+            {
+                { "Sure thing. Meet me at the bank. Bring gold.", false, { "Sure thing." } },
+            },
+            { "Meet me at the bank. Bring gold." },
+        },
+    };
+
+    uint32 differ = 0;
+    for (SplitCase const& split : cases)
+        if (!Run(split))
+            ++differ;
+    fmt::print("{} cases, {} split differently\n\n", cases.size(), differ);
+
+    // A 600 character reply fed a token of about four characters at a time
+    std::string reply;
+    while (reply.size() < 600)
+        reply += "Meet me by the bank in Stormwind. Bring the gold you owe me! ";
+    std::vector<std::string> tokens;
+    for (size_t i = 0; i < reply.size(); i += 4)
+        tokens.push_back(reply.substr(i, 4));
+
+    uint64 sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32 i = 0; i < iterations; ++i)
+    {
+        LLMChatSentenceSplitter splitter(255);
+        std::vector<std::string> lines;
+        for (size_t token = 0; token < tokens.size(); ++token)
+            splitter.Append(tokens[token], token % 32 == 0, lines);
+        splitter.Flush(lines);
+        sink += lines.size();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+        / (double(iterations) * tokens.size());
+    fmt::print("{:<36} {:>9.0f} ns   ({})\n", "token", ns, sink / iterations);
+    return differ ? 1 : 0;
+}
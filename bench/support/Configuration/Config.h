@@ -0,0 +1,46 @@
+#ifndef MOD_LLM_CHAT_BENCH_CONFIG_H
+#define MOD_LLM_CHAT_BENCH_CONFIG_H
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+// Options come from the command line as Key=Value instead of mod_llm_chat.conf; anything not
+// given keeps its default
+class ConfigMgr
+{
+public:
+    static ConfigMgr* instance();
+
+    // Takes every Key=Value argument; returns false on one that is not
+    bool ParseArgs(int argc, char** argv);
+    void SetOption(std::string const& name, std::string const& value) { m_options[name] = value; }
+
+    template <typename T>
+    T GetOption(std::string const& name, T const& def, bool /*showLogs*/ = true) const
+    {
+        auto itr = m_options.find(name);
+        if (itr == m_options.end())
+            return def;
+
+        if constexpr (std::is_same_v<T, std::string>)
+            return itr->second;
+        else if constexpr (std::is_same_v<T, bool>)
+            return itr->second == "1" || itr->second == "true";
+        else
+        {
+            std::istringstream stream(itr->second);
+            T value = def;
+            stream >> value;
+            return value;
+        }
+    }
+
+private:
+    std::map<std::string, std::string> m_options;
+};
+
+#define sConfigMgr ConfigMgr::instance()
+
+#endif // MOD_LLM_CHAT_BENCH_CONFIG_H
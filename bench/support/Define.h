@@ -0,0 +1,18 @@
+#ifndef MOD_LLM_CHAT_BENCH_DEFINE_H
+#define MOD_LLM_CHAT_BENCH_DEFINE_H
+
+// Stand-ins for the parts of the AzerothCore headers the benchmarked sources use, so they
+// build on their own
+
+#include <cstdint>
+
+typedef int64_t int64;
+typedef int32_t int32;
+typedef int16_t int16;
+typedef int8_t int8;
+typedef uint64_t uint64;
+typedef uint32_t uint32;
+typedef uint16_t uint16;
+typedef uint8_t uint8;
+
+#endif // MOD_LLM_CHAT_BENCH_DEFINE_H
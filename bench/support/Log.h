@@ -0,0 +1,20 @@
+#ifndef MOD_LLM_CHAT_BENCH_LOG_H
+#define MOD_LLM_CHAT_BENCH_LOG_H
+
+#include <fmt/format.h>
+#include <cstdio>
+
+// Warnings and errors go to stderr, so a misconfigured run says why; the rest is dropped
+#define LOG_BENCH(level, filter, ...) \
+    do { fmt::print(stderr, "{} {}\n", level, fmt::format(__VA_ARGS__)); } while (0)
+#define LOG_QUIET(filter, ...) \
+    do { if (false) (void)fmt::format(__VA_ARGS__); } while (0)
+
+#define LOG_FATAL(filter, ...) LOG_BENCH("FATAL", filter, __VA_ARGS__)
+#define LOG_ERROR(filter, ...) LOG_BENCH("ERROR", filter, __VA_ARGS__)
+#define LOG_WARN(filter, ...) LOG_BENCH("WARN", filter, __VA_ARGS__)
+#define LOG_INFO(filter, ...) LOG_QUIET(filter, __VA_ARGS__)
+#define LOG_DEBUG(filter, ...) LOG_QUIET(filter, __VA_ARGS__)
+#define LOG_TRACE(filter, ...) LOG_QUIET(filter, __VA_ARGS__)
+
+#endif // MOD_LLM_CHAT_BENCH_LOG_H
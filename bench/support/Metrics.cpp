@@ -0,0 +1,7 @@
+#include "LLMChatMetrics.h"
+
+// The real LLMChatMetrics reads the queue's counters, which need the game; the drivers report
+// from the backends' own counters instead
+void LLMChatMetrics::Record(LLMHistogram /*histogram*/, std::chrono::steady_clock::duration /*value*/)
+{
+}
@@ -0,0 +1,15 @@
+#ifndef MOD_LLM_CHAT_BENCH_PLAYER_H
+#define MOD_LLM_CHAT_BENCH_PLAYER_H
+
+#include "Define.h"
+
+class Player;
+
+enum TeamId : uint8
+{
+    TEAM_ALLIANCE,
+    TEAM_HORDE,
+    TEAM_NEUTRAL
+};
+
+#endif // MOD_LLM_CHAT_BENCH_PLAYER_H
@@ -0,0 +1,6 @@
+#ifndef MOD_LLM_CHAT_BENCH_SCRIPTMGR_H
+#define MOD_LLM_CHAT_BENCH_SCRIPTMGR_H
+
+// Included by LLMChatCharacter.h; nothing the benchmarks build uses it
+
+#endif // MOD_LLM_CHAT_BENCH_SCRIPTMGR_H
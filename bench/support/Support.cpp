@@ -0,0 +1,26 @@
+#include "Configuration/Config.h"
+#include <fmt/format.h>
+#include <cstdio>
+#include <cstring>
+
+ConfigMgr* ConfigMgr::instance()
+{
+    static ConfigMgr instance;
+    return &instance;
+}
+
+bool ConfigMgr::ParseArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        char const* separator = std::strchr(argv[i], '=');
+        if (!separator || separator == argv[i])
+        {
+            fmt::print(stderr, "Expected Key=Value, got '{}'\n", argv[i]);
+            return false;
+        }
+
+        SetOption(std::string(argv[i], separator - argv[i]), separator + 1);
+    }
+    return true;
+}
@@ -0,0 +1,9 @@
+/*
+ * Copyright (C) 2016+ AzerothCore <www.azerothcore.org>, released under GNU AGPL v3 license: https://github.com/azerothcore/azerothcore-wotlk/blob/master/LICENSE-AGPL3
+ */
+
+-- Help text for the .llmchat GM commands
+DELETE FROM `command` WHERE `name` IN ('llmchat', 'llmchat stats');
+INSERT INTO `command` (`name`, `security`, `help`) VALUES
+('llmchat', 2, 'Syntax: .llmchat $subcommand\nType .llmchat to see the list of possible subcommands or .help llmchat $subcommand to see info on subcommands'),
+('llmchat stats', 2, 'Syntax: .llmchat stats\nShows the LLM chat queue depth, message and error counters, and queue wait, connect, first token, generation and delivery latency percentiles since startup.');
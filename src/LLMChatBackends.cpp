@@ -0,0 +1,259 @@
+#include "LLMChatBackends.h"
+#include "Log.h"
+#include <algorithm>
+#include <limits>
+
+// Weight of the newest response in a backend's smoothed latency
+static constexpr double EWMA_ALPHA = 0.2;
+
+// Static member initialization
+std::vector<std::shared_ptr<LLMBackend>> LLMChatBackends::s_backends;
+std::mutex LLMChatBackends::s_mutex;
+std::atomic<uint32> LLMChatBackends::s_nextStart{0};
+
+void LLMChatBackends::Initialize()
+{
+    // Endpoints come parsed with the config snapshot; backends keep their state across
+    // reloads, so a changed list takes a restart
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::vector<std::shared_ptr<LLMBackend>> backends;
+    for (LLMEndpointConfig const& endpoint : config->API.Endpoints)
+    {
+        auto backend = std::make_shared<LLMBackend>(endpoint.endpoint.host + ":" + endpoint.endpoint.port);
+        backend->url = endpoint.url;
+        backend->endpoint = endpoint.endpoint;
+        backend->model = endpoint.model;
+        backend->weight = endpoint.weight;
+        std::string path = backend->endpoint.target.substr(0, backend->endpoint.target.find('?'));
+        auto endsWith = [&path](std::string_view suffix)
+        {
+            return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+        backend->api = endsWith("/api/chat") ? LLM_API_CHAT : endsWith("/chat/completions") ? LLM_API_OPENAI : LLM_API_GENERATE;
+        backend->limit.Configure(LLMChatEngine::GetMaxInFlight());
+        backends.push_back(std::move(backend));
+    }
+
+    if (backends.empty())
+        LOG_ERROR("module", "[LLMChat] No valid LLM endpoint configured, every message will get a fallback reply");
+
+    for (auto const& backend : backends)
+        LOG_INFO("module", "[LLMChat] Backend {} - model {}, weight {}, {} requests", backend->url, backend->model,
+            backend->weight, GetApiName(backend->api));
+    LOG_INFO("module", "[LLMChat] Routing across {} backends by {}", backends.size(),
+        GetStrategyName(config->Balancer.Strategy));
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_backends = std::move(backends);
+}
+
+void LLMChatBackends::Shutdown()
+{
+    ReportStats();
+}
+
+int64 LLMChatBackends::NowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool LLMChatBackends::IsEjected(LLMBackend const& backend, int64 nowMs)
+{
+    return backend.ejectedUntilMs.load(std::memory_order_relaxed) > nowMs;
+}
+
+std::shared_ptr<LLMBackend> LLMChatBackends::Select()
+{
+    return Pick(nullptr);
+}
+
+std::shared_ptr<LLMBackend> LLMChatBackends::SelectAlternative(LLMBackend const& primary)
+{
+    return Pick(&primary);
+}
+
+std::shared_ptr<LLMBackend> LLMChatBackends::Pick(LLMBackend const* avoid)
+{
+    int64 now = NowMs();
+    bool ewma = sLLMConfig->Balancer.Strategy == LLM_BALANCER_EWMA;
+    std::shared_ptr<LLMBackend> best;
+    std::shared_ptr<LLMBackend> fallback;
+    double bestScore = std::numeric_limits<double>::max();
+
+    // Starting the scan at a rotating index spreads ties evenly
+    size_t count = s_backends.size();
+    size_t start = count ? s_nextStart.fetch_add(1, std::memory_order_relaxed) % count : 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::shared_ptr<LLMBackend> const& backend = s_backends[(start + i) % count];
+        if (IsEjected(*backend, now) || !backend->breaker.IsAvailable())
+            continue;
+
+        // A second attempt needs the same model and API to send the body unchanged; another
+        // connection to the backend it came from is the last resort
+        if (avoid && (backend.get() == avoid || backend->model != avoid->model || backend->api != avoid->api))
+        {
+            if (backend.get() == avoid)
+                fallback = backend;
+            continue;
+        }
+
+        double load = backend->outstanding.load(std::memory_order_relaxed) + 1.0;
+        // A backend at its own concurrency limit only gets work when every other one is too
+        if (load > backend->limit.Get())
+            load *= 16.0;
+
+        double score = load / backend->weight;
+        if (ewma)
+            score *= std::max(1.0, backend->ewmaLatencyMs.load(std::memory_order_relaxed));
+
+        if (score < bestScore)
+        {
+            best = backend;
+            bestScore = score;
+        }
+    }
+
+    return best ? best : fallback;
+}
+
+uint32 LLMChatBackends::GetLimit()
+{
+    int64 now = NowMs();
+    uint32 available = 0, total = 0;
+    for (auto const& backend : s_backends)
+    {
+        uint32 limit = backend->limit.Get();
+        total += limit;
+        if (!IsEjected(*backend, now) && backend->breaker.IsAvailable())
+            available += limit;
+    }
+
+    // With nothing available the queue keeps dispatching, so messages fail fast instead of piling up
+    return available ? available : total;
+}
+
+void LLMChatBackends::OnSubmit(LLMBackend& backend)
+{
+    ++backend.outstanding;
+    ++backend.requests;
+}
+
+void LLMChatBackends::Record(LLMBackend& backend, LLMHttpResult const& result, std::chrono::steady_clock::time_point sentAt)
+{
+    --backend.outstanding;
+
+    // A cancelled request was given up on by us, not failed by the backend
+    if (result.cancelled)
+    {
+        backend.breaker.Abandon();
+        return;
+    }
+
+    // Client errors are our fault; overload and server errors are the backend's
+    bool success = result.success && result.status < 500 && result.status != 429;
+    backend.breaker.Record(success, result.latency);
+
+    if (success)
+    {
+        backend.limit.OnSuccess(sentAt, result.latency, backend.outstanding.load(std::memory_order_relaxed));
+
+        double previous = backend.ewmaLatencyMs.load(std::memory_order_relaxed);
+        double latency = static_cast<double>(result.latency.count());
+        backend.ewmaLatencyMs.store(previous ? previous + EWMA_ALPHA * (latency - previous) : latency,
+            std::memory_order_relaxed);
+
+        if (backend.consecutiveFailures.exchange(0, std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            backend.ejectionStreak = 0;
+        }
+        return;
+    }
+
+    ++backend.failures;
+    backend.limit.OnFailure(sentAt);
+
+    uint32 ejectAfter = sLLMConfig->Balancer.EjectAfter;
+    if (ejectAfter && ++backend.consecutiveFailures >= ejectAfter)
+        Eject(backend, NowMs());
+}
+
+void LLMChatBackends::Eject(LLMBackend& backend, int64 nowMs)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (IsEjected(backend, nowMs))
+        return;
+
+    // The last backend still taking requests stays in; its breaker decides from here
+    bool othersAvailable = std::any_of(s_backends.begin(), s_backends.end(), [&backend, nowMs](auto const& other) {
+        return other.get() != &backend && !IsEjected(*other, nowMs) && other->breaker.IsAvailable();
+    });
+    if (!othersAvailable)
+        return;
+
+    // Each ejection in a row without a success in between lasts twice as long
+    auto duration = std::min(config->Balancer.MaxEjectTime,
+        config->Balancer.EjectTime * (int64(1) << std::min<uint32>(backend.ejectionStreak, 16)));
+    ++backend.ejectionStreak;
+    ++backend.ejections;
+    backend.consecutiveFailures = 0;
+    backend.ejectedUntilMs = nowMs + duration.count();
+
+    LOG_WARN("module", "[LLMChat] Backend {} ejected for {}ms after {} failures in a row",
+        backend.name, duration.count(), config->Balancer.EjectAfter);
+}
+
+void LLMChatBackends::RecordGeneration(LLMBackend& backend, LLMGenerationStats const& stats)
+{
+    ++backend.generations;
+    backend.promptTokens += stats.promptTokens;
+    backend.promptEvalUs += stats.promptEvalNs / 1000;
+    backend.outputTokens += stats.outputTokens;
+
+    LOG_DEBUG("module", "[LLMChat] Backend {}: prompt {} tokens evaluated in {}ms, {} tokens generated in {}ms",
+        backend.name, stats.promptTokens, stats.promptEvalNs / 1000000, stats.outputTokens, stats.outputNs / 1000000);
+}
+
+char const* LLMChatBackends::GetApiName(LLMBackendApi api)
+{
+    switch (api)
+    {
+        case LLM_API_GENERATE: return "generate";
+        case LLM_API_CHAT:     return "chat";
+        case LLM_API_OPENAI:   return "openai";
+        default:               return "unknown";
+    }
+}
+
+char const* LLMChatBackends::GetStrategyName(LLMBalancerStrategy strategy)
+{
+    switch (strategy)
+    {
+        case LLM_BALANCER_LEAST_OUTSTANDING: return "least outstanding requests";
+        case LLM_BALANCER_EWMA:              return "latency EWMA";
+        default:                             return "unknown";
+    }
+}
+
+void LLMChatBackends::ReportStats()
+{
+    int64 now = NowMs();
+    for (auto const& backend : s_backends)
+    {
+        LOG_INFO("module", "[LLMChat] Backend {}: {}{} breaker, {} in flight of a limit of {} ({:.1f}), "
+            "{} requests, {} failed, {} failed fast, {} ejections, latency {:.0f}ms (baseline {}ms)",
+            backend->name, IsEjected(*backend, now) ? "ejected, " : "",
+            LLMChatCircuitBreaker::GetStateName(backend->breaker.GetState()),
+            backend->outstanding.load(), backend->limit.Get(), backend->limit.GetLimit(),
+            backend->requests.load(), backend->failures.load(), backend->rejected.load(), backend->ejections.load(),
+            backend->ewmaLatencyMs.load(), backend->limit.GetBaseline().count());
+
+        if (uint64 generations = backend->generations.load())
+            LOG_INFO("module", "[LLMChat] Backend {}: {} generations, prompt eval {:.1f}ms for {:.0f} uncached tokens "
+                "and {:.0f} tokens generated on average", backend->name, generations,
+                backend->promptEvalUs.load() / 1000.0 / generations, double(backend->promptTokens.load()) / generations,
+                double(backend->outputTokens.load()) / generations);
+    }
+}
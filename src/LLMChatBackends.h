@@ -0,0 +1,102 @@
+#ifndef MOD_LLM_CHAT_BACKENDS_H
+#define MOD_LLM_CHAT_BACKENDS_H
+
+#include "Define.h"
+#include "LLMChatEngine.h"
+#include "LLMChatCircuitBreaker.h"
+#include "LLMChatConcurrencyLimit.h"
+#include "LLMChatStream.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Request format a backend expects, from the path of its URL
+enum LLMBackendApi : uint8
+{
+    LLM_API_GENERATE = 0,   // Ollama /api/generate: a prompt and a separate system prompt
+    LLM_API_CHAT     = 1,   // Ollama /api/chat: a messages array
+    LLM_API_OPENAI   = 2,   // OpenAI-compatible /chat/completions: a messages array, settings at the top level
+};
+
+// One LLM server requests can be routed to, with its own breaker, concurrency limit and counters
+struct LLMBackend
+{
+    explicit LLMBackend(std::string backendName) : name(std::move(backendName)), breaker(name) {}
+
+    std::string name;           // host:port, used in logs
+    std::string url;
+    LLMEndpoint endpoint;
+    std::string model;
+    uint32 weight = 1;
+    LLMBackendApi api = LLM_API_GENERATE;
+
+    LLMChatCircuitBreaker breaker;
+    LLMChatConcurrencyLimit limit;
+
+    std::atomic<uint32> outstanding{0};
+    std::atomic<double> ewmaLatencyMs{0.0};     // 0 until the first response
+    std::atomic<int64> ejectedUntilMs{0};       // Steady clock; passive health check
+    std::atomic<uint32> consecutiveFailures{0};
+    uint32 ejectionStreak = 0;                  // Ejections since the last success; guarded by the backends mutex
+
+    std::atomic<uint64> requests{0};
+    std::atomic<uint64> failures{0};
+    std::atomic<uint64> rejected{0};            // Failed fast by the open breaker
+    std::atomic<uint64> ejections{0};
+
+    // Found at startup by LLMChatWarmup; 0 when the backend does not say
+    std::atomic<uint32> contextLength{0};
+    std::atomic<uint32> slots{0};           // Requests the backend serves in parallel
+
+    // Timings reported with finished generations, to see how much of the prompt the
+    // backend's prompt cache saves
+    std::atomic<uint64> generations{0};
+    std::atomic<uint64> promptTokens{0};
+    std::atomic<uint64> promptEvalUs{0};
+    std::atomic<uint64> outputTokens{0};
+};
+
+// The configured backends and the routing between them. The list is built once at
+// startup; routing reads only atomics and the config snapshot, so the worker never waits
+// on an engine thread.
+class LLMChatBackends
+{
+public:
+    static void Initialize();
+    static void Shutdown();
+
+    // Worker thread: the backend the next request should go to, or null when every
+    // backend is ejected or has its breaker open
+    static std::shared_ptr<LLMBackend> Select();
+    // Engine threads: where a hedge of a request sent to `primary` should go - another
+    // backend serving the same model, else `primary` itself; null when neither is available
+    static std::shared_ptr<LLMBackend> SelectAlternative(LLMBackend const& primary);
+    // Sum of the concurrency limits of the backends that can take requests
+    static uint32 GetLimit();
+
+    // Engine threads: bookkeeping around one exchange with `backend`
+    static void OnSubmit(LLMBackend& backend);
+    static void Record(LLMBackend& backend, LLMHttpResult const& result, std::chrono::steady_clock::time_point sentAt);
+    // Any thread: timings the backend reported for a generation it finished
+    static void RecordGeneration(LLMBackend& backend, LLMGenerationStats const& stats);
+
+    static std::vector<std::shared_ptr<LLMBackend>> const& GetBackends() { return s_backends; }
+    static char const* GetStrategyName(LLMBalancerStrategy strategy);
+    static char const* GetApiName(LLMBackendApi api);
+    static void ReportStats();
+
+private:
+    static std::shared_ptr<LLMBackend> Pick(LLMBackend const* avoid);
+    static int64 NowMs();
+    static bool IsEjected(LLMBackend const& backend, int64 nowMs);
+    static void Eject(LLMBackend& backend, int64 nowMs);
+
+    static std::vector<std::shared_ptr<LLMBackend>> s_backends;
+    static std::mutex s_mutex;
+    static std::atomic<uint32> s_nextStart;
+};
+
+#endif // MOD_LLM_CHAT_BACKENDS_H
@@ -0,0 +1,226 @@
+#include "LLMChatCache.h"
+#include "mod-llm-chat-config.h"
+#include "Log.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <string_view>
+
+// Rough bookkeeping cost of one entry besides its strings (list node, map node, vector)
+static constexpr size_t ENTRY_OVERHEAD = 128;
+
+// Static member initialization
+LLMChatCache::EntryList LLMChatCache::s_entries;
+std::unordered_map<std::string, LLMChatCache::EntryList::iterator> LLMChatCache::s_index;
+std::mutex LLMChatCache::s_mutex;
+LLMCacheStats LLMChatCache::s_stats;
+
+void LLMChatCache::Initialize()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (config->Cache.Enable)
+        LOG_INFO("module", "[LLMChat] Response cache enabled - {} bytes, {} variants per key", config->Cache.MaxBytes,
+            config->Cache.Variants);
+}
+
+bool LLMChatCache::IsEnabled()
+{
+    return sLLMConfig->Cache.Enable;
+}
+
+void LLMChatCache::Shutdown()
+{
+    ReportStats();
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_index.clear();
+    s_entries.clear();
+    s_stats = LLMCacheStats();
+}
+
+std::string LLMChatCache::NormalizeMessage(std::string const& message)
+{
+    // Case, punctuation and spacing rarely change what a reply should say
+    std::string normalized;
+    normalized.reserve(message.size());
+    for (char c : message)
+    {
+        unsigned char ch = static_cast<unsigned char>(c);
+        // Bytes of multi-byte UTF-8 characters are kept as they are, so accented and
+        // non-Latin text still tells messages apart
+        if (ch >= 0x80)
+            normalized += c;
+        else if (std::isalnum(ch))
+            normalized += static_cast<char>(std::tolower(ch));
+        else if (std::isspace(ch) && !normalized.empty() && normalized.back() != ' ')
+            normalized += ' ';
+    }
+
+    if (!normalized.empty() && normalized.back() == ' ')
+        normalized.pop_back();
+    return normalized;
+}
+
+// Case-insensitive search for `name` between two non-alphanumeric characters
+static bool ContainsWord(std::string_view text, std::string_view name)
+{
+    if (name.empty())
+        return false;
+
+    auto isWordByte = [](char c) { return (c & 0x80) || std::isalnum(static_cast<unsigned char>(c)); };
+    for (size_t start = 0; start + name.size() <= text.size(); ++start)
+    {
+        if (start > 0 && isWordByte(text[start - 1]))
+            continue;
+        size_t end = start + name.size();
+        if (end < text.size() && isWordByte(text[end]))
+            continue;
+
+        bool same = std::equal(name.begin(), name.end(), text.begin() + start, [](char a, char b)
+        {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        });
+        if (same)
+            return true;
+    }
+    return false;
+}
+
+bool LLMChatCache::MentionsName(std::string const& reply, CharacterDetails const& responder, CharacterDetails const& sender)
+{
+    return ContainsWord(reply, responder.name) || ContainsWord(reply, sender.name);
+}
+
+std::string LLMChatCache::BuildProfile(CharacterDetails const& responder, CharacterDetails const& sender,
+    LLMChatType chatType)
+{
+    // Names, targets and exact health are left out on purpose: they make every prompt unique
+    // while barely changing small talk. Levels count in bands of ten. A reply that uses a name
+    // is not stored, see MentionsName.
+    return fmt::format("{}\x1f{}|{}|{}|{}|{}|{}\x1f{}|{}|{}|{}|{}",
+        uint32(chatType),
+        responder.raceName, responder.className, responder.faction, responder.level / 10, responder.location,
+        responder.isInCombat ? 1 : 0,
+        sender.raceName, sender.className, sender.faction, sender.level / 10, sender.location);
+}
+
+std::string LLMChatCache::BuildKey(std::string const& normalizedMessage, CharacterDetails const& responder,
+    CharacterDetails const& sender, LLMChatType chatType)
+{
+    return BuildProfile(responder, sender, chatType) + '\x1f' + normalizedMessage;
+}
+
+bool LLMChatCache::Lookup(std::string const& key, LLMChatPriority priority, std::string& reply)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Cache.Enable || config->Cache.TTL[priority].count() == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    auto found = s_index.find(key);
+    if (found == s_index.end())
+    {
+        ++s_stats.misses;
+        return false;
+    }
+
+    EntryList::iterator itr = found->second;
+    if (itr->expiry <= std::chrono::steady_clock::now())
+    {
+        Erase(itr);
+        ++s_stats.expired;
+        ++s_stats.misses;
+        return false;
+    }
+
+    // Keep asking the model until there are enough variants to rotate through
+    if (itr->variants.size() < config->Cache.Variants)
+    {
+        ++s_stats.misses;
+        return false;
+    }
+
+    reply = itr->variants[itr->nextVariant];
+    itr->nextVariant = (itr->nextVariant + 1) % itr->variants.size();
+    s_entries.splice(s_entries.begin(), s_entries, itr);
+    ++s_stats.hits;
+    return true;
+}
+
+void LLMChatCache::Store(std::string const& key, LLMChatPriority priority, std::string const& reply)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Cache.Enable || config->Cache.TTL[priority].count() == 0 || reply.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    auto found = s_index.find(key);
+    if (found == s_index.end())
+    {
+        s_entries.emplace_front();
+        Entry& entry = s_entries.front();
+        entry.key = key;
+        entry.expiry = std::chrono::steady_clock::now() + config->Cache.TTL[priority];
+        entry.bytes = ENTRY_OVERHEAD + key.size() * 2;
+        s_stats.bytes += entry.bytes;
+        found = s_index.emplace(key, s_entries.begin()).first;
+    }
+    else
+        s_entries.splice(s_entries.begin(), s_entries, found->second);
+
+    Entry& entry = *found->second;
+    if (entry.variants.size() >= config->Cache.Variants)
+        return;
+
+    // Concurrent misses on a key may produce the same text; one copy is enough
+    if (std::find(entry.variants.begin(), entry.variants.end(), reply) != entry.variants.end())
+        return;
+
+    entry.variants.push_back(reply);
+    entry.bytes += reply.size();
+    s_stats.bytes += reply.size();
+    ++s_stats.inserts;
+
+    EvictToBudget(config->Cache.MaxBytes);
+}
+
+void LLMChatCache::Erase(EntryList::iterator itr)
+{
+    s_stats.bytes -= itr->bytes;
+    s_index.erase(itr->key);
+    s_entries.erase(itr);
+}
+
+void LLMChatCache::EvictToBudget(size_t maxBytes)
+{
+    while (s_stats.bytes > maxBytes && !s_entries.empty())
+    {
+        Erase(std::prev(s_entries.end()));
+        ++s_stats.evictions;
+    }
+}
+
+LLMCacheStats LLMChatCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    LLMCacheStats stats = s_stats;
+    stats.entries = s_entries.size();
+    return stats;
+}
+
+void LLMChatCache::ReportStats()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Cache.Enable)
+        return;
+
+    LLMCacheStats stats = GetStats();
+    uint64 lookups = stats.hits + stats.misses;
+    LOG_INFO("module", "[LLMChat] Response cache: {:.1f}% hit ratio ({} hits, {} misses), {} entries, {} of {} bytes, "
+        "{} inserts, {} evicted, {} expired",
+        lookups ? 100.0 * stats.hits / lookups : 0.0, stats.hits, stats.misses, stats.entries, stats.bytes, config->Cache.MaxBytes,
+        stats.inserts, stats.evictions, stats.expired);
+}
@@ -0,0 +1,78 @@
+#ifndef MOD_LLM_CHAT_CACHE_H
+#define MOD_LLM_CHAT_CACHE_H
+
+#include "Define.h"
+#include "LLMChatCharacter.h"
+#include "mod-llm-chat-config.h"
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct LLMCacheStats
+{
+    uint64 hits = 0;
+    uint64 misses = 0;
+    uint64 inserts = 0;     // Replies stored, as a new key or an extra variant
+    uint64 evictions = 0;   // Entries dropped to stay under the byte budget
+    uint64 expired = 0;     // Entries dropped after their class TTL
+    size_t bytes = 0;
+    size_t entries = 0;
+};
+
+// Generated replies keyed on the normalized message and the parts of the prompt
+// that shape the answer (races, classes, level bands, zones), so the same small
+// talk to similar bots is answered from memory. Replies that name either character
+// are not stored. Bounded by bytes with LRU eviction; each key keeps several
+// variants that are served in turn.
+class LLMChatCache
+{
+public:
+    static void Initialize();
+    static void Shutdown();
+
+    static bool IsEnabled();
+    // Takes the message as NormalizeMessage returned it
+    static std::string BuildKey(std::string const& normalizedMessage, CharacterDetails const& responder,
+        CharacterDetails const& sender, LLMChatType chatType);
+    // The prompt-relevant character fields alone, shared by every message between such characters
+    static std::string BuildProfile(CharacterDetails const& responder, CharacterDetails const& sender,
+        LLMChatType chatType);
+    // Lower case alphanumerics and non-ASCII bytes separated by single spaces. Empty for
+    // messages of only punctuation, which are never cached.
+    static std::string NormalizeMessage(std::string const& message);
+    // Whether the reply uses either character's name as a word, in any case. The key leaves
+    // names out, so such a reply would be served to characters it does not fit.
+    static bool MentionsName(std::string const& reply, CharacterDetails const& responder, CharacterDetails const& sender);
+
+    // Returns a stored variant once the key holds its full set of variants
+    static bool Lookup(std::string const& key, LLMChatPriority priority, std::string& reply);
+    static void Store(std::string const& key, LLMChatPriority priority, std::string const& reply);
+
+    static LLMCacheStats GetStats();
+    static void ReportStats();
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::vector<std::string> variants;
+        uint32 nextVariant = 0;
+        std::chrono::steady_clock::time_point expiry;
+        size_t bytes = 0;
+    };
+    using EntryList = std::list<Entry>;
+
+    static void Erase(EntryList::iterator itr);
+    static void EvictToBudget(size_t maxBytes);
+
+    // Most recently used first
+    static EntryList s_entries;
+    static std::unordered_map<std::string, EntryList::iterator> s_index;
+    static std::mutex s_mutex;
+    static LLMCacheStats s_stats;
+};
+
+#endif // MOD_LLM_CHAT_CACHE_H
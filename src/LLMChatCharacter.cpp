@@ -159,7 +159,7 @@ bool LLMChatCharacter::SaveRPProfile(const CharacterDetails& details) {
         CharacterDatabase.Execute(
             "INSERT INTO `{}`.character_rp_profiles (name, profile) VALUES ('{}', '{}') "
             "ON DUPLICATE KEY UPDATE profile = '{}'",
-            LLM_Config.Database.CustomDB.c_str(),
+            sLLMConfig->Database.CustomDB.c_str(),
             details.name.c_str(), 
             details.description.c_str(), 
             details.description.c_str());
@@ -175,7 +175,7 @@ bool LLMChatCharacter::LoadRPProfile(CharacterDetails& details, std::string cons
     try {
         if (QueryResult result = CharacterDatabase.Query(
                 "SELECT profile FROM `{}`.character_rp_profiles WHERE name = '{}'",
-                LLM_Config.Database.CustomDB.c_str(),
+                sLLMConfig->Database.CustomDB.c_str(),
                 character_name.c_str())) {
             Field* fields = result->Fetch();
             details.description = fields[0].Get<std::string>();
@@ -225,7 +225,7 @@ CharacterDetails LLMChatCharacter::QueryCharacterFromDB(std::string const& name)
     try {
         if (QueryResult result = CharacterDatabase.Query(
                 "SELECT name, race, class, level, guild_id FROM `{}`.characters WHERE name = '{}'",
-                LLM_Config.Database.CharacterDB.c_str(),
+                sLLMConfig->Database.CharacterDB.c_str(),
                 name.c_str())) {
             Field* fields = result->Fetch();
             details.name = fields[0].Get<std::string>();
@@ -237,7 +237,7 @@ CharacterDetails LLMChatCharacter::QueryCharacterFromDB(std::string const& name)
             if (guildId > 0) {
                 if (QueryResult guildResult = CharacterDatabase.Query(
                         "SELECT name FROM `{}`.guild WHERE guildid = {}",
-                        LLM_Config.Database.CharacterDB.c_str(),
+                        sLLMConfig->Database.CharacterDB.c_str(),
                         guildId)) {
                     details.guildName = guildResult->Fetch()[0].Get<std::string>();
                 }
@@ -0,0 +1,163 @@
+#include "LLMChatCircuitBreaker.h"
+#include "mod-llm-chat-config.h"
+#include "Log.h"
+
+void LLMChatCircuitBreaker::ResetWindow()
+{
+    for (Bucket& bucket : m_buckets)
+        bucket = Bucket();
+}
+
+bool LLMChatCircuitBreaker::Allow()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Breaker.Enable)
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto now = std::chrono::steady_clock::now();
+
+    switch (m_state.load(std::memory_order_relaxed))
+    {
+        case LLM_BREAKER_CLOSED:
+            return true;
+        case LLM_BREAKER_OPEN:
+            if (now < m_openUntil)
+                break;
+            Transition(LLM_BREAKER_HALF_OPEN, now);
+            [[fallthrough]];
+        case LLM_BREAKER_HALF_OPEN:
+            if (m_probesInFlight + m_probeSuccesses < config->Breaker.HalfOpenProbes)
+            {
+                ++m_probesInFlight;
+                return true;
+            }
+            break;
+    }
+
+    ++m_rejected;
+    return false;
+}
+
+bool LLMChatCircuitBreaker::IsAvailable() const
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Breaker.Enable)
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    switch (m_state.load(std::memory_order_relaxed))
+    {
+        case LLM_BREAKER_CLOSED:
+            return true;
+        case LLM_BREAKER_OPEN:
+            return std::chrono::steady_clock::now() >= m_openUntil;
+        case LLM_BREAKER_HALF_OPEN:
+            return m_probesInFlight + m_probeSuccesses < config->Breaker.HalfOpenProbes;
+    }
+    return false;
+}
+
+void LLMChatCircuitBreaker::Record(bool success, std::chrono::milliseconds latency)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    struct LLMConfig::Breaker const& settings = config->Breaker;
+    if (!settings.Enable)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto now = std::chrono::steady_clock::now();
+    bool slow = latency >= settings.SlowCall;
+
+    switch (m_state.load(std::memory_order_relaxed))
+    {
+        case LLM_BREAKER_OPEN:
+            // Stragglers sent before the breaker opened say nothing new
+            return;
+        case LLM_BREAKER_HALF_OPEN:
+            if (m_probesInFlight)
+                --m_probesInFlight;
+            if (!success || slow)
+                Transition(LLM_BREAKER_OPEN, now);
+            else if (++m_probeSuccesses >= settings.HalfOpenProbes)
+                Transition(LLM_BREAKER_CLOSED, now);
+            return;
+        case LLM_BREAKER_CLOSED:
+            break;
+    }
+
+    uint64 second = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    Bucket& bucket = m_buckets[second % settings.Window];
+    if (bucket.second != second)
+        bucket = Bucket{ second };
+    ++bucket.calls;
+    bucket.failures += success ? 0 : 1;
+    bucket.slow += slow ? 1 : 0;
+
+    uint32 calls = 0, failures = 0, slowCalls = 0;
+    for (uint32 i = 0; i < settings.Window; ++i)
+    {
+        Bucket const& entry = m_buckets[i];
+        if (entry.second + settings.Window <= second)
+            continue;
+        calls += entry.calls;
+        failures += entry.failures;
+        slowCalls += entry.slow;
+    }
+
+    if (calls < settings.MinRequests)
+        return;
+
+    float failureRate = float(failures) / calls;
+    float slowRate = float(slowCalls) / calls;
+    if (failureRate >= settings.FailureRate || slowRate >= settings.SlowCallRate)
+    {
+        LOG_WARN("module", "[LLMChat] Backend {}: {:.0f}% failed, {:.0f}% slow over the last {} requests",
+            m_name, failureRate * 100.0f, slowRate * 100.0f, calls);
+        Transition(LLM_BREAKER_OPEN, now);
+    }
+}
+
+void LLMChatCircuitBreaker::Abandon()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_state.load(std::memory_order_relaxed) == LLM_BREAKER_HALF_OPEN && m_probesInFlight)
+        --m_probesInFlight;
+}
+
+void LLMChatCircuitBreaker::Transition(LLMBreakerState state, std::chrono::steady_clock::time_point now)
+{
+    m_state = state;
+    m_probesInFlight = 0;
+    m_probeSuccesses = 0;
+
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    switch (state)
+    {
+        case LLM_BREAKER_OPEN:
+            ++m_opened;
+            m_openUntil = now + config->Breaker.OpenDuration;
+            LOG_WARN("module", "[LLMChat] Backend {}: circuit breaker open for {}ms, failing requests fast",
+                m_name, config->Breaker.OpenDuration.count());
+            break;
+        case LLM_BREAKER_HALF_OPEN:
+            LOG_INFO("module", "[LLMChat] Backend {}: circuit breaker half-open, sending {} probes",
+                m_name, config->Breaker.HalfOpenProbes);
+            break;
+        case LLM_BREAKER_CLOSED:
+            ResetWindow();
+            LOG_INFO("module", "[LLMChat] Backend {}: circuit breaker closed, backend recovered", m_name);
+            break;
+    }
+}
+
+char const* LLMChatCircuitBreaker::GetStateName(LLMBreakerState state)
+{
+    switch (state)
+    {
+        case LLM_BREAKER_CLOSED:    return "closed";
+        case LLM_BREAKER_OPEN:      return "open";
+        case LLM_BREAKER_HALF_OPEN: return "half-open";
+        default:                    return "unknown";
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef MOD_LLM_CHAT_CIRCUIT_BREAKER_H
+#define MOD_LLM_CHAT_CIRCUIT_BREAKER_H
+
+#include "Define.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+enum LLMBreakerState : uint8
+{
+    LLM_BREAKER_CLOSED    = 0,  // Requests flow; outcomes are counted
+    LLM_BREAKER_OPEN      = 1,  // Requests fail at once until the open period ends
+    LLM_BREAKER_HALF_OPEN = 2,  // A few probes decide between closing and opening again
+};
+
+// Stops sending work to a backend that keeps failing or has slowed to a crawl, so
+// messages get their fallback at once instead of after a full timeout each. Outcomes
+// are counted in one-second buckets over a sliding window. The thresholds are read from
+// the current config snapshot on every call, so a reload applies to the next request.
+class LLMChatCircuitBreaker
+{
+public:
+    explicit LLMChatCircuitBreaker(std::string name) : m_name(std::move(name)) {}
+
+    // Whether a request may go out now; in half-open state only the probes may
+    bool Allow();
+    // Whether Allow would let a request through, without taking a probe slot
+    bool IsAvailable() const;
+    void Record(bool success, std::chrono::milliseconds latency);
+    // An allowed request ended without an outcome worth counting (cancelled)
+    void Abandon();
+
+    LLMBreakerState GetState() const { return m_state.load(std::memory_order_relaxed); }
+    uint64 GetRejected() const { return m_rejected.load(std::memory_order_relaxed); }
+    uint64 GetOpened() const { return m_opened.load(std::memory_order_relaxed); }
+    static char const* GetStateName(LLMBreakerState state);
+
+private:
+    struct Bucket
+    {
+        uint64 second = 0;
+        uint32 calls = 0;
+        uint32 failures = 0;
+        uint32 slow = 0;
+    };
+
+    static constexpr uint32 MAX_WINDOW_SECONDS = 60;
+
+    void Transition(LLMBreakerState state, std::chrono::steady_clock::time_point now);
+    void ResetWindow();
+
+    std::string m_name;
+    std::array<Bucket, MAX_WINDOW_SECONDS> m_buckets;
+    std::chrono::steady_clock::time_point m_openUntil;
+    uint32 m_probesInFlight = 0;
+    uint32 m_probeSuccesses = 0;
+    std::atomic<LLMBreakerState> m_state{LLM_BREAKER_CLOSED};
+    std::atomic<uint64> m_rejected{0};
+    std::atomic<uint64> m_opened{0};
+    mutable std::mutex m_mutex;
+};
+
+#endif // MOD_LLM_CHAT_CIRCUIT_BREAKER_H
@@ -0,0 +1,41 @@
+#include "LLMChatMetrics.h"
+#include "Chat.h"
+#include "ScriptMgr.h"
+
+using namespace Acore::ChatCommands;
+
+class LLMChatCommandScript : public CommandScript
+{
+public:
+    LLMChatCommandScript() : CommandScript("LLMChatCommandScript") {}
+
+    ChatCommandTable GetCommands() const override
+    {
+        static ChatCommandTable llmChatCommandTable =
+        {
+            { "stats", HandleStatsCommand, SEC_GAMEMASTER, Console::Yes }
+        };
+
+        static ChatCommandTable commandTable =
+        {
+            { "llmchat", llmChatCommandTable }
+        };
+
+        return commandTable;
+    }
+
+    // Queue depth, outcome counters and latency percentiles since startup
+    static bool HandleStatsCommand(ChatHandler* handler)
+    {
+        std::vector<std::string> lines;
+        LLMChatMetrics::FormatSummary(lines);
+        for (std::string const& line : lines)
+            handler->SendSysMessage(line);
+        return true;
+    }
+};
+
+void AddLLMChatCommandScripts()
+{
+    new LLMChatCommandScript();
+}
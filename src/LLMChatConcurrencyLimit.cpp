@@ -0,0 +1,102 @@
+#include "LLMChatConcurrencyLimit.h"
+#include "mod-llm-chat-config.h"
+#include "Log.h"
+#include <algorithm>
+
+void LLMChatConcurrencyLimit::Configure(uint32 maxLimit)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxLimit = std::max<uint32>(1, maxLimit);
+    m_limit = config->Engine.AdaptiveLimit ? std::min(config->Engine.InitialInFlight, m_maxLimit) : m_maxLimit;
+    m_baseline = std::chrono::milliseconds(0);
+    m_windowMin = std::chrono::milliseconds(0);
+    m_windowSamples = 0;
+    m_lastDecrease = {};
+    Publish();
+}
+
+void LLMChatConcurrencyLimit::OnSuccess(std::chrono::steady_clock::time_point sentAt, std::chrono::milliseconds latency,
+    uint32 inFlight)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!config->Engine.AdaptiveLimit)
+    {
+        // Turned off by a reload: back to the full ceiling
+        if (m_limit != m_maxLimit)
+        {
+            m_limit = m_maxLimit;
+            Publish();
+        }
+        return;
+    }
+
+    // The baseline follows the best latency of the last window, so it recovers if the
+    // backend moves to slower hardware or a larger model
+    if (!m_windowSamples || latency < m_windowMin)
+        m_windowMin = latency;
+    if (++m_windowSamples >= config->Engine.BaselineWindow || m_baseline.count() == 0)
+    {
+        m_baseline = std::max(m_windowMin, std::chrono::milliseconds(1));
+        m_windowSamples = 0;
+    }
+
+    if (latency.count() > m_baseline.count() * config->Engine.LatencyTolerance)
+    {
+        Decrease(sentAt, std::chrono::steady_clock::now(), *config);
+        return;
+    }
+
+    if (inFlight * 2 < m_limit)
+        return;
+
+    m_limit = std::min<double>(m_maxLimit, m_limit + 1.0 / m_limit);
+    Publish();
+}
+
+void LLMChatConcurrencyLimit::OnFailure(std::chrono::steady_clock::time_point sentAt)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Engine.AdaptiveLimit)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Decrease(sentAt, std::chrono::steady_clock::now(), *config);
+}
+
+void LLMChatConcurrencyLimit::Decrease(std::chrono::steady_clock::time_point sentAt, std::chrono::steady_clock::time_point now,
+    LLMConfig const& config)
+{
+    if (sentAt < m_lastDecrease)
+        return;
+
+    m_lastDecrease = now;
+    uint32 previous = static_cast<uint32>(m_limit);
+    m_limit = std::max<double>(std::min(config.Engine.MinInFlight, m_maxLimit), m_limit * config.Engine.Backoff);
+    Publish();
+
+    if (static_cast<uint32>(m_limit) != previous)
+        LOG_DEBUG("module", "[LLMChat] Concurrency limit lowered to {} (baseline latency {}ms)",
+            static_cast<uint32>(m_limit), m_baseline.count());
+}
+
+void LLMChatConcurrencyLimit::SetMaxLimit(uint32 maxLimit)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxLimit = std::clamp<uint32>(maxLimit, 1, m_maxLimit);
+    m_limit = std::min<double>(m_limit, m_maxLimit);
+    Publish();
+}
+
+double LLMChatConcurrencyLimit::GetLimit() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_limit;
+}
+
+std::chrono::milliseconds LLMChatConcurrencyLimit::GetBaseline() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_baseline;
+}
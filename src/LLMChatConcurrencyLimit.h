@@ -0,0 +1,47 @@
+#ifndef MOD_LLM_CHAT_CONCURRENCY_LIMIT_H
+#define MOD_LLM_CHAT_CONCURRENCY_LIMIT_H
+
+#include "Define.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+struct LLMConfig;
+
+// AIMD limit on requests in flight to one backend. The limit grows by about one per
+// limit's worth of fast responses and is cut by LLMChat.Engine.Backoff once latency
+// climbs well past the best recently seen, or a request fails. Only requests sent after
+// the last cut may cut it again, so one slow burst costs a single step. The tuning is
+// read from the current config snapshot per sample; only the ceiling and the starting
+// limit are set here.
+class LLMChatConcurrencyLimit
+{
+public:
+    // Starts at LLMChat.Engine.InitialInFlight, never above `maxLimit`
+    void Configure(uint32 maxLimit);
+
+    uint32 Get() const { return m_current.load(std::memory_order_relaxed); }
+    // `inFlight` is the load the sample was taken under; an idle backend says nothing about its limit
+    void OnSuccess(std::chrono::steady_clock::time_point sentAt, std::chrono::milliseconds latency, uint32 inFlight);
+    void OnFailure(std::chrono::steady_clock::time_point sentAt);
+    // Lowers the ceiling to what the backend says it can serve at once
+    void SetMaxLimit(uint32 maxLimit);
+
+    double GetLimit() const;
+    std::chrono::milliseconds GetBaseline() const;
+
+private:
+    void Decrease(std::chrono::steady_clock::time_point sentAt, std::chrono::steady_clock::time_point now, LLMConfig const& config);
+    void Publish() { m_current.store(static_cast<uint32>(m_limit), std::memory_order_relaxed); }
+
+    uint32 m_maxLimit = 64;
+    double m_limit = 8.0;
+    std::chrono::milliseconds m_baseline{0};        // Lowest latency of the previous window; 0 until learnt
+    std::chrono::milliseconds m_windowMin{0};
+    uint32 m_windowSamples = 0;
+    std::chrono::steady_clock::time_point m_lastDecrease;
+    std::atomic<uint32> m_current{8};
+    mutable std::mutex m_mutex;
+};
+
+#endif // MOD_LLM_CHAT_CONCURRENCY_LIMIT_H
@@ -0,0 +1,317 @@
+#include "mod-llm-chat-config.h"
+#include "LLMChatPromptTemplate.h"
+#include "Log.h"
+#include "Configuration/Config.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <sstream>
+
+// Static member initialization
+std::atomic<std::shared_ptr<LLMConfig const>> LLMChatConfig::s_config{std::make_shared<LLMConfig const>()};
+std::atomic<uint32> LLMChatConfig::s_generation{1};
+
+bool LLMEndpoint::Parse(std::string const& url, LLMEndpoint& endpoint)
+{
+    std::string hostAndPath;
+    if (url.rfind("https://", 0) == 0)
+    {
+        endpoint.useSsl = true;
+        hostAndPath = url.substr(8);
+    }
+    else if (url.rfind("http://", 0) == 0)
+    {
+        endpoint.useSsl = false;
+        hostAndPath = url.substr(7);
+    }
+    else
+        return false;
+
+    size_t slashPos = hostAndPath.find('/');
+    endpoint.host = hostAndPath.substr(0, slashPos);
+    endpoint.target = slashPos != std::string::npos ? hostAndPath.substr(slashPos) : "/";
+
+    // Extract port if specified, otherwise use default
+    size_t colonPos = endpoint.host.find(':');
+    if (colonPos != std::string::npos)
+    {
+        endpoint.port = endpoint.host.substr(colonPos + 1);
+        endpoint.host = endpoint.host.substr(0, colonPos);
+    }
+    else
+        endpoint.port = endpoint.useSsl ? "443" : "80";
+
+    return !endpoint.host.empty() && !endpoint.port.empty();
+}
+
+static std::string TrimField(std::string const& text)
+{
+    size_t begin = text.find_first_not_of(" \t\"");
+    size_t end = text.find_last_not_of(" \t\"");
+    return begin == std::string::npos ? std::string() : text.substr(begin, end - begin + 1);
+}
+
+// "url|model|weight" entries separated by commas; model and weight may be left out
+static std::vector<LLMEndpointConfig> ParseEndpoints(std::string const& list, std::string const& defaultModel)
+{
+    std::vector<LLMEndpointConfig> endpoints;
+    std::stringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, ','))
+    {
+        std::vector<std::string> fields;
+        std::stringstream parts(entry);
+        std::string field;
+        while (std::getline(parts, field, '|'))
+            fields.push_back(TrimField(field));
+
+        if (fields.empty() || fields[0].empty())
+            continue;
+
+        LLMEndpointConfig endpoint;
+        if (!LLMEndpoint::Parse(fields[0], endpoint.endpoint))
+        {
+            LOG_ERROR("module", "[LLMChat] Ignoring invalid endpoint '{}'", fields[0]);
+            continue;
+        }
+
+        endpoint.url = fields[0];
+        endpoint.model = fields.size() > 1 && !fields[1].empty() ? fields[1] : defaultModel;
+        endpoint.weight = fields.size() > 2 ? std::max<uint32>(1, std::strtoul(fields[2].c_str(), nullptr, 10)) : 1;
+        endpoints.push_back(std::move(endpoint));
+    }
+    return endpoints;
+}
+
+// "|"-separated; a literal \n stands for a line break, which the .conf format cannot hold
+static std::vector<std::string> ParseStopSequences(std::string const& list)
+{
+    std::vector<std::string> sequences;
+    std::stringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, '|'))
+    {
+        std::string sequence;
+        for (size_t i = 0; i < entry.size(); ++i)
+        {
+            if (entry[i] == '\\' && i + 1 < entry.size() && entry[i + 1] == 'n')
+            {
+                sequence += '\n';
+                ++i;
+            }
+            else
+                sequence += entry[i];
+        }
+        if (!sequence.empty())
+            sequences.push_back(std::move(sequence));
+    }
+    return sequences;
+}
+
+// A relative log file name goes into the directory the server writes its own logs to
+static std::string ResolveLogPath(std::string path)
+{
+    path = TrimField(path);
+    if (path.empty() || std::filesystem::path(path).is_absolute())
+        return path;
+
+    std::string logsDir = sConfigMgr->GetOption<std::string>("LogsDir", "");
+    if (logsDir.empty())
+        return path;
+    return (std::filesystem::path(logsDir) / path).string();
+}
+
+std::shared_ptr<LLMConfig const> LLMConfig::Load()
+{
+    auto config = std::make_shared<LLMConfig>();
+    config->Enable = sConfigMgr->GetOption<bool>("LLMChat.Enable", true);
+    config->Logging.LogLevel = sConfigMgr->GetOption<uint32>("LLMChat.LogLevel", config->Logging.LogLevel);
+    config->Logging.LogToConsole = sConfigMgr->GetOption<bool>("LLMChat.Log.Console", config->Logging.LogToConsole);
+    config->Logging.LogToFile = sConfigMgr->GetOption<bool>("LLMChat.Log.ToFile", config->Logging.LogToFile);
+    config->Logging.LogFile = ResolveLogPath(sConfigMgr->GetOption<std::string>("LLMChat.Log.File", config->Logging.LogFile));
+    config->Logging.TranscriptFile = ResolveLogPath(sConfigMgr->GetOption<std::string>("LLMChat.Log.TranscriptFile", ""));
+    config->Logging.MaxFileSize = uint64(sConfigMgr->GetOption<uint32>("LLMChat.Log.MaxFileSize", 10)) * 1024 * 1024;
+    config->Logging.MaxFiles = sConfigMgr->GetOption<uint32>("LLMChat.Log.MaxFiles", config->Logging.MaxFiles);
+    config->Logging.SampleEvery = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Log.SampleEvery", config->Logging.SampleEvery));
+    config->Logging.QueueSize = std::max<uint32>(2, sConfigMgr->GetOption<uint32>("LLMChat.Log.QueueSize", config->Logging.QueueSize));
+    config->Chat.Announce = sConfigMgr->GetOption<bool>("LLMChat.Announce", config->Chat.Announce);
+    config->Chat.ChatRange = sConfigMgr->GetOption<float>("LLMChat.ChatRange", config->Chat.ChatRange);
+    config->Chat.ResponseCooldown = sConfigMgr->GetOption<uint32>("LLMChat.ResponseCooldown", config->Chat.ResponseCooldown);
+
+    config->API.Model = sConfigMgr->GetOption<std::string>("LLMChat.Model", config->API.Model);
+    config->API.APIKey = sConfigMgr->GetOption<std::string>("LLMChat.ApiKey", "");
+    std::string endpoints = sConfigMgr->GetOption<std::string>("LLMChat.Endpoints", "");
+    if (TrimField(endpoints).empty())
+        endpoints = sConfigMgr->GetOption<std::string>("LLMChat.Endpoint", "http://localhost:11434/api/generate");
+    config->API.Endpoints = ParseEndpoints(endpoints, config->API.Model);
+    config->API.MaxTokens = sConfigMgr->GetOption<uint32>("LLMChat.MaxTokens", config->API.MaxTokens);
+    // Kept to three decimals so 0.7 goes out as 0.7 rather than the float's 0.699999988
+    config->API.Temperature = std::round(sConfigMgr->GetOption<float>("LLMChat.Temperature", 0.7f) * 1000.0) / 1000.0;
+    config->API.StopSequences = ParseStopSequences(sConfigMgr->GetOption<std::string>("LLMChat.StopSequences", "\\n\\n"));
+    config->API.PromptTokens = sConfigMgr->GetOption<uint32>("LLMChat.Prompt.MaxTokens", config->API.PromptTokens);
+
+    config->Prompts = LLMPromptTemplates::Load(sConfigMgr->GetOption<std::string>("LLMChat.Prompt.Directory", ""));
+
+    config->Queue.Shards = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Queue.Shards", config->Queue.Shards));
+    config->Queue.ShardCapacity = std::max<uint32>(2, sConfigMgr->GetOption<uint32>("LLMChat.Queue.ShardCapacity",
+        config->Queue.ShardCapacity));
+    config->Queue.MailboxCapacity = std::max<uint32>(2, sConfigMgr->GetOption<uint32>("LLMChat.Queue.MailboxCapacity",
+        config->Queue.MailboxCapacity));
+    config->Queue.ReportInterval = std::chrono::seconds(sConfigMgr->GetOption<uint32>("LLMChat.Queue.ReportInterval", 60));
+    config->Queue.Supersede = sConfigMgr->GetOption<bool>("LLMChat.Queue.Supersede", config->Queue.Supersede);
+    config->Queue.Coalesce = sConfigMgr->GetOption<bool>("LLMChat.Coalesce.Enable", config->Queue.Coalesce);
+    config->Queue.CoalesceMaxSpeakers = std::max<uint32>(2, sConfigMgr->GetOption<uint32>("LLMChat.Coalesce.MaxSpeakers",
+        config->Queue.CoalesceMaxSpeakers));
+    config->Queue.MaxResponses = sConfigMgr->GetOption<uint32>("LLMChat.Queue.MaxResponses", config->Queue.MaxResponses);
+    config->Queue.GlobalCooldown = sConfigMgr->GetOption<uint32>("LLMChat.Queue.GlobalCooldown", config->Queue.GlobalCooldown);
+    config->Queue.GlobalBurst = sConfigMgr->GetOption<uint32>("LLMChat.Queue.GlobalBurst", config->Queue.GlobalBurst);
+    config->Queue.SenderBurst = sConfigMgr->GetOption<uint32>("LLMChat.Queue.SenderBurst", config->Queue.SenderBurst);
+    config->Queue.BotCooldown = sConfigMgr->GetOption<uint32>("LLMChat.Queue.BotCooldown", config->Queue.BotCooldown);
+    config->Queue.BotBurst = sConfigMgr->GetOption<uint32>("LLMChat.Queue.BotBurst", config->Queue.BotBurst);
+
+    // Per-class defaults: the more likely a real player is waiting on the answer, the longer it may queue.
+    // Whispers are personal, so their cached replies go stale sooner than small talk in public chat.
+    static constexpr uint32 defaultCapacity[LLM_PRIORITY_COUNT] = { 256, 256, 128, 64 };
+    static constexpr uint32 defaultMaxAge[LLM_PRIORITY_COUNT] = { 60000, 30000, 15000, 10000 };
+    static constexpr uint32 defaultDeadline[LLM_PRIORITY_COUNT] = { 90000, 60000, 30000, 30000 };
+    static constexpr bool defaultHedge[LLM_PRIORITY_COUNT] = { true, false, false, false };
+    static constexpr uint32 defaultCacheTtl[LLM_PRIORITY_COUNT] = { 300, 600, 900, 900 };
+    for (uint8 i = 0; i < LLM_PRIORITY_COUNT; ++i)
+    {
+        std::string name = GetPriorityClassName(LLMChatPriority(i));
+        std::string prefix = "LLMChat.Priority." + name + ".";
+        PriorityClass& priorityClass = config->Priority.Classes[i];
+        priorityClass.Capacity = sConfigMgr->GetOption<uint32>(prefix + "Capacity", defaultCapacity[i]);
+        priorityClass.MaxAge = std::chrono::milliseconds(sConfigMgr->GetOption<uint32>(prefix + "MaxAge", defaultMaxAge[i]));
+        priorityClass.Deadline = std::chrono::milliseconds(sConfigMgr->GetOption<uint32>(prefix + "Deadline", defaultDeadline[i]));
+        priorityClass.Hedge = sConfigMgr->GetOption<bool>(prefix + "Hedge", defaultHedge[i]);
+        config->Cache.TTL[i] = std::chrono::seconds(sConfigMgr->GetOption<uint32>("LLMChat.Cache." + name + ".TTL",
+            defaultCacheTtl[i]));
+    }
+    config->Priority.HighWaterMark = sConfigMgr->GetOption<uint32>("LLMChat.Priority.HighWaterMark", config->Priority.HighWaterMark);
+    config->Priority.ShedFrom = LLMChatPriority(std::min<uint32>(sConfigMgr->GetOption<uint32>("LLMChat.Priority.ShedFrom",
+        config->Priority.ShedFrom), LLM_PRIORITY_COUNT - 1));
+    config->Priority.ShedWithTemplate = sConfigMgr->GetOption<bool>("LLMChat.Priority.ShedWithTemplate",
+        config->Priority.ShedWithTemplate);
+    config->Priority.ReservedSlots = sConfigMgr->GetOption<uint32>("LLMChat.Priority.ReservedSlots", config->Priority.ReservedSlots);
+
+    config->Stream.Enable = sConfigMgr->GetOption<bool>("LLMChat.Stream.Enable", config->Stream.Enable);
+    config->Stream.MaxLineLength = std::clamp<uint32>(sConfigMgr->GetOption<uint32>("LLMChat.Stream.MaxLineLength",
+        config->Stream.MaxLineLength), 32, 255);
+    config->Stream.FirstLineDelay = sConfigMgr->GetOption<uint32>("LLMChat.Stream.FirstLineDelay", config->Stream.FirstLineDelay);
+    config->Stream.LineDelay = sConfigMgr->GetOption<uint32>("LLMChat.Stream.LineDelay", config->Stream.LineDelay);
+
+    config->Cache.Enable = sConfigMgr->GetOption<bool>("LLMChat.Cache.Enable", config->Cache.Enable);
+    config->Cache.MaxBytes = sConfigMgr->GetOption<uint32>("LLMChat.Cache.MaxBytes", 8 * 1024 * 1024);
+    config->Cache.Variants = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Cache.Variants", config->Cache.Variants));
+
+    config->Similarity.Enable = sConfigMgr->GetOption<bool>("LLMChat.Similarity.Enable", config->Similarity.Enable);
+    config->Similarity.Threshold = std::clamp(sConfigMgr->GetOption<float>("LLMChat.Similarity.Threshold",
+        config->Similarity.Threshold), 0.0f, 1.0f);
+    config->Similarity.MaxDistance = static_cast<uint32>(std::floor((1.0f - config->Similarity.Threshold) * 64.0f + 0.0001f));
+    config->Similarity.MinTokens = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Similarity.MinTokens",
+        config->Similarity.MinTokens));
+    config->Similarity.EntriesPerProfile = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Similarity.EntriesPerProfile",
+        config->Similarity.EntriesPerProfile));
+    config->Similarity.MaxProfiles = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Similarity.MaxProfiles",
+        config->Similarity.MaxProfiles));
+    config->Similarity.TTL = std::chrono::seconds(sConfigMgr->GetOption<uint32>("LLMChat.Similarity.TTL", 600));
+
+    config->Engine.Threads = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Engine.Threads", config->Engine.Threads));
+    config->Engine.MaxInFlight = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Engine.MaxInFlight",
+        config->Engine.MaxInFlight));
+    config->Engine.PhaseTimeout = std::chrono::milliseconds(std::max<uint32>(1000,
+        sConfigMgr->GetOption<uint32>("LLMChat.Engine.PhaseTimeout", 30000)));
+    config->Engine.MaxResponseBytes = std::max<uint32>(64 * 1024, sConfigMgr->GetOption<uint32>("LLMChat.Engine.MaxResponseBytes",
+        config->Engine.MaxResponseBytes));
+    config->Engine.AdaptiveLimit = sConfigMgr->GetOption<bool>("LLMChat.Engine.AdaptiveLimit", config->Engine.AdaptiveLimit);
+    config->Engine.MinInFlight = std::clamp<uint32>(sConfigMgr->GetOption<uint32>("LLMChat.Engine.MinInFlight",
+        config->Engine.MinInFlight), 1, config->Engine.MaxInFlight);
+    config->Engine.InitialInFlight = std::clamp<uint32>(sConfigMgr->GetOption<uint32>("LLMChat.Engine.InitialInFlight",
+        config->Engine.InitialInFlight), config->Engine.MinInFlight, config->Engine.MaxInFlight);
+    config->Engine.LatencyTolerance = std::max(1.1f, sConfigMgr->GetOption<float>("LLMChat.Engine.LatencyTolerance",
+        config->Engine.LatencyTolerance));
+    config->Engine.Backoff = std::clamp(sConfigMgr->GetOption<float>("LLMChat.Engine.Backoff", config->Engine.Backoff), 0.1f, 0.99f);
+    config->Engine.BaselineWindow = std::max<uint32>(10, sConfigMgr->GetOption<uint32>("LLMChat.Engine.BaselineWindow",
+        config->Engine.BaselineWindow));
+
+    std::string strategy = sConfigMgr->GetOption<std::string>("LLMChat.Balancer.Strategy", "least-outstanding");
+    config->Balancer.Strategy = strategy == "ewma" ? LLM_BALANCER_EWMA : LLM_BALANCER_LEAST_OUTSTANDING;
+    config->Balancer.EjectAfter = sConfigMgr->GetOption<uint32>("LLMChat.Balancer.EjectAfter", config->Balancer.EjectAfter);
+    config->Balancer.EjectTime = std::chrono::milliseconds(sConfigMgr->GetOption<uint32>("LLMChat.Balancer.EjectTime", 10000));
+    config->Balancer.MaxEjectTime = std::max(config->Balancer.EjectTime,
+        std::chrono::milliseconds(sConfigMgr->GetOption<uint32>("LLMChat.Balancer.MaxEjectTime", 120000)));
+
+    config->Breaker.Enable = sConfigMgr->GetOption<bool>("LLMChat.Breaker.Enable", config->Breaker.Enable);
+    config->Breaker.Window = std::clamp<uint32>(sConfigMgr->GetOption<uint32>("LLMChat.Breaker.Window", config->Breaker.Window), 1, 60);
+    config->Breaker.MinRequests = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Breaker.MinRequests",
+        config->Breaker.MinRequests));
+    config->Breaker.FailureRate = std::clamp(sConfigMgr->GetOption<float>("LLMChat.Breaker.FailureRate", 50.0f), 1.0f, 100.0f) / 100.0f;
+    config->Breaker.SlowCall = std::chrono::milliseconds(sConfigMgr->GetOption<uint32>("LLMChat.Breaker.SlowCall", 20000));
+    config->Breaker.SlowCallRate = std::clamp(sConfigMgr->GetOption<float>("LLMChat.Breaker.SlowCallRate", 80.0f), 1.0f, 100.0f) / 100.0f;
+    config->Breaker.OpenDuration = std::chrono::milliseconds(sConfigMgr->GetOption<uint32>("LLMChat.Breaker.OpenDuration", 15000));
+    config->Breaker.HalfOpenProbes = std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Breaker.HalfOpenProbes",
+        config->Breaker.HalfOpenProbes));
+
+    config->Hedge.Percentile = std::clamp(sConfigMgr->GetOption<float>("LLMChat.Hedge.Percentile", 95.0f), 50.0f, 99.9f) / 100.0f;
+    config->Hedge.MinDelay = std::chrono::milliseconds(sConfigMgr->GetOption<uint32>("LLMChat.Hedge.MinDelay", 1000));
+    config->Hedge.MinSamples = std::clamp<uint32>(sConfigMgr->GetOption<uint32>("LLMChat.Hedge.MinSamples", config->Hedge.MinSamples),
+        1, 256);
+    config->Hedge.MaxRate = std::clamp(sConfigMgr->GetOption<float>("LLMChat.Hedge.MaxRate", 5.0f), 0.0f, 100.0f) / 100.0f;
+
+    config->Pool.MaxIdle = sConfigMgr->GetOption<uint32>("LLMChat.Pool.MaxIdle", config->Pool.MaxIdle);
+    config->Pool.IdleTimeout = std::chrono::seconds(sConfigMgr->GetOption<uint32>("LLMChat.Pool.IdleTimeout", 30));
+    config->Pool.DnsTtl = std::chrono::seconds(sConfigMgr->GetOption<uint32>("LLMChat.Pool.DnsTtl", 300));
+    config->Tls.Verify = sConfigMgr->GetOption<bool>("LLMChat.Tls.Verify", config->Tls.Verify);
+    config->Tls.CaFile = sConfigMgr->GetOption<std::string>("LLMChat.Tls.CaFile", "");
+
+    config->Warmup.Enable = sConfigMgr->GetOption<bool>("LLMChat.Warmup.Enable", config->Warmup.Enable);
+    config->Warmup.Prompt = sConfigMgr->GetOption<std::string>("LLMChat.Warmup.Prompt", config->Warmup.Prompt);
+    config->Warmup.KeepAlive = sConfigMgr->GetOption<std::string>("LLMChat.Warmup.KeepAlive", config->Warmup.KeepAlive);
+    config->Warmup.PingInterval = std::chrono::seconds(sConfigMgr->GetOption<uint32>("LLMChat.Warmup.PingInterval", 600));
+
+    config->Presence.RefreshInterval = std::chrono::milliseconds(sConfigMgr->GetOption<uint32>("LLMChat.Presence.RefreshInterval", 500));
+
+    config->Metrics.File = sConfigMgr->GetOption<std::string>("LLMChat.Metrics.File", "");
+    config->Metrics.Interval = std::chrono::seconds(std::max<uint32>(1, sConfigMgr->GetOption<uint32>("LLMChat.Metrics.Interval", 15)));
+
+    config->Trace.File = sConfigMgr->GetOption<std::string>("LLMChat.Trace.File", "");
+    config->Trace.TailFraction = std::clamp(sConfigMgr->GetOption<float>("LLMChat.Trace.TailPercent", 1.0f), 0.0f, 100.0f) / 100.0;
+    config->Trace.SampleEvery = sConfigMgr->GetOption<uint32>("LLMChat.Trace.SampleEvery", config->Trace.SampleEvery);
+    config->Trace.MaxFileSize = uint64(sConfigMgr->GetOption<uint32>("LLMChat.Trace.MaxFileSize", 100)) * 1024 * 1024;
+
+    return config;
+}
+
+char const* LLMConfig::GetPriorityClassName(LLMChatPriority priority)
+{
+    switch (priority)
+    {
+        case LLM_PRIORITY_WHISPER: return "Whisper";
+        case LLM_PRIORITY_GROUP:   return "Group";
+        case LLM_PRIORITY_LOCAL:   return "Local";
+        case LLM_PRIORITY_CHANNEL: return "Channel";
+        default:                   return "Unknown";
+    }
+}
+
+void LLMChatConfig::Load()
+{
+    s_config.store(LLMConfig::Load(), std::memory_order_release);
+    // After the store: a reader that sees the new generation also finds the new snapshot
+    s_generation.fetch_add(1, std::memory_order_release);
+}
+
+std::shared_ptr<LLMConfig const> LLMChatConfig::Get()
+{
+    thread_local std::shared_ptr<LLMConfig const> t_config;
+    thread_local uint32 t_generation = 0;
+
+    uint32 generation = s_generation.load(std::memory_order_acquire);
+    if (generation != t_generation)
+    {
+        t_config = s_config.load(std::memory_order_acquire);
+        t_generation = generation;
+    }
+    return t_config;
+}
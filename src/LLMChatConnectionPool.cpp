@@ -0,0 +1,328 @@
+#include "LLMChatConnectionPool.h"
+#include "Log.h"
+#include <boost/asio/ssl/host_name_verification.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+namespace net = boost::asio;
+namespace ssl = net::ssl;
+using tcp = net::ip::tcp;
+
+// Static member initialization
+std::map<std::string, std::deque<std::unique_ptr<LLMConnection>>> LLMChatConnectionPool::s_idle;
+std::map<std::string, LLMChatConnectionPool::DnsEntry> LLMChatConnectionPool::s_dnsCache;
+std::shared_ptr<ssl::context> LLMChatConnectionPool::s_tlsContext;
+struct LLMConfig::Tls LLMChatConnectionPool::s_tlsSettings;
+std::map<std::string, std::shared_ptr<SSL_SESSION>> LLMChatConnectionPool::s_tlsSessions;
+std::mutex LLMChatConnectionPool::s_mutex;
+LLMPoolStats LLMChatConnectionPool::s_stats;
+
+LLMStream::LLMStream(boost::asio::any_io_executor const& executor, ssl::context* tlsContext)
+{
+    if (tlsContext)
+        m_tls = std::make_unique<TlsStream>(executor, *tlsContext);
+    else
+        m_tcp = std::make_unique<boost::beast::tcp_stream>(executor);
+}
+
+void LLMChatConnectionPool::Initialize()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_stats = LLMPoolStats();
+    LoadTlsContext(config->Tls);
+}
+
+std::shared_ptr<ssl::context> LLMChatConnectionPool::GetTlsContext(struct LLMConfig::Tls const& settings)
+{
+    if (s_tlsContext && settings.Verify == s_tlsSettings.Verify && settings.CaFile == s_tlsSettings.CaFile)
+        return s_tlsContext;
+
+    LOG_INFO("module", "[LLMChat] TLS: settings changed, new connections use them");
+    LoadTlsContext(settings);
+    for (auto itr = s_idle.begin(); itr != s_idle.end();)
+    {
+        if (itr->first.rfind("tls://", 0) == 0)
+            itr = s_idle.erase(itr);
+        else
+            ++itr;
+    }
+    return s_tlsContext;
+}
+
+void LLMChatConnectionPool::LoadTlsContext(struct LLMConfig::Tls const& settings)
+{
+    s_tlsSettings = settings;
+    std::string const& caFile = settings.CaFile;
+
+    s_tlsContext = std::make_shared<ssl::context>(ssl::context::tls_client);
+    s_tlsContext->set_options(ssl::context::default_workarounds | ssl::context::no_sslv2 | ssl::context::no_sslv3 |
+        ssl::context::no_tlsv1 | ssl::context::no_tlsv1_1);
+    s_tlsContext->set_verify_mode(settings.Verify ? ssl::verify_peer : ssl::verify_none);
+    // Sessions are kept per endpoint by the pool itself, see StoreSession
+    SSL_CTX_set_session_cache_mode(s_tlsContext->native_handle(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+
+    boost::system::error_code ec;
+    s_tlsContext->set_default_verify_paths(ec);
+    if (ec)
+        LOG_WARN("module", "[LLMChat] TLS: system certificate store unavailable: {}", ec.message());
+
+    if (!caFile.empty())
+    {
+        s_tlsContext->load_verify_file(caFile, ec);
+        if (ec)
+            LOG_ERROR("module", "[LLMChat] TLS: cannot load CA file {}: {}", caFile, ec.message());
+    }
+
+    if (!settings.Verify)
+        LOG_WARN("module", "[LLMChat] TLS: LLMChat.Tls.Verify is off; https endpoints are not authenticated");
+
+    s_tlsSessions.clear();
+}
+
+void LLMChatConnectionPool::Shutdown()
+{
+    LLMPoolStats stats = GetStats();
+    LOG_INFO("module", "[LLMChat] Connection pool: {} hits, {} misses, {} stale retries, {} expired, DNS {} hits / {} misses, "
+        "TLS {} full / {} resumed handshakes", stats.hits, stats.misses, stats.staleRetries, stats.expired, stats.dnsHits,
+        stats.dnsMisses, stats.tlsHandshakes, stats.tlsResumed);
+
+    // Sockets must be closed while their io_context still exists
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_idle.clear();
+    s_dnsCache.clear();
+    s_tlsSessions.clear();
+}
+
+// Non-blocking peek: an idle keep-alive socket should have nothing to read
+static bool IsPeerClosed(tcp::socket& socket)
+{
+    boost::system::error_code ec;
+    socket.non_blocking(true, ec);
+    if (ec)
+        return true;
+
+    char byte;
+    socket.receive(net::buffer(&byte, 1), tcp::socket::message_peek, ec);
+    bool closed = ec != net::error::would_block;
+
+    socket.non_blocking(false, ec);
+    return closed || ec;
+}
+
+net::awaitable<std::unique_ptr<LLMConnection>> LLMChatConnectionPool::Acquire(LLMEndpoint const& endpoint,
+    std::chrono::steady_clock::duration connectTimeout, bool allowReuse, LLMTrace* trace, LLMTraceTrack track)
+{
+    // Plain and TLS connections to one address are not interchangeable
+    std::string address = endpoint.host + ":" + endpoint.port;
+    std::string key = endpoint.useSsl ? "tls://" + address : address;
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::shared_ptr<ssl::context> tlsContext;
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (endpoint.useSsl)
+            tlsContext = GetTlsContext(config->Tls);
+
+        auto itr = s_idle.find(key);
+        if (allowReuse && itr != s_idle.end())
+        {
+            auto now = std::chrono::steady_clock::now();
+            // Most recently used first; it is the least likely to have been closed by the server
+            while (!itr->second.empty())
+            {
+                std::unique_ptr<LLMConnection> connection = std::move(itr->second.back());
+                itr->second.pop_back();
+
+                if (now - connection->lastUsed > config->Pool.IdleTimeout || !connection->stream.socket().is_open() ||
+                    IsPeerClosed(connection->stream.socket()))
+                {
+                    ++s_stats.expired;
+                    continue;
+                }
+
+                ++s_stats.hits;
+                connection->reused = true;
+                co_return connection;
+            }
+        }
+        ++s_stats.misses;
+    }
+
+    auto phaseStart = std::chrono::steady_clock::now();
+    tcp::resolver::results_type results = co_await Resolve(endpoint, address);
+    if (trace)
+        trace->AddSpan("dns", track, phaseStart, std::chrono::steady_clock::now(), address);
+
+    auto connection = std::make_unique<LLMConnection>(co_await net::this_coro::executor, std::move(tlsContext));
+    connection->key = key;
+    // The connect timeout covers the TLS handshake as well
+    connection->stream.expires_after(connectTimeout);
+    phaseStart = std::chrono::steady_clock::now();
+    try
+    {
+        co_await connection->stream.Tcp().async_connect(results, net::use_awaitable);
+        if (trace)
+            trace->AddSpan("connect", track, phaseStart, std::chrono::steady_clock::now());
+    }
+    catch (const boost::system::system_error&)
+    {
+        // The address may have moved; resolve again next time
+        InvalidateDns(address);
+        throw;
+    }
+
+    boost::system::error_code ec;
+    connection->stream.socket().set_option(tcp::no_delay(true), ec);
+
+    if (endpoint.useSsl)
+    {
+        phaseStart = std::chrono::steady_clock::now();
+        co_await Handshake(*connection, endpoint);
+        if (trace)
+            trace->AddSpan("tls", track, phaseStart, std::chrono::steady_clock::now());
+    }
+    co_return connection;
+}
+
+net::awaitable<void> LLMChatConnectionPool::Handshake(LLMConnection& connection, LLMEndpoint const& endpoint)
+{
+    LLMStream::TlsStream& tls = *connection.stream.Tls();
+    SSL* native = tls.native_handle();
+
+    // SNI picks the certificate on shared hosts and proxies; it is not sent for IP literals
+    boost::system::error_code ec;
+    net::ip::make_address(endpoint.host, ec);
+    if (ec && !SSL_set_tlsext_host_name(native, endpoint.host.c_str()))
+        throw boost::system::system_error(boost::system::error_code(static_cast<int>(::ERR_get_error()),
+            net::error::get_ssl_category()));
+
+    // The chain is checked against the trusted CAs; the name must also match the endpoint.
+    // Asked of the connection, which has the verify mode of the context it was made with.
+    if (SSL_get_verify_mode(native) & SSL_VERIFY_PEER)
+        tls.set_verify_callback(ssl::host_name_verification(endpoint.host));
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto itr = s_tlsSessions.find(connection.key);
+        if (itr != s_tlsSessions.end())
+            SSL_set_session(native, itr->second.get());
+    }
+
+    try
+    {
+        co_await tls.async_handshake(ssl::stream_base::client, net::use_awaitable);
+    }
+    catch (const boost::system::system_error& e)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_tlsSessions.erase(connection.key);
+        LOG_ERROR("module", "[LLMChat] TLS handshake with {}:{} failed: {}", endpoint.host, endpoint.port, e.code().message());
+        throw;
+    }
+
+    bool resumed = SSL_session_reused(native);
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        ++(resumed ? s_stats.tlsResumed : s_stats.tlsHandshakes);
+    }
+    if (!resumed)
+        StoreSession(connection);
+}
+
+void LLMChatConnectionPool::StoreSession(LLMConnection& connection)
+{
+    LLMStream::TlsStream* tls = connection.stream.Tls();
+    if (!tls)
+        return;
+
+    SSL_SESSION* current = SSL_get_session(tls->native_handle());
+    if (!current || !SSL_SESSION_is_resumable(current))
+        return;
+
+    // A copy: OpenSSL marks a connection's own session unusable once the connection is freed
+    // without a TLS shutdown, which is how pooled connections end
+    SSL_SESSION* session = SSL_SESSION_dup(current);
+    if (!session)
+        return;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_tlsSessions[connection.key] = std::shared_ptr<SSL_SESSION>(session, SSL_SESSION_free);
+}
+
+void LLMChatConnectionPool::Release(std::unique_ptr<LLMConnection> connection)
+{
+    if (!connection || !connection->stream.socket().is_open())
+        return;
+
+    connection->lastUsed = std::chrono::steady_clock::now();
+    connection->stream.expires_never();
+    connection->buffer.clear();
+
+    // TLS 1.3 servers send their session tickets after the handshake; by now they have arrived
+    StoreSession(*connection);
+
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    // Made before the TLS settings last changed
+    if (connection->tlsContext && connection->tlsContext != s_tlsContext)
+        return;
+
+    auto& idle = s_idle[connection->key];
+
+    // Drop connections that went stale while parked
+    while (!idle.empty() && connection->lastUsed - idle.front()->lastUsed > config->Pool.IdleTimeout)
+    {
+        idle.pop_front();
+        ++s_stats.expired;
+    }
+
+    if (idle.size() >= config->Pool.MaxIdle)
+        return;
+
+    idle.push_back(std::move(connection));
+}
+
+void LLMChatConnectionPool::NoteStaleRetry()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    ++s_stats.staleRetries;
+}
+
+LLMPoolStats LLMChatConnectionPool::GetStats()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    LLMPoolStats stats = s_stats;
+    stats.idle = 0;
+    for (auto const& [key, idle] : s_idle)
+        stats.idle += idle.size();
+    return stats;
+}
+
+net::awaitable<tcp::resolver::results_type> LLMChatConnectionPool::Resolve(LLMEndpoint const& endpoint,
+    std::string const& key)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto itr = s_dnsCache.find(key);
+        if (itr != s_dnsCache.end() && itr->second.expiry > std::chrono::steady_clock::now())
+        {
+            ++s_stats.dnsHits;
+            co_return itr->second.results;
+        }
+        ++s_stats.dnsMisses;
+    }
+
+    tcp::resolver resolver(co_await net::this_coro::executor);
+    tcp::resolver::results_type results = co_await resolver.async_resolve(endpoint.host, endpoint.port, net::use_awaitable);
+
+    std::chrono::seconds ttl = sLLMConfig->Pool.DnsTtl;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_dnsCache[key] = DnsEntry{results, std::chrono::steady_clock::now() + ttl};
+    co_return results;
+}
+
+void LLMChatConnectionPool::InvalidateDns(std::string const& key)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_dnsCache.erase(key);
+}
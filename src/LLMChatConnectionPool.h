@@ -0,0 +1,135 @@
+#ifndef MOD_LLM_CHAT_CONNECTION_POOL_H
+#define MOD_LLM_CHAT_CONNECTION_POOL_H
+
+#include "Define.h"
+#include "LLMChatEngine.h"
+#include "LLMChatTrace.h"
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/ssl/ssl_stream.hpp>
+
+// The byte stream of a connection: plain TCP, or TLS on top of it. Timeouts and close
+// always act on the TCP layer underneath, so callers treat both alike.
+class LLMStream
+{
+public:
+    using executor_type = boost::beast::tcp_stream::executor_type;
+    using TlsStream = boost::beast::ssl_stream<boost::beast::tcp_stream>;
+
+    // TLS when `tlsContext` is given
+    LLMStream(boost::asio::any_io_executor const& executor, boost::asio::ssl::context* tlsContext);
+
+    executor_type get_executor() { return Tcp().get_executor(); }
+    boost::beast::tcp_stream& Tcp() { return m_tls ? m_tls->next_layer() : *m_tcp; }
+    TlsStream* Tls() { return m_tls.get(); }
+
+    boost::asio::ip::tcp::socket& socket() { return Tcp().socket(); }
+    void expires_at(std::chrono::steady_clock::time_point expiry) { Tcp().expires_at(expiry); }
+    void expires_after(std::chrono::steady_clock::duration timeout) { Tcp().expires_after(timeout); }
+    void expires_never() { Tcp().expires_never(); }
+    void close() { Tcp().close(); }
+
+    template <typename MutableBufferSequence, typename ReadHandler>
+    auto async_read_some(MutableBufferSequence const& buffers, ReadHandler&& handler)
+    {
+        if (m_tls)
+            return m_tls->async_read_some(buffers, std::forward<ReadHandler>(handler));
+        return m_tcp->async_read_some(buffers, std::forward<ReadHandler>(handler));
+    }
+
+    template <typename ConstBufferSequence, typename WriteHandler>
+    auto async_write_some(ConstBufferSequence const& buffers, WriteHandler&& handler)
+    {
+        if (m_tls)
+            return m_tls->async_write_some(buffers, std::forward<WriteHandler>(handler));
+        return m_tcp->async_write_some(buffers, std::forward<WriteHandler>(handler));
+    }
+
+private:
+    std::unique_ptr<boost::beast::tcp_stream> m_tcp;
+    std::unique_ptr<TlsStream> m_tls;
+};
+
+// A keep-alive connection checked out of the pool by exactly one request at a time
+struct LLMConnection
+{
+    LLMConnection(boost::asio::any_io_executor const& executor, std::shared_ptr<boost::asio::ssl::context> context)
+        : tlsContext(std::move(context)), stream(executor, tlsContext.get()) {}
+
+    // Outlives the stream; a reload may give the pool a new context meanwhile
+    std::shared_ptr<boost::asio::ssl::context> tlsContext;
+    LLMStream stream;
+    boost::beast::flat_buffer buffer;
+    std::string key;
+    std::chrono::steady_clock::time_point lastUsed;
+    bool reused = false;
+};
+
+struct LLMPoolStats
+{
+    uint64 hits = 0;          // Requests served on an idle keep-alive connection
+    uint64 misses = 0;        // Requests that had to open a new connection
+    uint64 staleRetries = 0;  // Reused connections found closed by the server and reopened
+    uint64 expired = 0;       // Idle connections dropped as timed out or closed by the server
+    uint64 dnsHits = 0;
+    uint64 dnsMisses = 0;
+    uint64 tlsHandshakes = 0; // Full TLS handshakes
+    uint64 tlsResumed = 0;    // Handshakes that resumed an earlier TLS session
+    uint32 idle = 0;          // Connections currently parked in the pool
+};
+
+class LLMChatConnectionPool
+{
+public:
+    static void Initialize();
+    static void Shutdown();
+
+    // Returns an idle connection to the endpoint, or resolves and connects a new one; the
+    // lookup, connect and handshake are recorded on `trace` when one is given
+    static boost::asio::awaitable<std::unique_ptr<LLMConnection>> Acquire(LLMEndpoint const& endpoint,
+        std::chrono::steady_clock::duration connectTimeout, bool allowReuse = true, LLMTrace* trace = nullptr,
+        LLMTraceTrack track = LLM_TRACE_ATTEMPT);
+    // Parks a connection whose last response allowed keep-alive
+    static void Release(std::unique_ptr<LLMConnection> connection);
+    static void NoteStaleRetry();
+
+    static LLMPoolStats GetStats();
+
+private:
+    struct DnsEntry
+    {
+        boost::asio::ip::tcp::resolver::results_type results;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    static boost::asio::awaitable<boost::asio::ip::tcp::resolver::results_type> Resolve(LLMEndpoint const& endpoint,
+        std::string const& key);
+    static void InvalidateDns(std::string const& key);
+    static boost::asio::awaitable<void> Handshake(LLMConnection& connection, LLMEndpoint const& endpoint);
+    // Keeps the connection's TLS session so the next connection to the endpoint can resume it
+    static void StoreSession(LLMConnection& connection);
+    // With the pool mutex held: the TLS context for `settings`, built anew when they changed
+    // since the last one; idle TLS connections of an older context are dropped then
+    static std::shared_ptr<boost::asio::ssl::context> GetTlsContext(struct LLMConfig::Tls const& settings);
+    static void LoadTlsContext(struct LLMConfig::Tls const& settings);
+
+    static std::map<std::string, std::deque<std::unique_ptr<LLMConnection>>> s_idle;
+    static std::map<std::string, DnsEntry> s_dnsCache;
+    static std::shared_ptr<boost::asio::ssl::context> s_tlsContext;
+    static struct LLMConfig::Tls s_tlsSettings;    // What s_tlsContext was built from
+    // Latest resumable TLS session per endpoint
+    static std::map<std::string, std::shared_ptr<SSL_SESSION>> s_tlsSessions;
+    static std::mutex s_mutex;
+    static LLMPoolStats s_stats;
+};
+
+#endif // MOD_LLM_CHAT_CONNECTION_POOL_H
@@ -0,0 +1,525 @@
+#include "LLMChatEngine.h"
+#include "LLMChatBackends.h"
+#include "LLMChatConnectionPool.h"
+#include "LLMChatHedgePolicy.h"
+#include "LLMChatMetrics.h"
+#include "LLMChatTrace.h"
+#include "Log.h"
+#include <fmt/format.h>
+
+// Boost Beast includes
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+// Size of the window a streamed body is read through
+static constexpr size_t STREAM_CHUNK_SIZE = 4096;
+
+// Static member initialization
+std::unique_ptr<net::io_context> LLMChatEngine::s_ioContext;
+std::unique_ptr<LLMChatEngine::WorkGuard> LLMChatEngine::s_workGuard;
+std::vector<std::thread> LLMChatEngine::s_threads;
+std::atomic<uint32> LLMChatEngine::s_inFlight{0};
+std::atomic<uint64> LLMChatEngine::s_cancelled{0};
+uint32 LLMChatEngine::s_maxInFlight = 64;
+std::function<void()> LLMChatEngine::s_capacityListener;
+std::atomic<bool> LLMChatEngine::s_running{false};
+
+bool LLMChatEngine::Initialize()
+{
+    if (s_running)
+        return true;
+
+    // Both sized once; a reload does not resize the engine
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    s_maxInFlight = config->Engine.MaxInFlight;
+    uint32 threadCount = config->Engine.Threads;
+
+    s_ioContext = std::make_unique<net::io_context>(static_cast<int>(threadCount));
+    s_workGuard = std::make_unique<WorkGuard>(net::make_work_guard(*s_ioContext));
+    s_inFlight = 0;
+    s_running = true;
+
+    LLMChatConnectionPool::Initialize();
+    LLMChatBackends::Initialize();
+
+    for (uint32 i = 0; i < threadCount; ++i)
+    {
+        s_threads.emplace_back([]() {
+            try
+            {
+                s_ioContext->run();
+            }
+            catch (const std::exception& e)
+            {
+                LOG_ERROR("module", "[LLMChat] Engine thread terminated: {}", e.what());
+            }
+        });
+    }
+
+    LOG_INFO("module", "[LLMChat] Request engine started - {} threads, {} max in-flight requests",
+        threadCount, s_maxInFlight);
+    return true;
+}
+
+void LLMChatEngine::Shutdown()
+{
+    if (!s_running)
+        return;
+
+    s_running = false;
+
+    s_workGuard.reset();
+    s_ioContext->stop();
+
+    for (std::thread& thread : s_threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+    s_threads.clear();
+
+    LLMChatConnectionPool::Shutdown();
+    LLMChatBackends::Shutdown();
+
+    // Destroys any suspended coroutines along with their sockets
+    s_ioContext.reset();
+    s_inFlight = 0;
+
+    LOG_INFO("module", "[LLMChat] Request engine stopped");
+}
+
+void LLMChatEngine::Submit(std::shared_ptr<LLMHttpRequest> request)
+{
+    if (!s_running)
+    {
+        LLMHttpResult result;
+        result.error = "request engine is not running";
+        Complete(request, result);
+        request->onChunk = nullptr;
+        request->onComplete = nullptr;
+        return;
+    }
+
+    // Fail at once rather than make the message wait out a timeout against a dead backend
+    if (request->backend && !request->backend->breaker.Allow())
+    {
+        ++request->backend->rejected;
+        LLMHttpResult result;
+        result.backend = request->backend.get();
+        result.rejected = true;
+        result.error = "circuit breaker open";
+        Complete(request, result);
+        request->onChunk = nullptr;
+        request->onComplete = nullptr;
+        return;
+    }
+
+    ++s_inFlight;
+    if (request->backend)
+        LLMChatBackends::OnSubmit(*request->backend);
+
+    request->submittedAt = std::chrono::steady_clock::now();
+    // Each exchange gets its own strand so Cancel can reach its socket from another thread
+    request->strand = net::make_strand(*s_ioContext);
+    request->attempts = 1;
+    net::any_io_executor strand = request->strand;
+    bool streamed = static_cast<bool>(request->onChunk);
+
+    // No hedging until the class has seen enough responses to know what late means
+    if (request->hedging)
+    {
+        request->hedging->OnRequest();
+        std::chrono::milliseconds delay = request->hedging->GetDelay();
+        if (delay.count() > 0)
+            net::co_spawn(strand, Hedge(request, delay, streamed), net::detached);
+    }
+
+    net::co_spawn(strand, Execute(request, request, streamed), net::detached);
+}
+
+void LLMChatEngine::Cancel(std::shared_ptr<LLMHttpRequest> const& request)
+{
+    if (!request || request->cancelled.exchange(true))
+        return;
+
+    ++s_cancelled;
+
+    // Not submitted yet: Execute sees the flag before it connects
+    if (!s_running || !request->strand)
+        return;
+
+    net::post(request->strand, [request]()
+    {
+        // Fails whatever read or write is pending; the connection is never returned to the pool
+        if (request->connection)
+            request->connection->stream.close();
+
+        // The hedge is only ever set on this strand, after checking the flag, so none can slip by
+        if (request->hedge && !request->hedge->cancelled.exchange(true))
+            Interrupt(request->hedge);
+    });
+}
+
+void LLMChatEngine::Interrupt(std::shared_ptr<LLMHttpRequest> const& attempt)
+{
+    net::post(attempt->strand, [attempt]()
+    {
+        if (attempt->connection)
+            attempt->connection->stream.close();
+    });
+}
+
+net::awaitable<void> LLMChatEngine::Hedge(std::weak_ptr<LLMHttpRequest> weakRequest, std::chrono::milliseconds delay,
+    bool streamed)
+{
+    net::steady_timer timer(co_await net::this_coro::executor, delay);
+    boost::system::error_code ec;
+    co_await timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+
+    // On the request's strand: the first attempt cannot claim the request or finish meanwhile
+    std::shared_ptr<LLMHttpRequest> request = weakRequest.lock();
+    if (ec || !s_running || !request || request->cancelled || request->winner.load() || !request->attempts.load()
+        || std::chrono::steady_clock::now() >= request->deadline)
+        co_return;
+
+    std::shared_ptr<LLMBackend> backend;
+    if (request->backend && !(backend = LLMChatBackends::SelectAlternative(*request->backend)))
+        co_return;
+
+    // Budget before breaker: a breaker probe slot once taken has to be used
+    if (!HasCapacity() || !request->hedging->TryHedge())
+        co_return;
+    if (backend && !backend->breaker.Allow())
+    {
+        ++backend->rejected;
+        co_return;
+    }
+
+    auto hedge = std::make_shared<LLMHttpRequest>();
+    hedge->backend = backend;
+    hedge->endpoint = backend ? backend->endpoint : request->endpoint;
+    hedge->body = request->body;
+    hedge->get = request->get;
+    hedge->deadline = request->deadline;
+    hedge->strand = net::make_strand(*s_ioContext);
+
+    request->hedge = hedge;
+    ++request->attempts;
+    ++s_inFlight;
+    if (backend)
+        LLMChatBackends::OnSubmit(*backend);
+
+    LOG_DEBUG("module", "[LLMChat] No first byte after {}ms, hedging to {}", delay.count(),
+        backend ? backend->name : hedge->endpoint.host);
+
+    net::any_io_executor strand = hedge->strand;
+    net::co_spawn(strand, Execute(std::move(request), std::move(hedge), streamed), net::detached);
+}
+
+bool LLMChatEngine::Claim(std::shared_ptr<LLMHttpRequest> const& request, std::shared_ptr<LLMHttpRequest> const& attempt,
+    std::chrono::steady_clock::time_point startedAt)
+{
+    LLMHttpRequest* expected = nullptr;
+    if (!request->winner.compare_exchange_strong(expected, attempt.get()))
+        return expected == attempt.get();
+
+    bool isHedge = attempt != request;
+    if (request->hedging)
+        request->hedging->Record(
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startedAt), isHedge);
+
+    // The slower attempt is cut off so its backend stops generating. The hedge pointer is
+    // either read on the request's own strand or was set before this hedge started.
+    std::shared_ptr<LLMHttpRequest> const& other = isHedge ? request : request->hedge;
+    if (other)
+    {
+        other->lost = true;
+        Interrupt(other);
+    }
+    return true;
+}
+
+net::awaitable<void> LLMChatEngine::Execute(std::shared_ptr<LLMHttpRequest> request,
+    std::shared_ptr<LLMHttpRequest> attempt, bool streamed)
+{
+    LLMHttpResult result;
+    result.backend = attempt->backend.get();
+    LLMEndpoint const& endpoint = attempt->endpoint;
+    auto startedAt = std::chrono::steady_clock::now();
+    auto sentAt = startedAt;
+    LLMTrace* trace = request->trace.get();
+    LLMTraceTrack track = attempt == request ? LLM_TRACE_ATTEMPT : LLM_TRACE_HEDGE;
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+
+    try
+    {
+        http::request<http::string_body> req{attempt->get ? http::verb::get : http::verb::post, endpoint.target, 11};
+        req.set(http::field::host, endpoint.host);
+        req.set(http::field::user_agent, "AzerothCore-LLMChat/1.0");
+        if (!attempt->get)
+            req.set(http::field::content_type, "application/json");
+        req.set(http::field::accept, "application/json");
+        // Hosted OpenAI-compatible APIs want the key as a bearer token; Ollama ignores it
+        if (!config->API.APIKey.empty())
+            req.set(http::field::authorization, "Bearer " + config->API.APIKey);
+        req.keep_alive(true);
+        req.body() = attempt->body;
+        req.prepare_payload();
+
+        for (uint32 retry = 0; ; ++retry)
+        {
+            auto connectExpiry = PhaseExpiry(*attempt);
+            if (connectExpiry <= std::chrono::steady_clock::now())
+                throw boost::system::system_error(beast::error::timeout);
+
+            auto acquiredFrom = std::chrono::steady_clock::now();
+            std::unique_ptr<LLMConnection> connection = co_await LLMChatConnectionPool::Acquire(endpoint,
+                connectExpiry - std::chrono::steady_clock::now(), retry == 0, trace, track);
+            if (IsAborted(*attempt))
+                throw boost::system::system_error(net::error::operation_aborted);
+
+            bool reused = connection->reused;
+            auto acquiredAt = std::chrono::steady_clock::now();
+            if (!reused)
+                LLMChatMetrics::Record(LLM_HISTOGRAM_CONNECT, acquiredAt - acquiredFrom);
+            if (trace)
+                trace->AddSpan("connection", track, acquiredFrom, acquiredAt, reused ? "reused" : "new");
+            bool received = false;
+
+            // Cancel only closes the socket while this exchange holds it; cleared on every way out
+            struct ConnectionScope
+            {
+                LLMHttpRequest& request;
+                ~ConnectionScope() { request.connection = nullptr; }
+            } scope{*attempt};
+            attempt->connection = connection.get();
+
+            try
+            {
+                connection->stream.expires_at(PhaseExpiry(*attempt));
+                co_await http::async_write(connection->stream, req, net::use_awaitable);
+                sentAt = std::chrono::steady_clock::now();
+                if (trace)
+                    trace->AddSpan("send", track, acquiredAt, sentAt);
+
+                bool keepAlive = false;
+                if (streamed)
+                    co_await ReadStreamed(*connection, request, attempt, result, keepAlive, received,
+                        config->Engine.MaxResponseBytes, startedAt, sentAt);
+                else
+                {
+                    // Latency is to the first byte here as well, so the limit, the breaker and
+                    // routing compare like with like whichever way a response is read
+                    http::response_parser<http::string_body> parser;
+                    parser.body_limit(config->Engine.MaxResponseBytes);
+                    connection->stream.expires_at(PhaseExpiry(*attempt));
+                    co_await http::async_read_header(connection->stream, connection->buffer, parser, net::use_awaitable);
+                    auto headerAt = std::chrono::steady_clock::now();
+                    result.latency = std::chrono::duration_cast<std::chrono::milliseconds>(headerAt - sentAt);
+                    result.status = parser.get().result_int();
+
+                    connection->stream.expires_at(PhaseExpiry(*attempt));
+                    co_await http::async_read(connection->stream, connection->buffer, parser, net::use_awaitable);
+                    keepAlive = parser.get().keep_alive();
+                    result.body = std::move(parser.get().body());
+                    if (trace)
+                    {
+                        trace->AddSpan("first byte", track, sentAt, headerAt, fmt::format("HTTP {}", result.status));
+                        trace->AddSpan("body", track, headerAt, std::chrono::steady_clock::now());
+                    }
+                }
+                result.success = true;
+
+                if (keepAlive && !IsAborted(*attempt))
+                    LLMChatConnectionPool::Release(std::move(connection));
+                break;
+            }
+            catch (const boost::system::system_error& e)
+            {
+                // The server may close an idle keep-alive socket at any time; retry once on a fresh one,
+                // unless part of a streamed body has already been handed out
+                if (!reused || retry > 0 || received || IsAborted(*attempt) || !IsStaleConnectionError(e.code()))
+                    throw;
+
+                LLMChatConnectionPool::NoteStaleRetry();
+            }
+        }
+    }
+    catch (const boost::system::system_error& e)
+    {
+        if (e.code() == http::error::body_limit)
+            result.error = fmt::format("response body over {} bytes", config->Engine.MaxResponseBytes);
+        else
+            result.error = fmt::format("{} ({}:{})", e.code().message(), e.code().category().name(), e.code().value());
+    }
+    catch (const std::exception& e)
+    {
+        result.error = e.what();
+    }
+
+    // A reply that raced in after Cancel, or behind the other attempt of a hedge, is discarded all the same
+    bool aborted = IsAborted(*attempt);
+    if (aborted)
+    {
+        result.cancelled = true;
+        result.success = false;
+        result.error = "cancelled";
+    }
+    else if (!result.success && std::chrono::steady_clock::now() >= attempt->deadline)
+    {
+        result.expired = true;
+        result.error = "deadline exceeded";
+    }
+
+    if (attempt->backend)
+        LLMChatBackends::Record(*attempt->backend, result, sentAt);
+
+    if (trace)
+        trace->AddSpan("attempt", track, startedAt, std::chrono::steady_clock::now(), fmt::format("{}: {}",
+            attempt->backend ? attempt->backend->name : endpoint.host,
+            result.success ? fmt::format("HTTP {}", result.status) : result.error));
+
+    if (!aborted && result.success && result.status == 200)
+        Claim(request, attempt, startedAt);
+
+    // Answered by the attempt that won, or by the last one standing when neither got a usable response
+    LLMHttpRequest* winner = request->winner.load();
+    uint32 remaining = --request->attempts;
+    if (winner == attempt.get() || (!winner && !remaining))
+    {
+        result.elapsed = std::chrono::steady_clock::now() - request->submittedAt;
+        Complete(request, result);
+        request->onChunk = nullptr;
+        request->onComplete = nullptr;
+    }
+
+    --s_inFlight;
+    if (s_capacityListener)
+        s_capacityListener();
+}
+
+net::awaitable<void> LLMChatEngine::ReadStreamed(LLMConnection& connection, std::shared_ptr<LLMHttpRequest> const& request,
+    std::shared_ptr<LLMHttpRequest> const& attempt, LLMHttpResult& result, bool& keepAlive, bool& received,
+    uint32 bodyLimit, std::chrono::steady_clock::time_point startedAt, std::chrono::steady_clock::time_point sentAt)
+{
+    // Not boost::none: Boost 1.74 takes any Content-Length as over an unset limit
+    http::response_parser<http::buffer_body> parser;
+    parser.body_limit(bodyLimit);
+
+    connection.stream.expires_at(PhaseExpiry(*attempt));
+    co_await http::async_read_header(connection.stream, connection.buffer, parser, net::use_awaitable);
+    result.status = parser.get().result_int();
+    auto headerAt = std::chrono::steady_clock::now();
+    result.latency = std::chrono::duration_cast<std::chrono::milliseconds>(headerAt - sentAt);
+
+    LLMTrace* trace = request->trace.get();
+    LLMTraceTrack track = attempt == request ? LLM_TRACE_ATTEMPT : LLM_TRACE_HEDGE;
+    if (trace)
+        trace->AddSpan("first byte", track, sentAt, headerAt, fmt::format("HTTP {}", result.status));
+
+    // Only a successful response claims the request and is streamed out; an error status is
+    // kept in the body, to be reported if the other attempt of a hedge fails as well
+    bool claimed = false;
+    if (result.status == 200)
+    {
+        claimed = Claim(request, attempt, startedAt);
+        if (!claimed)
+            throw boost::system::system_error(net::error::operation_aborted);
+    }
+
+    char chunk[STREAM_CHUNK_SIZE];
+    uint64 total = 0;
+    while (!parser.is_done())
+    {
+        parser.get().body().data = chunk;
+        parser.get().body().size = sizeof(chunk);
+
+        // The phase timeout bounds the silence between two pieces; the deadline bounds the whole generation
+        boost::system::error_code ec;
+        connection.stream.expires_at(PhaseExpiry(*attempt));
+        co_await http::async_read_some(connection.stream, connection.buffer, parser, net::redirect_error(net::use_awaitable, ec));
+        if (ec == http::error::need_buffer)
+            ec = {};
+        if (ec)
+            throw boost::system::system_error(ec);
+
+        size_t length = sizeof(chunk) - parser.get().body().size;
+        if (!length)
+            continue;
+
+        if (IsAborted(*attempt))
+            throw boost::system::system_error(net::error::operation_aborted);
+
+        // Counted here as well, so a cut is made before the caller is handed more than the cap
+        total += length;
+        if (total > bodyLimit)
+            throw boost::system::system_error(http::error::body_limit);
+
+        received = true;
+        // Error statuses carry a plain JSON document the caller still wants to inspect
+        if (claimed)
+            request->onChunk(std::string_view(chunk, length));
+        else
+            result.body.append(chunk, length);
+    }
+
+    keepAlive = parser.get().keep_alive();
+    if (trace)
+        trace->AddSpan("stream", track, headerAt, std::chrono::steady_clock::now());
+}
+
+bool LLMChatEngine::HasCapacity(uint32 reserved)
+{
+    uint32 limit = std::min(s_maxInFlight, LLMChatBackends::GetLimit());
+    return s_running && limit && s_inFlight.load(std::memory_order_relaxed) + std::min(reserved, limit - 1) < limit;
+}
+
+void LLMChatEngine::ReportStats()
+{
+    LOG_INFO("module", "[LLMChat] Engine: {} requests in flight, {} allowed now (max {})",
+        s_inFlight.load(), std::min(s_maxInFlight, LLMChatBackends::GetLimit()), s_maxInFlight);
+    LLMChatBackends::ReportStats();
+}
+
+std::chrono::steady_clock::time_point LLMChatEngine::PhaseExpiry(LLMHttpRequest const& request)
+{
+    return std::min(request.deadline, std::chrono::steady_clock::now() + sLLMConfig->Engine.PhaseTimeout);
+}
+
+bool LLMChatEngine::IsStaleConnectionError(boost::system::error_code const& ec)
+{
+    return ec == http::error::end_of_stream
+        || ec == net::error::eof
+        || ec == net::error::connection_reset
+        || ec == net::error::connection_aborted
+        || ec == net::error::broken_pipe
+        || ec == net::ssl::error::stream_truncated;
+}
+
+void LLMChatEngine::Complete(std::shared_ptr<LLMHttpRequest> const& request, LLMHttpResult const& result)
+{
+    try
+    {
+        if (request->onComplete)
+            request->onComplete(result);
+    }
+    catch (const std::exception& e)
+    {
+        LOG_ERROR("module", "[LLMChat] Error in request completion handler: {}", e.what());
+    }
+}
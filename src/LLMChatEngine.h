@@ -0,0 +1,132 @@
+#ifndef MOD_LLM_CHAT_ENGINE_H
+#define MOD_LLM_CHAT_ENGINE_H
+
+#include "Define.h"
+#include "mod-llm-chat-config.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+
+struct LLMBackend;
+struct LLMConnection;
+class LLMChatHedgePolicy;
+class LLMTrace;
+
+struct LLMHttpResult
+{
+    bool success = false;   // A complete HTTP response was read
+    uint32 status = 0;
+    std::string body;
+    std::string error;      // Transport error description when success is false
+    bool cancelled = false; // Aborted through LLMChatEngine::Cancel; the body is not worth delivering
+    bool expired = false;   // Ran past the request deadline
+    bool rejected = false;  // Never sent: the backend's circuit breaker is open
+    std::chrono::milliseconds latency{0};   // Request sent to first response byte
+    std::chrono::steady_clock::duration elapsed{0};     // Submitted to finished, hedges and retries included
+    LLMBackend* backend = nullptr;          // Backend that answered; a hedge's when it won the race
+};
+
+struct LLMHttpRequest
+{
+    // Backend the request is routed to; its breaker, limit and counters see the outcome.
+    // Without one the request goes to `endpoint` untracked.
+    std::shared_ptr<LLMBackend> backend;
+    LLMEndpoint endpoint;
+    std::string body;
+    bool get = false;       // GET without a body instead of POST
+    // The whole exchange, connect to last byte, has to finish by then; each phase is also
+    // capped at the engine's phase timeout
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    // Latency history and hedge budget of the request's traffic class. When set, a request
+    // still without a first byte after the class's hedge delay is raced against a copy sent
+    // to another backend; the first usable response is kept and the other attempt cancelled.
+    LLMChatHedgePolicy* hedging = nullptr;
+
+    // When set the response body is handed over piece by piece as it arrives, on an engine
+    // thread, before onComplete; used for streamed generations
+    std::function<void(std::string_view)> onChunk;
+    // Invoked exactly once on an engine thread when the exchange finishes; both callbacks
+    // are released right after, along with anything they captured
+    std::function<void(LLMHttpResult const&)> onComplete;
+    // When set the connection, exchange and any hedge are recorded in it
+    std::shared_ptr<LLMTrace> trace;
+
+    std::atomic<bool> cancelled{false};
+
+    // Engine-owned: when Submit accepted the request
+    std::chrono::steady_clock::time_point submittedAt;
+    // Engine-owned: the strand the exchange runs on and the connection it currently holds
+    boost::asio::any_io_executor strand;
+    LLMConnection* connection = nullptr;
+    // Engine-owned, hedged requests: the copy racing this one, the attempt whose response is
+    // used, the attempts still running, and whether this attempt lost the race
+    std::shared_ptr<LLMHttpRequest> hedge;
+    std::atomic<LLMHttpRequest*> winner{nullptr};
+    std::atomic<uint32> attempts{0};
+    std::atomic<bool> lost{false};
+};
+
+class LLMChatEngine
+{
+public:
+    static bool Initialize();
+    static void Shutdown();
+
+    // True while more than `reserved` slots under the backends' adaptive limits are free
+    static bool HasCapacity(uint32 reserved = 0);
+    static void Submit(std::shared_ptr<LLMHttpRequest> request);
+    // Any thread: aborts a submitted request, and its hedge if one is running. Its socket is
+    // closed so the backend sees the client go away and stops generating; onComplete still
+    // runs, with `cancelled` set.
+    static void Cancel(std::shared_ptr<LLMHttpRequest> const& request);
+    // Called on an engine thread whenever a request finishes and frees a slot
+    static void SetCapacityListener(std::function<void()> listener) { s_capacityListener = std::move(listener); }
+
+    static uint32 GetInFlight() { return s_inFlight.load(std::memory_order_relaxed); }
+    static uint32 GetMaxInFlight() { return s_maxInFlight; }
+    static void ReportStats();
+    static uint64 GetCancelled() { return s_cancelled.load(std::memory_order_relaxed); }
+
+private:
+    // Runs one attempt at `request`: the request itself, or the hedge racing it
+    static boost::asio::awaitable<void> Execute(std::shared_ptr<LLMHttpRequest> request,
+        std::shared_ptr<LLMHttpRequest> attempt, bool streamed);
+    static boost::asio::awaitable<void> Hedge(std::weak_ptr<LLMHttpRequest> request, std::chrono::milliseconds delay,
+        bool streamed);
+    static boost::asio::awaitable<void> ReadStreamed(LLMConnection& connection, std::shared_ptr<LLMHttpRequest> const& request,
+        std::shared_ptr<LLMHttpRequest> const& attempt, LLMHttpResult& result, bool& keepAlive, bool& received,
+        uint32 bodyLimit, std::chrono::steady_clock::time_point startedAt, std::chrono::steady_clock::time_point sentAt);
+    // The first attempt with a usable response gets to answer the request; the other is cut off
+    static bool Claim(std::shared_ptr<LLMHttpRequest> const& request, std::shared_ptr<LLMHttpRequest> const& attempt,
+        std::chrono::steady_clock::time_point startedAt);
+    static bool IsAborted(LLMHttpRequest const& attempt) { return attempt.cancelled || attempt.lost; }
+    // Closes the attempt's socket from its own strand
+    static void Interrupt(std::shared_ptr<LLMHttpRequest> const& attempt);
+    static bool IsStaleConnectionError(boost::system::error_code const& ec);
+    static std::chrono::steady_clock::time_point PhaseExpiry(LLMHttpRequest const& request);
+    static void Complete(std::shared_ptr<LLMHttpRequest> const& request, LLMHttpResult const& result);
+
+    using WorkGuard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+    static std::unique_ptr<boost::asio::io_context> s_ioContext;
+    static std::unique_ptr<WorkGuard> s_workGuard;
+    static std::vector<std::thread> s_threads;
+    static std::atomic<uint32> s_inFlight;
+    static std::atomic<uint64> s_cancelled;
+    static uint32 s_maxInFlight;
+    static std::function<void()> s_capacityListener;
+    static std::atomic<bool> s_running;
+};
+
+#endif // MOD_LLM_CHAT_ENGINE_H
@@ -1,4 +1,5 @@
 #include "LLMChatEvents.h"
+#include "LLMChatLogger.h"
 #include "LLMChatQueue.h"
 #include "Chat.h"
 #include "Channel.h"
@@ -23,17 +24,17 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 /*type*/, uint32 /*lang*
     if (!player || msg.empty())
         return;
 
-    if (!LLM_Config.Enable)
+    if (!sLLMConfig->Enable)
     {
         LOG_DEBUG("module", "[LLMChat] Module is disabled, ignoring chat message from {}", player->GetName());
         return;
     }
 
-    LOG_INFO("module", "[LLMChat] Processing SAY/YELL message from player: {}", player->GetName());
+    LLMCHAT_LOG(LLM_LOG_DETAIL, "Processing SAY/YELL message from player: {}", player->GetName());
     
-    // Check if there are any bots in the map at all
+    // Check if there are any bots in the map at all; walks every player, so only when it is logged
     Map* map = player->GetMap();
-    if (map)
+    if (map && LLMChatLogger::IsEnabled(LLM_LOG_DEBUG))
     {
         int botCount = 0;
         const Map::PlayerList& players = map->GetPlayers();
@@ -47,7 +48,7 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 /*type*/, uint32 /*lang*
                     botCount++;
             }
         }
-        LOG_INFO("module", "[LLMChat] Found {} total bots in the map", botCount);
+        LLMCHAT_LOG(LLM_LOG_DEBUG, "Found {} total bots in the map", botCount);
     }
     
     // Store original message since we'll be processing it
@@ -58,18 +59,20 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 /*type*/, uint32 /*lang*
 
     if (!responders.empty())
     {
-        LOG_INFO("module", "[LLMChat] Found {} potential responders", responders.size());
+        LLMCHAT_LOG(LLM_LOG_DETAIL, "Found {} potential responders", responders.size());
         
-        // Process message for each responder
+        // Collect the bots among the responders; they may share one coalesced request
+        std::vector<Player*> bots;
         for (auto* responder : responders)
         {
             PlayerbotAI* botAI = sPlayerbotsMgr->GetPlayerbotAI(responder);
             if (botAI && !botAI->IsRealPlayer())
             {
-                LOG_INFO("module", "[LLMChat] Queueing response for bot: {}", responder->GetName());
-                LLMChatQueue::EnqueueResponse(responder, originalMsg, "SAY");
+                LLMCHAT_LOG(LLM_LOG_DETAIL, "Queueing response for bot: {}", responder->GetName());
+                bots.push_back(responder);
             }
         }
+        LLMChatQueue::EnqueueGroupResponse(player, bots, originalMsg, CHAT_MSG_SAY);
     }
     else
     {
@@ -82,8 +85,8 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 /*type*/, uint32 /*lang*
 
 void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, std::string& msg, Player* receiver)
 {
-    LOG_INFO("module", "[LLMChat] ====== BEGIN CHAT PROCESSING ======");
-    LOG_INFO("module", "[LLMChat] OnChat (Whisper) triggered - Player: {}, Type: {} ({}), Message: {}", 
+    LLMCHAT_LOG(LLM_LOG_DEBUG, "====== BEGIN CHAT PROCESSING ======");
+    LLMCHAT_LOG(LLM_LOG_DETAIL, "OnChat (Whisper) triggered - Player: {}, Type: {} ({}), Message: {}", 
         player ? player->GetName() : "null", GetChatTypeName(type), type, msg);
 
     if (!player || !receiver)
@@ -92,7 +95,7 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, s
         return;
     }
 
-    if (!LLM_Config.Enable)
+    if (!sLLMConfig->Enable)
     {
         LOG_DEBUG("module", "[LLMChat] Module is disabled, ignoring chat message from {}", player->GetName());
         return;
@@ -108,17 +111,17 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, s
     PlayerbotAI* botAI = sPlayerbotsMgr->GetPlayerbotAI(receiver);
     if (botAI && !botAI->IsRealPlayer())
     {
-        LOG_INFO("module", "[LLMChat] Receiver is a bot, queueing response");
+        LLMCHAT_LOG(LLM_LOG_DETAIL, "Receiver is a bot, queueing response");
         std::string originalMsg = msg; // Store original message
         
         // Queue response for the bot
-        LLMChatQueue::EnqueueResponse(receiver, originalMsg, GetChatTypeName(type));
+        LLMChatQueue::EnqueueResponse(player, receiver, originalMsg, type);
         
         // Clear the message since we found a bot responder
         msg.clear();
     }
 
-    LOG_INFO("module", "[LLMChat] ====== END CHAT PROCESSING ======");
+    LLMCHAT_LOG(LLM_LOG_DEBUG, "====== END CHAT PROCESSING ======");
 }
 
 void LLMChatEvents::SendResponse(Player* responder, Player* sender, std::string const& response, uint32 chatType)
@@ -285,7 +288,7 @@ std::vector<Player*> LLMChatEvents::GetPotentialResponders(Player* sender, uint3
     if (type == CHAT_MSG_SAY || type == CHAT_MSG_YELL)
     {
         // Proximity-based chat - use distance checks
-        float range = LLM_Config.Chat.ChatRange;
+        float range = sLLMConfig->Chat.ChatRange;
         if (type == CHAT_MSG_YELL)
             range *= 2.0f;
 
@@ -393,10 +396,10 @@ std::vector<Player*> LLMChatEvents::GetPotentialResponders(Player* sender, uint3
 
 void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, std::string& msg, Channel* channel)
 {
-    LOG_INFO("module", "[LLMChat] OnChat (Channel) received - Type: {} ({}) Channel: {} Message: {}", 
+    LLMCHAT_LOG(LLM_LOG_DETAIL, "OnChat (Channel) received - Type: {} ({}) Channel: {} Message: {}", 
         GetChatTypeName(type), type, channel ? channel->GetName() : "null", msg);
     
-    if (!LLM_Config.Enable || !channel)
+    if (!sLLMConfig->Enable || !channel)
     {
         LOG_DEBUG("module", "[LLMChat] Module is disabled or null channel, ignoring message");
         return;
@@ -408,7 +411,7 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, s
         return;
     }
 
-    LOG_INFO("module", "[LLMChat] Processing channel message from player: {} in channel: {}", 
+    LLMCHAT_LOG(LLM_LOG_DETAIL, "Processing channel message from player: {} in channel: {}", 
         player->GetName(), channel->GetName());
     
     // Get potential responders
@@ -416,19 +419,21 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, s
 
     if (!responders.empty())
     {
-        LOG_INFO("module", "[LLMChat] Found {} potential responders", responders.size());
+        LLMCHAT_LOG(LLM_LOG_DETAIL, "Found {} potential responders", responders.size());
         std::string originalMsg = msg; // Store original message
         
-        // Process message for each responder
+        // Collect the bots among the responders; they may share one coalesced request
+        std::vector<Player*> bots;
         for (auto* responder : responders)
         {
             PlayerbotAI* botAI = sPlayerbotsMgr->GetPlayerbotAI(responder);
             if (botAI && !botAI->IsRealPlayer())
             {
-                LOG_INFO("module", "[LLMChat] Queueing response for bot: {}", responder->GetName());
-                LLMChatQueue::EnqueueResponse(responder, originalMsg, GetChatTypeName(type));
+                LLMCHAT_LOG(LLM_LOG_DETAIL, "Queueing response for bot: {}", responder->GetName());
+                bots.push_back(responder);
             }
         }
+        LLMChatQueue::EnqueueGroupResponse(player, bots, originalMsg, type);
         // Don't clear the message - let it display in the channel
     }
     else
@@ -439,9 +444,9 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, s
 
 void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, std::string& msg, Group* /*group*/)
 {
-    LOG_INFO("module", "[LLMChat] OnChat (Group) received - Type: {} Message: {}", type, msg);
+    LLMCHAT_LOG(LLM_LOG_DETAIL, "OnChat (Group) received - Type: {} Message: {}", type, msg);
     
-    if (!LLM_Config.Enable)
+    if (!sLLMConfig->Enable)
     {
         LOG_DEBUG("module", "[LLMChat] Module is disabled, ignoring message");
         return;
@@ -453,26 +458,28 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, s
         return;
     }
 
-    LOG_INFO("module", "[LLMChat] Processing group message from player: {}", player->GetName());
+    LLMCHAT_LOG(LLM_LOG_DETAIL, "Processing group message from player: {}", player->GetName());
     
     // Get potential responders
     auto responders = GetPotentialResponders(player, type);
 
     if (!responders.empty())
     {
-        LOG_INFO("module", "[LLMChat] Found {} potential responders", responders.size());
+        LLMCHAT_LOG(LLM_LOG_DETAIL, "Found {} potential responders", responders.size());
         std::string originalMsg = msg; // Store original message
         
-        // Process message for each responder
+        // Collect the bots among the responders; they may share one coalesced request
+        std::vector<Player*> bots;
         for (auto* responder : responders)
         {
             PlayerbotAI* botAI = sPlayerbotsMgr->GetPlayerbotAI(responder);
             if (botAI && !botAI->IsRealPlayer())
             {
-                LOG_INFO("module", "[LLMChat] Queueing response for bot: {}", responder->GetName());
-                LLMChatQueue::EnqueueResponse(responder, originalMsg, GetChatTypeName(type));
+                LLMCHAT_LOG(LLM_LOG_DETAIL, "Queueing response for bot: {}", responder->GetName());
+                bots.push_back(responder);
             }
         }
+        LLMChatQueue::EnqueueGroupResponse(player, bots, originalMsg, type);
         // Don't clear the message - let it display in the group
     }
     else
@@ -483,9 +490,9 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, s
 
 void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, std::string& msg, Guild* /*guild*/)
 {
-    LOG_INFO("module", "[LLMChat] OnChat (Guild) received - Type: {} Message: {}", type, msg);
+    LLMCHAT_LOG(LLM_LOG_DETAIL, "OnChat (Guild) received - Type: {} Message: {}", type, msg);
     
-    if (!LLM_Config.Enable)
+    if (!sLLMConfig->Enable)
     {
         LOG_DEBUG("module", "[LLMChat] Module is disabled, ignoring message");
         return;
@@ -497,26 +504,28 @@ void LLMChatEvents::OnPlayerChat(Player* player, uint32 type, uint32 /*lang*/, s
         return;
     }
 
-    LOG_INFO("module", "[LLMChat] Processing guild message from player: {}", player->GetName());
+    LLMCHAT_LOG(LLM_LOG_DETAIL, "Processing guild message from player: {}", player->GetName());
     
     // Get potential responders
     auto responders = GetPotentialResponders(player, type);
 
     if (!responders.empty())
     {
-        LOG_INFO("module", "[LLMChat] Found {} potential responders", responders.size());
+        LLMCHAT_LOG(LLM_LOG_DETAIL, "Found {} potential responders", responders.size());
         std::string originalMsg = msg; // Store original message
         
-        // Process message for each responder
+        // Collect the bots among the responders; they may share one coalesced request
+        std::vector<Player*> bots;
         for (auto* responder : responders)
         {
             PlayerbotAI* botAI = sPlayerbotsMgr->GetPlayerbotAI(responder);
             if (botAI && !botAI->IsRealPlayer())
             {
-                LOG_INFO("module", "[LLMChat] Queueing response for bot: {}", responder->GetName());
-                LLMChatQueue::EnqueueResponse(responder, originalMsg, GetChatTypeName(type));
+                LLMCHAT_LOG(LLM_LOG_DETAIL, "Queueing response for bot: {}", responder->GetName());
+                bots.push_back(responder);
             }
         }
+        LLMChatQueue::EnqueueGroupResponse(player, bots, originalMsg, type);
         // Don't clear the message - let it display in the guild
     }
     else
@@ -0,0 +1,66 @@
+#include "LLMChatHedgePolicy.h"
+#include "mod-llm-chat-config.h"
+#include "Log.h"
+#include <algorithm>
+
+void LLMChatHedgePolicy::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sampleCount = 0;
+    m_nextSample = 0;
+    m_budget = 0.0;
+    m_delay = 0;
+}
+
+void LLMChatHedgePolicy::OnRequest()
+{
+    ++m_requests;
+    float maxRate = sLLMConfig->Hedge.MaxRate;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Capped so a quiet hour cannot save up a burst of hedges for the next incident
+    m_budget = std::min(MAX_BUDGET, m_budget + maxRate);
+}
+
+bool LLMChatHedgePolicy::TryHedge()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_budget < 1.0)
+    {
+        ++m_denied;
+        return false;
+    }
+
+    m_budget -= 1.0;
+    ++m_hedged;
+    return true;
+}
+
+void LLMChatHedgePolicy::Record(std::chrono::milliseconds firstByte, bool hedge)
+{
+    if (hedge)
+        ++m_won;
+
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_samples[m_nextSample] = static_cast<uint32>(std::max<int64>(0, firstByte.count()));
+    m_nextSample = (m_nextSample + 1) % SAMPLE_COUNT;
+    m_sampleCount = std::min(m_sampleCount + 1, SAMPLE_COUNT);
+
+    // The percentile moves slowly; no need to select it again for every response
+    if (m_sampleCount < config->Hedge.MinSamples || m_nextSample % RECOMPUTE_EVERY)
+        return;
+
+    std::array<uint32, SAMPLE_COUNT> sorted = m_samples;
+    auto end = sorted.begin() + m_sampleCount;
+    auto nth = sorted.begin() + std::min<uint32>(m_sampleCount - 1, static_cast<uint32>(m_sampleCount * config->Hedge.Percentile));
+    std::nth_element(sorted.begin(), nth, end);
+    m_delay.store(std::max<uint32>(*nth, static_cast<uint32>(config->Hedge.MinDelay.count())), std::memory_order_relaxed);
+}
+
+void LLMChatHedgePolicy::ReportStats() const
+{
+    LOG_INFO("module", "[LLMChat] Hedging {}: after {}ms without a first byte, {} of {} requests hedged, "
+        "{} answered by the hedge, {} over budget",
+        m_name, m_delay.load(), m_hedged.load(), m_requests.load(), m_won.load(), m_denied.load());
+}
@@ -0,0 +1,53 @@
+#ifndef MOD_LLM_CHAT_HEDGE_POLICY_H
+#define MOD_LLM_CHAT_HEDGE_POLICY_H
+
+#include "Define.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+// Decides when a request of one traffic class is worth a second attempt: once its first
+// byte is later than most recent ones were, and only while the hedge budget lasts. Each
+// request earns LLMChat.Hedge.MaxRate of a hedge, so even with every backend stalled
+// hedges stay a small share of the traffic instead of doubling it.
+class LLMChatHedgePolicy
+{
+public:
+    explicit LLMChatHedgePolicy(std::string name) : m_name(std::move(name)) {}
+
+    // Forgets the latencies and the budget
+    void Reset();
+
+    // A request of the class was submitted
+    void OnRequest();
+    // How long a request may go without a first byte before it is hedged; zero while too
+    // few latencies are known
+    std::chrono::milliseconds GetDelay() const { return std::chrono::milliseconds(m_delay.load(std::memory_order_relaxed)); }
+    // Spends one hedge from the budget
+    bool TryHedge();
+    // Time from an attempt's start to the first byte of the response that was used
+    void Record(std::chrono::milliseconds firstByte, bool hedge);
+
+    void ReportStats() const;
+
+private:
+    static constexpr uint32 SAMPLE_COUNT = 256;
+    static constexpr uint32 RECOMPUTE_EVERY = 16;
+    static constexpr double MAX_BUDGET = 10.0;
+
+    std::string m_name;
+    std::array<uint32, SAMPLE_COUNT> m_samples{};   // Latest first-byte latencies in ms, oldest overwritten
+    uint32 m_sampleCount = 0;
+    uint32 m_nextSample = 0;
+    double m_budget = 0.0;
+    std::atomic<uint32> m_delay{0};
+    std::atomic<uint64> m_requests{0};
+    std::atomic<uint64> m_hedged{0};
+    std::atomic<uint64> m_won{0};       // The hedge answered first
+    std::atomic<uint64> m_denied{0};    // Due a hedge, but the budget was spent
+    mutable std::mutex m_mutex;
+};
+
+#endif // MOD_LLM_CHAT_HEDGE_POLICY_H
@@ -0,0 +1,466 @@
+#include "LLMChatJson.h"
+#include <fmt/format.h>
+#include <cmath>
+#include <iterator>
+
+void LLMJsonWriter::Separate()
+{
+    if (!m_first && !m_afterKey)
+        m_out += ',';
+    m_first = false;
+    m_afterKey = false;
+}
+
+LLMJsonWriter& LLMJsonWriter::BeginObject()
+{
+    Separate();
+    m_out += '{';
+    m_first = true;
+    return *this;
+}
+
+LLMJsonWriter& LLMJsonWriter::EndObject()
+{
+    m_out += '}';
+    m_first = false;
+    return *this;
+}
+
+LLMJsonWriter& LLMJsonWriter::BeginArray()
+{
+    Separate();
+    m_out += '[';
+    m_first = true;
+    return *this;
+}
+
+LLMJsonWriter& LLMJsonWriter::EndArray()
+{
+    m_out += ']';
+    m_first = false;
+    return *this;
+}
+
+LLMJsonWriter& LLMJsonWriter::Key(std::string_view key)
+{
+    Separate();
+    AppendString(m_out, key);
+    m_out += ':';
+    m_afterKey = true;
+    return *this;
+}
+
+LLMJsonWriter& LLMJsonWriter::String(std::string_view value)
+{
+    Separate();
+    AppendString(m_out, value);
+    return *this;
+}
+
+LLMJsonWriter& LLMJsonWriter::Uint(uint64 value)
+{
+    Separate();
+    fmt::format_to(std::back_inserter(m_out), "{}", value);
+    return *this;
+}
+
+LLMJsonWriter& LLMJsonWriter::Double(double value)
+{
+    Separate();
+    // Shortest text that reads back as the same double: 0.7, not 0.69999999999999996
+    if (std::isfinite(value))
+        fmt::format_to(std::back_inserter(m_out), "{}", value);
+    else
+        m_out += "null";
+    return *this;
+}
+
+LLMJsonWriter& LLMJsonWriter::Bool(bool value)
+{
+    Separate();
+    m_out += value ? "true" : "false";
+    return *this;
+}
+
+void LLMJsonWriter::AppendString(std::string& out, std::string_view text)
+{
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    out.reserve(out.size() + text.size() + 2);
+    out += '"';
+    // Copy the runs that need no escaping in one go; prompts are mostly such runs
+    size_t runStart = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        out.append(text.data() + runStart, i - runStart);
+        runStart = i + 1;
+        switch (c)
+        {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                out += "\\u00";
+                out += HEX[c >> 4];
+                out += HEX[c & 0xF];
+                break;
+        }
+    }
+    out.append(text.data() + runStart, text.size() - runStart);
+    out += '"';
+}
+
+void LLMJsonReader::SkipWhitespace()
+{
+    while (m_position < m_text.size())
+    {
+        char c = m_text[m_position];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            break;
+        ++m_position;
+    }
+}
+
+bool LLMJsonReader::Fail()
+{
+    m_failed = true;
+    return false;
+}
+
+LLMJsonType LLMJsonReader::Peek()
+{
+    if (m_failed)
+        return LLM_JSON_INVALID;
+
+    SkipWhitespace();
+    if (m_position >= m_text.size())
+        return LLM_JSON_INVALID;
+
+    switch (m_text[m_position])
+    {
+        case '{': return LLM_JSON_OBJECT;
+        case '[': return LLM_JSON_ARRAY;
+        case '"': return LLM_JSON_STRING;
+        case 't':
+        case 'f': return LLM_JSON_BOOL;
+        case 'n': return LLM_JSON_NULL;
+        case '-': return LLM_JSON_NUMBER;
+        default:
+            return m_text[m_position] >= '0' && m_text[m_position] <= '9' ? LLM_JSON_NUMBER : LLM_JSON_INVALID;
+    }
+}
+
+bool LLMJsonReader::BeginObject()
+{
+    if (Peek() != LLM_JSON_OBJECT)
+        return false;
+    ++m_position;
+    m_first = true;
+    return true;
+}
+
+bool LLMJsonReader::BeginArray()
+{
+    if (Peek() != LLM_JSON_ARRAY)
+        return false;
+    ++m_position;
+    m_first = true;
+    return true;
+}
+
+bool LLMJsonReader::NextMember(std::string_view& key)
+{
+    if (m_failed)
+        return false;
+
+    SkipWhitespace();
+    if (m_position < m_text.size() && m_text[m_position] == '}')
+    {
+        ++m_position;
+        m_first = false;
+        return false;
+    }
+    if (!m_first)
+    {
+        if (m_position >= m_text.size() || m_text[m_position] != ',')
+            return Fail();
+        ++m_position;
+        SkipWhitespace();
+    }
+    m_first = false;
+
+    if (m_position >= m_text.size() || m_text[m_position] != '"')
+        return Fail();
+    size_t keyStart = m_position + 1;
+    if (!SkipString())
+        return false;
+    key = m_text.substr(keyStart, m_position - 1 - keyStart);
+
+    SkipWhitespace();
+    if (m_position >= m_text.size() || m_text[m_position] != ':')
+        return Fail();
+    ++m_position;
+    return true;
+}
+
+bool LLMJsonReader::NextElement()
+{
+    if (m_failed)
+        return false;
+
+    SkipWhitespace();
+    if (m_position < m_text.size() && m_text[m_position] == ']')
+    {
+        ++m_position;
+        m_first = false;
+        return false;
+    }
+    if (!m_first)
+    {
+        if (m_position >= m_text.size() || m_text[m_position] != ',')
+            return Fail();
+        ++m_position;
+    }
+    m_first = false;
+    return true;
+}
+
+bool LLMJsonReader::SkipString()
+{
+    // At the opening quote; ends just past the closing one
+    ++m_position;
+    while (true)
+    {
+        size_t next = m_text.find_first_of("\"\\", m_position);
+        if (next == std::string_view::npos)
+            return Fail();
+        if (m_text[next] == '"')
+        {
+            m_position = next + 1;
+            return true;
+        }
+        m_position = next + 2;
+    }
+}
+
+// What can follow a number or a literal
+static bool IsDelimiter(char c)
+{
+    return c == ',' || c == '}' || c == ']' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void AppendUtf8(std::string& out, uint32 codepoint)
+{
+    if (codepoint < 0x80)
+        out += char(codepoint);
+    else if (codepoint < 0x800)
+    {
+        out += char(0xC0 | (codepoint >> 6));
+        out += char(0x80 | (codepoint & 0x3F));
+    }
+    else if (codepoint < 0x10000)
+    {
+        out += char(0xE0 | (codepoint >> 12));
+        out += char(0x80 | ((codepoint >> 6) & 0x3F));
+        out += char(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        out += char(0xF0 | (codepoint >> 18));
+        out += char(0x80 | ((codepoint >> 12) & 0x3F));
+        out += char(0x80 | ((codepoint >> 6) & 0x3F));
+        out += char(0x80 | (codepoint & 0x3F));
+    }
+}
+
+static bool ReadHex4(std::string_view text, size_t position, uint32& value)
+{
+    if (position + 4 > text.size())
+        return false;
+    value = 0;
+    for (size_t i = position; i < position + 4; ++i)
+    {
+        char c = text[i];
+        uint32 digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+        if (digit > 15)
+            return false;
+        value = value << 4 | digit;
+    }
+    return true;
+}
+
+bool LLMJsonReader::DecodeString(std::string& out)
+{
+    // At the opening quote; ends just past the closing one
+    ++m_position;
+    while (true)
+    {
+        size_t next = m_text.find_first_of("\"\\", m_position);
+        if (next == std::string_view::npos)
+            return Fail();
+        out.append(m_text.data() + m_position, next - m_position);
+        m_position = next + 1;
+        if (m_text[next] == '"')
+            return true;
+
+        if (m_position >= m_text.size())
+            return Fail();
+        char escaped = m_text[m_position++];
+        switch (escaped)
+        {
+            case '"':  out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'u':
+            {
+                uint32 codepoint;
+                if (!ReadHex4(m_text, m_position, codepoint))
+                    return Fail();
+                m_position += 4;
+                // A surrogate pair spells one character outside the basic plane
+                uint32 low;
+                if (codepoint >= 0xD800 && codepoint < 0xDC00 && m_text.substr(m_position, 2) == "\\u" &&
+                    ReadHex4(m_text, m_position + 2, low) && low >= 0xDC00 && low < 0xE000)
+                {
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    m_position += 6;
+                }
+                else if (codepoint >= 0xD800 && codepoint < 0xE000)
+                    codepoint = 0xFFFD;
+                AppendUtf8(out, codepoint);
+                break;
+            }
+            default:
+                return Fail();
+        }
+    }
+}
+
+bool LLMJsonReader::ReadString(std::string& out)
+{
+    if (Peek() != LLM_JSON_STRING)
+    {
+        Skip();
+        return false;
+    }
+    return DecodeString(out);
+}
+
+bool LLMJsonReader::ReadBool(bool& value)
+{
+    if (Peek() != LLM_JSON_BOOL)
+    {
+        Skip();
+        return false;
+    }
+    if (m_text.substr(m_position, 4) == "true")
+    {
+        value = true;
+        m_position += 4;
+        return true;
+    }
+    if (m_text.substr(m_position, 5) == "false")
+    {
+        value = false;
+        m_position += 5;
+        return true;
+    }
+    return Fail();
+}
+
+bool LLMJsonReader::ReadUint(uint64& value)
+{
+    if (Peek() != LLM_JSON_NUMBER)
+    {
+        Skip();
+        return false;
+    }
+
+    size_t start = m_position;
+    uint64 result = 0;
+    while (m_position < m_text.size() && m_text[m_position] >= '0' && m_text[m_position] <= '9')
+    {
+        uint32 digit = m_text[m_position] - '0';
+        if (result > (UINT64_MAX - digit) / 10)
+            break;
+        result = result * 10 + digit;
+        ++m_position;
+    }
+
+    // Negative, fractional, exponent or too large: not an unsigned integer
+    if (m_position == start || (m_position < m_text.size() && !IsDelimiter(m_text[m_position])))
+    {
+        m_position = start;
+        Skip();
+        return false;
+    }
+    value = result;
+    return true;
+}
+
+bool LLMJsonReader::Skip()
+{
+    std::string_view raw;
+    return Skip(raw);
+}
+
+bool LLMJsonReader::Skip(std::string_view& raw)
+{
+    LLMJsonType type = Peek();
+    size_t start = m_position;
+    switch (type)
+    {
+        case LLM_JSON_INVALID:
+            return Fail();
+        case LLM_JSON_STRING:
+            if (!SkipString())
+                return false;
+            break;
+        case LLM_JSON_OBJECT:
+        case LLM_JSON_ARRAY:
+        {
+            // Only brackets outside strings count; what is between them is not looked at
+            uint32 depth = 0;
+            do
+            {
+                size_t next = m_text.find_first_of("{}[]\"", m_position);
+                if (next == std::string_view::npos)
+                    return Fail();
+                m_position = next;
+                char c = m_text[next];
+                if (c == '"')
+                {
+                    if (!SkipString())
+                        return false;
+                    continue;
+                }
+                ++m_position;
+                if (c == '{' || c == '[')
+                    ++depth;
+                else
+                    --depth;
+            } while (depth);
+            break;
+        }
+        default:
+            // Numbers and literals run to the next delimiter
+            while (m_position < m_text.size() && !IsDelimiter(m_text[m_position]))
+                ++m_position;
+            break;
+    }
+    raw = m_text.substr(start, m_position - start);
+    return true;
+}
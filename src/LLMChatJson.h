@@ -0,0 +1,96 @@
+#ifndef MOD_LLM_CHAT_JSON_H
+#define MOD_LLM_CHAT_JSON_H
+
+#include "Define.h"
+#include <string>
+#include <string_view>
+
+// Writes JSON straight into a string, for request bodies built once and sent: no document,
+// no per-value allocations, strings escaped as they are appended.
+class LLMJsonWriter
+{
+public:
+    explicit LLMJsonWriter(std::string& out) : m_out(out) {}
+
+    LLMJsonWriter& BeginObject();
+    LLMJsonWriter& EndObject();
+    LLMJsonWriter& BeginArray();
+    LLMJsonWriter& EndArray();
+    LLMJsonWriter& Key(std::string_view key);
+    LLMJsonWriter& String(std::string_view value);
+    LLMJsonWriter& Uint(uint64 value);
+    LLMJsonWriter& Double(double value);    // null when not finite
+    LLMJsonWriter& Bool(bool value);
+
+    // Appends `text` as a quoted JSON string
+    static void AppendString(std::string& out, std::string_view text);
+
+private:
+    void Separate();
+
+    std::string& m_out;
+    bool m_first = true;        // Nothing written yet in the innermost object or array
+    bool m_afterKey = false;
+};
+
+enum LLMJsonType : uint8
+{
+    LLM_JSON_INVALID,   // Malformed input or the end of the text
+    LLM_JSON_OBJECT,
+    LLM_JSON_ARRAY,
+    LLM_JSON_STRING,
+    LLM_JSON_NUMBER,
+    LLM_JSON_BOOL,
+    LLM_JSON_NULL
+};
+
+// Pulls the values it is asked for out of a JSON text in place, without building a document.
+// Members and elements are visited in order; a value that is not read is skipped over without
+// being decoded. It checks no more of the syntax than it needs to find its way: once it meets
+// something it cannot read every call fails, which callers treat like a parse error.
+//
+//     LLMJsonReader reader(line);
+//     std::string_view key;
+//     if (reader.BeginObject())
+//         while (reader.NextMember(key))
+//             if (key == "response") reader.ReadString(text); else reader.Skip();
+class LLMJsonReader
+{
+public:
+    explicit LLMJsonReader(std::string_view text) : m_text(text) {}
+
+    bool IsValid() const { return !m_failed; }
+    LLMJsonType Peek();
+
+    // Enters the object or array that comes next; false, with nothing consumed, when it is
+    // something else
+    bool BeginObject();
+    bool BeginArray();
+    // The next member's key, as written (escapes are not decoded); false after the last member,
+    // which leaves the object
+    bool NextMember(std::string_view& key);
+    // Whether another element follows; false after the last one, which leaves the array
+    bool NextElement();
+
+    // Each reads the next value if it has the type asked for, else skips it and returns false
+    bool ReadString(std::string& out);      // Appends the decoded text
+    bool ReadBool(bool& value);
+    bool ReadUint(uint64& value);           // Non-negative integers only
+
+    // Skips the next value, whatever it holds; `raw` gets its text as written
+    bool Skip();
+    bool Skip(std::string_view& raw);
+
+private:
+    void SkipWhitespace();
+    bool Fail();
+    bool SkipString();
+    bool DecodeString(std::string& out);
+
+    std::string_view m_text;
+    size_t m_position = 0;
+    bool m_first = true;        // Next member or element is the first of its object or array
+    bool m_failed = false;
+};
+
+#endif // MOD_LLM_CHAT_JSON_H
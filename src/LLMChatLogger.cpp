@@ -1,69 +1,428 @@
 #include "LLMChatLogger.h"
+#include "LLMChatJson.h"
+#include "LLMChatRing.h"
 #include "Log.h"
 #include "mod-llm-chat-config.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-void LLMChatLogger::Log(uint32_t level, std::string const& message) {
-    if (!LLM_Config.Enable)
-        return;
+// How long a line may wait in the ring before the writer picks it up
+static constexpr std::chrono::milliseconds FLUSH_INTERVAL{50};
+// Lines dropped while the ring was full are reported at most this often
+static constexpr std::chrono::seconds DROP_REPORT_INTERVAL{10};
+
+enum LLMLogSeverity : uint8
+{
+    LLM_LOG_SEVERITY_INFO,
+    LLM_LOG_SEVERITY_ERROR,
+    LLM_LOG_SEVERITY_DEBUG
+};
+
+struct LLMLogRecord
+{
+    LLMLogSeverity severity = LLM_LOG_SEVERITY_INFO;
+    std::chrono::system_clock::time_point time;
+    std::string text;           // Log line; empty for a transcript not logged at the current level
+    std::string transcript;     // JSON line for the transcript file
+};
+
+// A log file that starts over in a new file once it reaches its size limit
+struct LLMLogFile
+{
+    std::string path;
+    FILE* handle = nullptr;
+    uint64 size = 0;
+    std::string failedPath;     // Not retried until the configured path changes
+    bool written = false;       // Since the last flush
+};
+
+static std::unique_ptr<LLMChatRing<LLMLogRecord>> s_ring;
+static std::atomic<bool> s_accepting{false};
+static std::atomic<bool> s_stopping{false};
+static std::atomic<uint64> s_dropped{0};
+// Pushed and not yet written; may dip below zero when a record is written before its
+// producer counted it
+static std::atomic<int64> s_pending{0};
+static std::mutex s_wakeMutex;
+static std::condition_variable s_wakeCondition;
+static std::thread s_writerThread;
+// Held by whoever writes the files: the writer thread, or the logging thread itself while
+// there is no writer
+static std::mutex s_outputMutex;
+static LLMLogFile s_logFile;
+static LLMLogFile s_transcriptFile;
+
+static char* AppendDigits(char* out, uint32 value, uint32 width)
+{
+    for (uint32 i = width; i-- > 0; value /= 10)
+        out[i] = char('0' + value % 10);
+    return out + width;
+}
+
+// "2026-01-31 18:04:05.123", in UTC; written by hand, a format string costs more than the line
+static void AppendTimestamp(std::string& out, std::chrono::system_clock::time_point time, char separator)
+{
+    auto day = std::chrono::floor<std::chrono::days>(time);
+    std::chrono::year_month_day date{day};
+    std::chrono::hh_mm_ss clock{std::chrono::floor<std::chrono::milliseconds>(time - day)};
+
+    char buffer[24];
+    char* end = AppendDigits(buffer, uint32(int(date.year())), 4);
+    *end++ = '-';
+    end = AppendDigits(end, unsigned(date.month()), 2);
+    *end++ = '-';
+    end = AppendDigits(end, unsigned(date.day()), 2);
+    *end++ = separator;
+    end = AppendDigits(end, uint32(clock.hours().count()), 2);
+    *end++ = ':';
+    end = AppendDigits(end, uint32(clock.minutes().count()), 2);
+    *end++ = ':';
+    end = AppendDigits(end, uint32(clock.seconds().count()), 2);
+    *end++ = '.';
+    end = AppendDigits(end, uint32(clock.subseconds().count()), 3);
+    out.append(buffer, end);
+}
+
+static void CloseLogFile(LLMLogFile& file)
+{
+    if (file.handle)
+        std::fclose(file.handle);
+    file.handle = nullptr;
+    file.path.clear();
+    file.size = 0;
+    file.written = false;
+}
+
+static bool OpenLogFile(LLMLogFile& file, std::string const& path)
+{
+    if (file.handle && file.path == path)
+        return true;
+    if (file.failedPath == path)
+        return false;
 
-    if (LLM_Config.Logging.LogLevel >= level)
+    CloseLogFile(file);
+    file.handle = std::fopen(path.c_str(), "ab");
+    if (!file.handle)
     {
-        if (LLM_Config.Logging.LogToConsole)
-            LOG_INFO("module", "[LLMChat] {}", message);
+        file.failedPath = path;
+        LOG_ERROR("module", "[LLMChat] Cannot open log file {}", path);
+        return false;
+    }
 
-        if (LLM_Config.Logging.LogToFile)
-        {
-            // TODO: Implement file logging
-        }
+    std::fseek(file.handle, 0, SEEK_END);
+    long size = std::ftell(file.handle);
+    file.path = path;
+    file.size = size > 0 ? uint64(size) : 0;
+    file.failedPath.clear();
+    return true;
+}
+
+// file -> file.1 -> file.2 ... the oldest beyond maxFiles is deleted
+static void RotateLogFile(LLMLogFile& file, uint32 maxFiles)
+{
+    std::string path = file.path;
+    CloseLogFile(file);
+
+    std::error_code error;
+    if (maxFiles)
+    {
+        std::filesystem::remove(fmt::format("{}.{}", path, maxFiles), error);
+        for (uint32 i = maxFiles; i > 1; --i)
+            std::filesystem::rename(fmt::format("{}.{}", path, i - 1), fmt::format("{}.{}", path, i), error);
+        std::filesystem::rename(path, path + ".1", error);
     }
+    else
+        std::filesystem::remove(path, error);
+
+    OpenLogFile(file, path);
 }
 
-void LLMChatLogger::LogChat(std::string const& playerName, std::string const& input, std::string const& response) {
-    if (!LLM_Config.Enable)
+static void WriteLogFile(LLMLogFile& file, std::string const& path, std::string_view text, struct LLMConfig::Logging const& config)
+{
+    if (!OpenLogFile(file, path))
         return;
-    
-    // Only log chat at detailed level or higher
-    if (LLM_Config.Logging.LogLevel >= 2)
+
+    if (config.MaxFileSize && file.size && file.size + text.size() > config.MaxFileSize)
     {
-        if (LLM_Config.Logging.LogToConsole)
+        RotateLogFile(file, config.MaxFiles);
+        if (!file.handle)
+            return;
+    }
+
+    std::fwrite(text.data(), 1, text.size(), file.handle);
+    file.size += text.size();
+    file.written = true;
+}
+
+static void FlushLogFile(LLMLogFile& file)
+{
+    if (file.handle && file.written)
+        std::fflush(file.handle);
+    file.written = false;
+}
+
+// Caller holds s_outputMutex
+static void Output(LLMLogRecord const& record, struct LLMConfig::Logging const& config)
+{
+    if (!record.text.empty())
+    {
+        if (config.LogToConsole)
         {
-            std::string inputMsg = "Player " + playerName + " says: " + input;
-            std::string responseMsg = "AI Response: " + response;
-            LOG_INFO("module", "[LLMChat] {}", inputMsg);
-            LOG_INFO("module", "[LLMChat] {}", responseMsg);
+            switch (record.severity)
+            {
+                case LLM_LOG_SEVERITY_ERROR: LOG_ERROR("module", "[LLMChat] {}", record.text); break;
+                case LLM_LOG_SEVERITY_DEBUG: LOG_DEBUG("module", "[LLMChat] {}", record.text); break;
+                default:                     LOG_INFO("module", "[LLMChat] {}", record.text); break;
+            }
         }
 
-        if (LLM_Config.Logging.LogToFile)
+        if (config.LogToFile && !config.LogFile.empty())
         {
-            // TODO: Implement file logging
+            static constexpr char const* SEVERITY[] = { "INFO ", "ERROR", "DEBUG" };
+            thread_local std::string t_line;
+            t_line.clear();
+            AppendTimestamp(t_line, record.time, ' ');
+            t_line += ' ';
+            t_line += SEVERITY[record.severity];
+            t_line += ' ';
+            t_line += record.text;
+            t_line += '\n';
+            WriteLogFile(s_logFile, config.LogFile, t_line, config);
         }
     }
+
+    if (!record.transcript.empty() && !config.TranscriptFile.empty())
+        WriteLogFile(s_transcriptFile, config.TranscriptFile, record.transcript, config);
 }
 
-void LLMChatLogger::LogError(std::string const& message) {
-    if (!LLM_Config.Enable)
+static void Push(LLMLogRecord&& record)
+{
+    record.time = std::chrono::system_clock::now();
+
+    // The ring is never freed, so a thread that saw it accepting may still push after Shutdown
+    // began; what it pushes then is written by Shutdown's last drain or lost, never blocked on
+    if (s_accepting.load(std::memory_order_acquire))
+    {
+        if (!s_ring->TryPush(std::move(record)))
+        {
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // Otherwise the writer comes by on its timer; a burst that fills half the ring before
+        // then calls it early. Notified without the lock: a wakeup lost to that race only
+        // means waiting for the timer.
+        if (s_pending.fetch_add(1, std::memory_order_relaxed) + 1 == int64(s_ring->Capacity() / 2))
+            s_wakeCondition.notify_one();
         return;
+    }
 
-    LOG_ERROR("module", "[LLMChat] {}", message);
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(s_outputMutex);
+    Output(record, config->Logging);
+    FlushLogFile(s_logFile);
+    FlushLogFile(s_transcriptFile);
+}
 
-    if (LLM_Config.Logging.LogToFile)
+// Writer thread, or Shutdown once the writer has stopped
+static void Drain()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(s_outputMutex);
+    int64 written = 0;
+    while (std::optional<LLMLogRecord> record = s_ring->TryPop())
     {
-        // TODO: Implement file logging
+        Output(*record, config->Logging);
+        ++written;
     }
+    s_pending.fetch_sub(written, std::memory_order_relaxed);
+    FlushLogFile(s_logFile);
+    FlushLogFile(s_transcriptFile);
 }
 
-void LLMChatLogger::LogDebug(std::string const& message) {
-    if (!LLM_Config.Enable)
+static void ReportDropped(uint64& reported)
+{
+    uint64 dropped = s_dropped.load(std::memory_order_relaxed);
+    if (dropped == reported)
         return;
 
-    if (LLM_Config.Logging.LogLevel >= 2)
+    LLMLogRecord record;
+    record.severity = LLM_LOG_SEVERITY_ERROR;
+    record.time = std::chrono::system_clock::now();
+    record.text = fmt::format("{} log lines dropped while the log queue was full (LLMChat.Log.QueueSize)", dropped - reported);
+    reported = dropped;
+
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(s_outputMutex);
+    Output(record, config->Logging);
+}
+
+void LLMChatLogger::Initialize()
+{
+    if (s_accepting)
+        return;
+
+    // Kept across restarts, like the queue's mailbox: a thread may still be pushing into it
+    if (!s_ring)
+        s_ring = std::make_unique<LLMChatRing<LLMLogRecord>>(sLLMConfig->Logging.QueueSize);
+
+    s_stopping = false;
+    s_writerThread = std::thread(&LLMChatLogger::WriterThread);
+    s_accepting.store(true, std::memory_order_release);
+}
+
+void LLMChatLogger::Shutdown()
+{
+    if (!s_writerThread.joinable())
+        return;
+
+    // From here on lines are written by the thread that logs them
+    s_accepting.store(false, std::memory_order_release);
     {
-        if (LLM_Config.Logging.LogToConsole)
-            LOG_DEBUG("module", "[LLMChat] {}", message);
+        std::lock_guard<std::mutex> lock(s_wakeMutex);
+        s_stopping = true;
+    }
+    s_wakeCondition.notify_one();
+    s_writerThread.join();
+
+    Drain();
+    std::lock_guard<std::mutex> lock(s_outputMutex);
+    CloseLogFile(s_logFile);
+    CloseLogFile(s_transcriptFile);
+}
 
-        if (LLM_Config.Logging.LogToFile)
+void LLMChatLogger::WriterThread()
+{
+    uint64 reported = 0;
+    auto nextDropReport = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        Drain();
+
+        if (std::chrono::steady_clock::now() >= nextDropReport)
         {
-            // TODO: Implement file logging
+            ReportDropped(reported);
+            nextDropReport = std::chrono::steady_clock::now() + DROP_REPORT_INTERVAL;
         }
+
+        std::unique_lock<std::mutex> lock(s_wakeMutex);
+        if (s_stopping)
+            break;
+        s_wakeCondition.wait_for(lock, FLUSH_INTERVAL, [] {
+            return s_stopping.load() || s_pending.load(std::memory_order_relaxed) >= int64(s_ring->Capacity() / 2);
+        });
     }
-} 
\ No newline at end of file
+
+    ReportDropped(reported);
+}
+
+bool LLMChatLogger::IsEnabled(uint32 level)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    return config->Enable && config->Logging.LogLevel >= level;
+}
+
+bool LLMChatLogger::Sample(std::atomic<uint32>& counter)
+{
+    uint32 every = sLLMConfig->Logging.SampleEvery;
+    return every <= 1 || counter.fetch_add(1, std::memory_order_relaxed) % every == 0;
+}
+
+void LLMChatLogger::Write(uint32 level, std::string&& message)
+{
+    LLMLogRecord record;
+    record.severity = level >= LLM_LOG_DEBUG ? LLM_LOG_SEVERITY_DEBUG : LLM_LOG_SEVERITY_INFO;
+    record.text = std::move(message);
+    Push(std::move(record));
+}
+
+void LLMChatLogger::Log(uint32 level, std::string const& message)
+{
+    if (IsEnabled(level))
+        Write(level, std::string(message));
+}
+
+void LLMChatLogger::LogChat(std::string const& playerName, std::string const& input, std::string const& response)
+{
+    LLMChatTranscript transcript;
+    transcript.sender = playerName;
+    transcript.message = input;
+    transcript.reply = response;
+    LogTranscript(transcript);
+}
+
+void LLMChatLogger::LogTranscript(LLMChatTranscript const& transcript)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Enable)
+        return;
+
+    // The transcript file is kept whatever the log level; the log shows chat from level 2
+    bool logged = config->Logging.LogLevel >= LLM_LOG_DETAIL;
+    bool recorded = !config->Logging.TranscriptFile.empty();
+    if (!logged && !recorded)
+        return;
+
+    LLMLogRecord record;
+    if (logged)
+    {
+        record.text = transcript.bot.empty() ?
+            fmt::format("{} says: {}\nAI Response: {}", transcript.sender, transcript.message, transcript.reply) :
+            fmt::format("{} to {} ({}, {}): {}", transcript.bot, transcript.sender, transcript.chatType,
+                transcript.source, transcript.reply);
+    }
+
+    if (recorded)
+    {
+        std::string time;
+        AppendTimestamp(time, std::chrono::system_clock::now(), 'T');
+        time += 'Z';
+
+        std::string& line = record.transcript;
+        line.reserve(transcript.message.size() + transcript.reply.size() + 160);
+        LLMJsonWriter writer(line);
+        writer.BeginObject();
+        writer.Key("time").String(time);
+        if (transcript.request)
+            writer.Key("request").Uint(transcript.request);
+        writer.Key("sender").String(transcript.sender);
+        writer.Key("bot").String(transcript.bot);
+        writer.Key("chat_type").String(transcript.chatType);
+        writer.Key("source").String(transcript.source);
+        writer.Key("message").String(transcript.message);
+        writer.Key("reply").String(transcript.reply);
+        writer.EndObject();
+        line += '\n';
+    }
+
+    Push(std::move(record));
+}
+
+void LLMChatLogger::LogError(std::string const& message)
+{
+    if (!IsEnabled(LLM_LOG_ERROR))
+        return;
+
+    LLMLogRecord record;
+    record.severity = LLM_LOG_SEVERITY_ERROR;
+    record.text = message;
+    Push(std::move(record));
+}
+
+void LLMChatLogger::LogDebug(std::string const& message)
+{
+    if (!IsEnabled(LLM_LOG_DETAIL))
+        return;
+
+    LLMLogRecord record;
+    record.severity = LLM_LOG_SEVERITY_DEBUG;
+    record.text = message;
+    Push(std::move(record));
+}
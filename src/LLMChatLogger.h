@@ -1,15 +1,75 @@
 #ifndef _MOD_LLM_CHAT_LOGGER_H_
 #define _MOD_LLM_CHAT_LOGGER_H_
 
+#include <atomic>
 #include <string>
+#include <string_view>
+#include <fmt/format.h>
 #include "mod-llm-chat-config.h"
 
+// Verbosity of a line, against LLMChat.LogLevel
+enum LLMLogLevel : uint8
+{
+    LLM_LOG_ERROR  = 1,
+    LLM_LOG_DETAIL = 2,     // Events and chat interactions
+    LLM_LOG_DEBUG  = 3      // Prompts, payloads and other technical details
+};
+
+// One reply as it went out, for the chat transcript
+struct LLMChatTranscript
+{
+    std::string_view sender;
+    std::string_view bot;
+    std::string_view chatType;
+    std::string_view message;
+    std::string_view reply;
+    std::string_view source;    // "llm", "stream", "group", "cache"
+    uint64 request = 0;         // Request ID, as in the log and the trace
+};
+
+// The module's log. Lines are formatted by the thread that logs them, after the level check,
+// and handed to a writer thread through a lock-free ring; the writer passes them on to the
+// server log and appends them to LLMChat.Log.File, and transcripts to a JSON Lines file. A
+// thread that logs never waits on a lock or on disk: when the ring is full the line is
+// dropped and counted. Before Initialize and after Shutdown lines are written at once.
 class LLMChatLogger {
 public:
+    static void Initialize();
+    static void Shutdown();     // Writes out what is still queued
+
+    static bool IsEnabled(uint32 level);
+    // Every LLMChat.Log.SampleEvery-th call with the same counter passes
+    static bool Sample(std::atomic<uint32>& counter);
+
     static void Log(uint32 level, std::string const& message);
     static void LogChat(std::string const& playerName, std::string const& input, std::string const& response);
+    static void LogTranscript(LLMChatTranscript const& transcript);
     static void LogError(std::string const& message);
     static void LogDebug(std::string const& message);
+
+    // Queues a line that passed the level check
+    static void Write(uint32 level, std::string&& message);
+
+private:
+    static void WriterThread();
 };
 
-#endif // _MOD_LLM_CHAT_LOGGER_H_ 
\ No newline at end of file
+// The arguments are only formatted when the level is logged
+#define LLMCHAT_LOG(level, ...)                                                          \
+    do                                                                                  \
+    {                                                                                   \
+        if (LLMChatLogger::IsEnabled(level))                                            \
+            LLMChatLogger::Write(level, fmt::format(__VA_ARGS__));                      \
+    } while (0)
+
+// For lines too large or too frequent to log every time: one in LLMChat.Log.SampleEvery
+// calls from this place is logged
+#define LLMCHAT_LOG_SAMPLED(level, ...)                                                  \
+    do                                                                                  \
+    {                                                                                   \
+        static std::atomic<uint32> llmLogSampleCounter{0};                              \
+        if (LLMChatLogger::IsEnabled(level) && LLMChatLogger::Sample(llmLogSampleCounter)) \
+            LLMChatLogger::Write(level, fmt::format(__VA_ARGS__));                      \
+    } while (0)
+
+#endif // _MOD_LLM_CHAT_LOGGER_H_
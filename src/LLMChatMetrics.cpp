@@ -0,0 +1,347 @@
+#include "LLMChatMetrics.h"
+#include "LLMChatEngine.h"
+#include "LLMChatQueue.h"
+#include "Log.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+
+// More shards than threads that record: the world thread, the queue worker and the engine's
+static constexpr uint32 SHARD_COUNT = 16;
+
+struct alignas(64) LLMMetricsShard
+{
+    struct Histogram
+    {
+        std::array<std::atomic<uint64>, LLM_HISTOGRAM_BUCKETS> buckets{};
+        std::atomic<uint64> sum{0};
+        std::atomic<uint64> max{0};
+    };
+
+    std::array<std::atomic<uint64>, LLM_COUNTER_COUNT> counters{};
+    std::array<Histogram, LLM_HISTOGRAM_COUNT> histograms{};
+};
+
+static std::array<LLMMetricsShard, SHARD_COUNT> s_shards;
+static std::atomic<uint32> s_nextShard{0};
+static std::chrono::steady_clock::time_point s_nextWrite;
+static bool s_writeFailed = false;
+
+struct LLMCounterInfo
+{
+    char const* family;
+    char const* labels;
+    char const* help;
+};
+
+// Counters of one family sit next to each other, so each family's HELP is written once
+static constexpr LLMCounterInfo COUNTERS[LLM_COUNTER_COUNT] =
+{
+    { "llmchat_replies_total",    "",                     "Replies handed over for delivery, generated or cached" },
+    { "llmchat_cache_hits_total", "cache=\"exact\"",      "Messages answered from a reply cache" },
+    { "llmchat_cache_hits_total", "cache=\"similar\"",    nullptr },
+    { "llmchat_fallbacks_total",  "",                     "Canned replies sent in place of a generated one" },
+    { "llmchat_errors_total",     "type=\"transport\"",   "Failed generations by cause" },
+    { "llmchat_errors_total",     "type=\"breaker\"",     nullptr },
+    { "llmchat_errors_total",     "type=\"no_backend\"",  nullptr },
+    { "llmchat_errors_total",     "type=\"timeout\"",     nullptr },
+    { "llmchat_errors_total",     "type=\"http\"",        nullptr },
+    { "llmchat_errors_total",     "type=\"api\"",         nullptr },
+    { "llmchat_errors_total",     "type=\"parse\"",       nullptr },
+    { "llmchat_errors_total",     "type=\"empty\"",       nullptr },
+    { "llmchat_errors_total",     "type=\"exception\"",   nullptr },
+};
+
+static constexpr char const* ERROR_NAMES[LLM_COUNTER_COUNT - LLM_COUNTER_ERROR_TRANSPORT] =
+{
+    "transport", "breaker", "no backend", "timeout", "http", "api", "parse", "empty", "exception"
+};
+
+struct LLMHistogramInfo
+{
+    char const* family;
+    char const* name;
+    char const* help;
+};
+
+static constexpr LLMHistogramInfo HISTOGRAMS[LLM_HISTOGRAM_COUNT] =
+{
+    { "llmchat_queue_wait_seconds",  "Queue wait",  "Time from enqueue to dispatch" },
+    { "llmchat_connect_seconds",     "Connect",     "DNS, connect and TLS handshake of new backend connections" },
+    { "llmchat_first_token_seconds", "First token", "Time from request to the first generated text of streamed replies" },
+    { "llmchat_generation_seconds",  "Generation",  "Time from request to the complete reply" },
+    { "llmchat_delivery_seconds",    "Delivery",    "Time from a reply being ready to it being said in game" },
+};
+
+// Prometheus buckets, in seconds; the finer buckets behind them are only summed up here
+static constexpr double EXPORT_BOUNDS[] = { 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 20, 30, 60, 120, 300 };
+
+static LLMMetricsShard& GetShard()
+{
+    thread_local LLMMetricsShard& t_shard = s_shards[s_nextShard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT];
+    return t_shard;
+}
+
+uint32 LLMHistogramSnapshot::BucketOf(uint64 micros)
+{
+    micros = std::min<uint64>(micros, (uint64(1) << LLM_HISTOGRAM_MAX_BITS) - 1);
+    if (micros < LLM_HISTOGRAM_SUB_BUCKETS)
+        return uint32(micros);
+
+    uint32 shift = uint32(std::bit_width(micros)) - 1 - LLM_HISTOGRAM_SUB_BUCKET_BITS;
+    return (shift + 1) * LLM_HISTOGRAM_SUB_BUCKETS + uint32(micros >> shift) - LLM_HISTOGRAM_SUB_BUCKETS;
+}
+
+uint64 LLMHistogramSnapshot::BucketUpperBound(uint32 bucket)
+{
+    if (bucket < LLM_HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+
+    uint32 shift = bucket / LLM_HISTOGRAM_SUB_BUCKETS - 1;
+    uint64 subBucket = bucket % LLM_HISTOGRAM_SUB_BUCKETS + LLM_HISTOGRAM_SUB_BUCKETS;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+uint64 LLMHistogramSnapshot::Percentile(double fraction) const
+{
+    if (!count)
+        return 0;
+
+    uint64 rank = std::max<uint64>(1, uint64(fraction * double(count) + 0.5));
+    uint64 seen = 0;
+    for (uint32 i = 0; i < LLM_HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(BucketUpperBound(i), max);
+    }
+    return max;
+}
+
+uint64 LLMHistogramSnapshot::CountUpTo(uint64 limit) const
+{
+    // A bucket straddling the limit counts above it: exported latencies err on the slow side
+    uint64 total = 0;
+    for (uint32 i = 0; i < LLM_HISTOGRAM_BUCKETS && BucketUpperBound(i) <= limit; ++i)
+        total += buckets[i];
+    return total;
+}
+
+void LLMChatMetrics::Initialize()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    s_nextWrite = std::chrono::steady_clock::now();
+    s_writeFailed = false;
+
+    if (!config->Metrics.File.empty())
+        LOG_INFO("module", "[LLMChat] Writing metrics to {} every {}s", config->Metrics.File, config->Metrics.Interval.count());
+}
+
+void LLMChatMetrics::Add(LLMCounter counter, uint64 amount)
+{
+    GetShard().counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+void LLMChatMetrics::Record(LLMHistogram histogram, std::chrono::steady_clock::duration value)
+{
+    int64 micros = std::chrono::duration_cast<std::chrono::microseconds>(value).count();
+    uint64 sample = micros > 0 ? uint64(micros) : 0;
+
+    LLMMetricsShard::Histogram& shard = GetShard().histograms[histogram];
+    shard.buckets[LLMHistogramSnapshot::BucketOf(sample)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(sample, std::memory_order_relaxed);
+    uint64 max = shard.max.load(std::memory_order_relaxed);
+    while (sample > max && !shard.max.compare_exchange_weak(max, sample, std::memory_order_relaxed))
+        ;
+}
+
+void LLMChatMetrics::Collect(LLMMetricsSnapshot& snapshot)
+{
+    snapshot = LLMMetricsSnapshot();
+    for (LLMMetricsShard const& shard : s_shards)
+    {
+        for (uint32 i = 0; i < LLM_COUNTER_COUNT; ++i)
+            snapshot.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+
+        for (uint32 i = 0; i < LLM_HISTOGRAM_COUNT; ++i)
+        {
+            LLMMetricsShard::Histogram const& from = shard.histograms[i];
+            LLMHistogramSnapshot& to = snapshot.histograms[i];
+            for (uint32 bucket = 0; bucket < LLM_HISTOGRAM_BUCKETS; ++bucket)
+            {
+                uint64 count = from.buckets[bucket].load(std::memory_order_relaxed);
+                to.buckets[bucket] += count;
+                to.count += count;
+            }
+            to.sum += from.sum.load(std::memory_order_relaxed);
+            to.max = std::max(to.max, from.max.load(std::memory_order_relaxed));
+        }
+    }
+}
+
+void LLMChatMetrics::Update()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (config->Metrics.File.empty())
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < s_nextWrite)
+        return;
+
+    s_nextWrite = now + config->Metrics.Interval;
+    WriteFile(config->Metrics.File);
+}
+
+void LLMChatMetrics::WriteFile(std::string const& path)
+{
+    std::string text;
+    FormatPrometheus(text);
+
+    // Written aside and renamed over the old file, so a scrape never reads half of it
+    std::string temporary = path + ".tmp";
+    bool written = false;
+    if (FILE* file = std::fopen(temporary.c_str(), "wb"))
+    {
+        written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        written = std::fclose(file) == 0 && written;
+    }
+
+    std::error_code error;
+    if (written)
+        std::filesystem::rename(temporary, path, error);
+
+    if (!written || error)
+    {
+        if (!s_writeFailed)
+            LOG_ERROR("module", "[LLMChat] Cannot write metrics to {}", path);
+        s_writeFailed = true;
+        return;
+    }
+    s_writeFailed = false;
+}
+
+static std::string FormatDuration(uint64 micros)
+{
+    if (micros < 1000)
+        return fmt::format("{}us", micros);
+    if (micros < 10000000)
+        return fmt::format("{}ms", micros / 1000);
+    return fmt::format("{:.1f}s", double(micros) / 1000000.0);
+}
+
+void LLMChatMetrics::FormatSummary(std::vector<std::string>& lines)
+{
+    LLMMetricsSnapshot snapshot;
+    Collect(snapshot);
+
+    std::string queued;
+    uint32 queuedTotal = 0;
+    uint64 enqueued = 0, dispatched = 0, dropped = 0, expired = 0, superseded = 0, abandoned = 0;
+    for (uint8 i = 0; i < LLM_PRIORITY_COUNT; ++i)
+    {
+        LLMPriorityClassStats const& stats = LLMChatQueue::GetClassStats(LLMChatPriority(i));
+        uint32 classQueued = stats.queued.load();
+        fmt::format_to(std::back_inserter(queued), "{}{} {}", i ? ", " : "", LLMConfig::GetPriorityClassName(LLMChatPriority(i)),
+            classQueued);
+        queuedTotal += classQueued;
+        enqueued += stats.enqueued.load();
+        dispatched += stats.dispatched.load();
+        dropped += stats.dropped.load() + stats.shed.load() + stats.preempted.load();
+        expired += stats.expired.load();
+        superseded += stats.superseded.load() + stats.cancelled.load();
+        abandoned += stats.abandoned.load();
+    }
+
+    lines.push_back(fmt::format("LLMChat: {} queued ({}), {} requests in flight", queuedTotal, queued,
+        LLMChatEngine::GetInFlight()));
+    lines.push_back(fmt::format("Messages: {} enqueued, {} dispatched, {} dropped or shed, {} expired, {} superseded, {} abandoned",
+        enqueued, dispatched, dropped, expired, superseded, abandoned));
+
+    std::string errors;
+    uint64 errorTotal = 0;
+    for (uint32 i = LLM_COUNTER_ERROR_TRANSPORT; i < LLM_COUNTER_COUNT; ++i)
+    {
+        if (!snapshot.counters[i])
+            continue;
+        fmt::format_to(std::back_inserter(errors), "{}{} {}", errors.empty() ? ": " : ", ",
+            ERROR_NAMES[i - LLM_COUNTER_ERROR_TRANSPORT], snapshot.counters[i]);
+        errorTotal += snapshot.counters[i];
+    }
+    lines.push_back(fmt::format("Replies: {} ({} from the caches), {} fallbacks, {} errors{}", snapshot.counters[LLM_COUNTER_REPLIES],
+        snapshot.counters[LLM_COUNTER_CACHE_HITS] + snapshot.counters[LLM_COUNTER_SIMILARITY_HITS],
+        snapshot.counters[LLM_COUNTER_FALLBACKS], errorTotal, errors));
+
+    for (uint32 i = 0; i < LLM_HISTOGRAM_COUNT; ++i)
+    {
+        LLMHistogramSnapshot const& histogram = snapshot.histograms[i];
+        if (!histogram.count)
+        {
+            lines.push_back(fmt::format("{}: no samples", HISTOGRAMS[i].name));
+            continue;
+        }
+        lines.push_back(fmt::format("{}: p50 {}, p90 {}, p99 {}, max {} ({} samples)", HISTOGRAMS[i].name,
+            FormatDuration(histogram.Percentile(0.5)), FormatDuration(histogram.Percentile(0.9)),
+            FormatDuration(histogram.Percentile(0.99)), FormatDuration(histogram.max), histogram.count));
+    }
+}
+
+void LLMChatMetrics::FormatPrometheus(std::string& out)
+{
+    LLMMetricsSnapshot snapshot;
+    Collect(snapshot);
+    auto writer = std::back_inserter(out);
+
+    fmt::format_to(writer, "# HELP llmchat_queue_depth Messages waiting to be dispatched\n# TYPE llmchat_queue_depth gauge\n");
+    for (uint8 i = 0; i < LLM_PRIORITY_COUNT; ++i)
+        fmt::format_to(writer, "llmchat_queue_depth{{class=\"{}\"}} {}\n", LLMConfig::GetPriorityClassName(LLMChatPriority(i)),
+            LLMChatQueue::GetClassStats(LLMChatPriority(i)).queued.load());
+
+    fmt::format_to(writer, "# HELP llmchat_requests_in_flight Requests submitted to the backends and not finished\n"
+        "# TYPE llmchat_requests_in_flight gauge\nllmchat_requests_in_flight {}\n", LLMChatEngine::GetInFlight());
+
+    fmt::format_to(writer, "# HELP llmchat_queue_messages_total Messages by queue class and what became of them\n"
+        "# TYPE llmchat_queue_messages_total counter\n");
+    for (uint8 i = 0; i < LLM_PRIORITY_COUNT; ++i)
+    {
+        char const* name = LLMConfig::GetPriorityClassName(LLMChatPriority(i));
+        LLMPriorityClassStats const& stats = LLMChatQueue::GetClassStats(LLMChatPriority(i));
+        std::pair<char const*, uint64> const outcomes[] =
+        {
+            { "enqueued", stats.enqueued.load() }, { "dispatched", stats.dispatched.load() },
+            { "dropped", stats.dropped.load() }, { "expired", stats.expired.load() }, { "shed", stats.shed.load() },
+            { "preempted", stats.preempted.load() }, { "superseded", stats.superseded.load() },
+            { "cancelled", stats.cancelled.load() }, { "abandoned", stats.abandoned.load() },
+            { "timed_out", stats.timedOut.load() }
+        };
+        for (auto const& [outcome, value] : outcomes)
+            fmt::format_to(writer, "llmchat_queue_messages_total{{class=\"{}\",outcome=\"{}\"}} {}\n", name, outcome, value);
+    }
+
+    for (uint32 i = 0; i < LLM_COUNTER_COUNT; ++i)
+    {
+        LLMCounterInfo const& counter = COUNTERS[i];
+        if (counter.help)
+            fmt::format_to(writer, "# HELP {0} {1}\n# TYPE {0} counter\n", counter.family, counter.help);
+        if (*counter.labels)
+            fmt::format_to(writer, "{}{{{}}} {}\n", counter.family, counter.labels, snapshot.counters[i]);
+        else
+            fmt::format_to(writer, "{} {}\n", counter.family, snapshot.counters[i]);
+    }
+
+    for (uint32 i = 0; i < LLM_HISTOGRAM_COUNT; ++i)
+    {
+        LLMHistogramInfo const& info = HISTOGRAMS[i];
+        LLMHistogramSnapshot const& histogram = snapshot.histograms[i];
+        fmt::format_to(writer, "# HELP {0} {1}\n# TYPE {0} histogram\n", info.family, info.help);
+        for (double bound : EXPORT_BOUNDS)
+            fmt::format_to(writer, "{}_bucket{{le=\"{}\"}} {}\n", info.family, bound,
+                histogram.CountUpTo(uint64(bound * 1000000.0 + 0.5)));
+        fmt::format_to(writer, "{0}_bucket{{le=\"+Inf\"}} {1}\n{0}_sum {2}\n{0}_count {1}\n", info.family, histogram.count,
+            double(histogram.sum) / 1000000.0);
+    }
+}
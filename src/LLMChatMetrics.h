@@ -0,0 +1,95 @@
+#ifndef MOD_LLM_CHAT_METRICS_H
+#define MOD_LLM_CHAT_METRICS_H
+
+#include "Define.h"
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+enum LLMCounter : uint8
+{
+    LLM_COUNTER_REPLIES,            // Replies handed over for delivery, generated or cached
+    LLM_COUNTER_CACHE_HITS,         // Answered from the response cache
+    LLM_COUNTER_SIMILARITY_HITS,    // Answered from the similarity cache
+    LLM_COUNTER_FALLBACKS,          // Canned replies sent in place of a generated one
+    LLM_COUNTER_ERROR_TRANSPORT,    // No response: connect, TLS, read or write failed
+    LLM_COUNTER_ERROR_BREAKER,      // Not sent, the backend's circuit breaker was open
+    LLM_COUNTER_ERROR_NO_BACKEND,   // Every backend ejected
+    LLM_COUNTER_ERROR_TIMEOUT,      // Ran past the message deadline
+    LLM_COUNTER_ERROR_HTTP,         // Status other than 200
+    LLM_COUNTER_ERROR_API,          // The backend reported an error
+    LLM_COUNTER_ERROR_PARSE,        // Response not understood, or a group reply that would not split
+    LLM_COUNTER_ERROR_EMPTY,        // Nothing generated
+    LLM_COUNTER_ERROR_EXCEPTION,    // Unexpected exception while preparing a request
+    LLM_COUNTER_COUNT
+};
+
+enum LLMHistogram : uint8
+{
+    LLM_HISTOGRAM_QUEUE_WAIT,       // Enqueued to dispatched
+    LLM_HISTOGRAM_CONNECT,          // DNS, connect and TLS handshake of a new connection
+    LLM_HISTOGRAM_FIRST_TOKEN,      // Request created to first generated text, streamed replies
+    LLM_HISTOGRAM_GENERATION,       // Request submitted to the complete reply
+    LLM_HISTOGRAM_DELIVERY,         // Reply ready to said in game, typing delay and pacing included
+    LLM_HISTOGRAM_COUNT
+};
+
+// Log-linear buckets in the manner of HdrHistogram: values up to 15 microseconds have a
+// bucket each, and every power of two above is split into 16, so a bucket is never wider
+// than 1/16 of the values in it. Values from 2^32 us (71 minutes) on share the last bucket.
+static constexpr uint32 LLM_HISTOGRAM_SUB_BUCKET_BITS = 4;
+static constexpr uint32 LLM_HISTOGRAM_SUB_BUCKETS = 1 << LLM_HISTOGRAM_SUB_BUCKET_BITS;
+static constexpr uint32 LLM_HISTOGRAM_MAX_BITS = 32;
+static constexpr uint32 LLM_HISTOGRAM_BUCKETS =
+    (LLM_HISTOGRAM_MAX_BITS - LLM_HISTOGRAM_SUB_BUCKET_BITS + 1) * LLM_HISTOGRAM_SUB_BUCKETS;
+
+struct LLMHistogramSnapshot
+{
+    std::array<uint64, LLM_HISTOGRAM_BUCKETS> buckets{};
+    uint64 count = 0;
+    uint64 sum = 0;     // Microseconds
+    uint64 max = 0;
+
+    // Upper bound of the bucket holding the value at `fraction` (0.5 for the median), capped
+    // at the largest value recorded
+    uint64 Percentile(double fraction) const;
+    // Values up to `limit`, counting every bucket that ends at or below it
+    uint64 CountUpTo(uint64 limit) const;
+
+    static uint32 BucketOf(uint64 micros);
+    static uint64 BucketUpperBound(uint32 bucket);
+};
+
+struct LLMMetricsSnapshot
+{
+    std::array<uint64, LLM_COUNTER_COUNT> counters{};
+    std::array<LLMHistogramSnapshot, LLM_HISTOGRAM_COUNT> histograms;
+};
+
+// Counters and latency histograms kept in per-thread shards: recording is a relaxed add to a
+// cache line no other thread writes to, and only reading the numbers sums the shards up. Read
+// by the .llmchat stats command and written out for Prometheus every LLMChat.Metrics.Interval.
+class LLMChatMetrics
+{
+public:
+    static void Initialize();
+
+    static void Add(LLMCounter counter, uint64 amount = 1);
+    static void Record(LLMHistogram histogram, std::chrono::steady_clock::duration value);
+
+    static void Collect(LLMMetricsSnapshot& snapshot);
+
+    // Queue worker: rewrites the Prometheus file once it is due
+    static void Update();
+
+    // Lines for the GM command
+    static void FormatSummary(std::vector<std::string>& lines);
+    // Prometheus text exposition format
+    static void FormatPrometheus(std::string& out);
+
+private:
+    static void WriteFile(std::string const& path);
+};
+
+#endif // MOD_LLM_CHAT_METRICS_H
@@ -0,0 +1,172 @@
+#include "LLMChatPresence.h"
+#include "mod-llm-chat-config.h"
+#include "Player.h"
+#include "Group.h"
+#include "ObjectAccessor.h"
+#include "Log.h"
+
+// Static member initialization
+std::unordered_map<uint64, LLMChatPresence::Sample> LLMChatPresence::s_samples;
+std::mutex LLMChatPresence::s_mutex;
+std::chrono::steady_clock::time_point LLMChatPresence::s_nextRefresh;
+std::function<void(uint64)> LLMChatPresence::s_offlineListener;
+std::array<std::atomic<uint64>, LLM_PRESENCE_COUNT> LLMChatPresence::s_results{};
+
+void LLMChatPresence::Initialize()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_nextRefresh = std::chrono::steady_clock::now();
+    s_samples.clear();
+}
+
+void LLMChatPresence::Shutdown()
+{
+    ReportStats();
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_samples.clear();
+}
+
+void LLMChatPresence::Record(Player* player, Sample& sample)
+{
+    sample.online = player && player->IsInWorld();
+    if (!sample.online)
+        return;
+
+    sample.mapId = player->GetMapId();
+    sample.instanceId = player->GetInstanceId();
+    sample.x = player->GetPositionX();
+    sample.y = player->GetPositionY();
+    sample.z = player->GetPositionZ();
+    Group* group = player->GetGroup();
+    sample.groupGuid = group ? group->GetGUID().GetRawValue() : 0;
+}
+
+void LLMChatPresence::Watch(Player* player)
+{
+    if (!player)
+        return;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    Sample& sample = s_samples[player->GetGUID().GetRawValue()];
+    ++sample.references;
+    Record(player, sample);
+}
+
+void LLMChatPresence::Unwatch(uint64 guid)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto itr = s_samples.find(guid);
+    if (itr != s_samples.end() && !--itr->second.references)
+        s_samples.erase(itr);
+}
+
+void LLMChatPresence::Update()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now < s_nextRefresh)
+        return;
+    s_nextRefresh = now + sLLMConfig->Presence.RefreshInterval;
+
+    std::vector<uint64> wentOffline;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (auto& [guid, sample] : s_samples)
+        {
+            bool wasOnline = sample.online;
+            Record(ObjectAccessor::FindPlayer(ObjectGuid(guid)), sample);
+            if (wasOnline && !sample.online)
+                wentOffline.push_back(guid);
+        }
+    }
+
+    // Outside the lock: the listener cancels requests, which may release snapshots and Unwatch
+    if (s_offlineListener)
+    {
+        for (uint64 guid : wentOffline)
+            s_offlineListener(guid);
+    }
+}
+
+LLMPresenceResult LLMChatPresence::Check(uint64 senderGuid, uint64 responderGuid, uint32 chatMsg)
+{
+    LLMPresenceResult result = LLM_PRESENCE_OK;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto sender = s_samples.find(senderGuid);
+        auto responder = s_samples.find(responderGuid);
+
+        // Players nobody watches were never sampled; there is nothing to hold against them
+        if (sender == s_samples.end() || responder == s_samples.end())
+            return LLM_PRESENCE_OK;
+
+        Sample const& from = sender->second;
+        Sample const& to = responder->second;
+
+        if (!from.online || !to.online)
+            result = LLM_PRESENCE_OFFLINE;
+        else
+        {
+            switch (chatMsg)
+            {
+                case CHAT_MSG_SAY:
+                case CHAT_MSG_EMOTE:
+                case CHAT_MSG_TEXT_EMOTE:
+                case CHAT_MSG_YELL:
+                {
+                    // Same reach the responders were picked with in LLMChatEvents
+                    float range = sLLMConfig->Chat.ChatRange * (chatMsg == CHAT_MSG_YELL ? 2.0f : 1.0f);
+                    float dx = from.x - to.x, dy = from.y - to.y, dz = from.z - to.z;
+                    if (from.mapId != to.mapId || from.instanceId != to.instanceId ||
+                        dx * dx + dy * dy + dz * dz > range * range)
+                        result = LLM_PRESENCE_OUT_OF_RANGE;
+                    break;
+                }
+                case CHAT_MSG_PARTY:
+                case CHAT_MSG_PARTY_LEADER:
+                case CHAT_MSG_RAID:
+                case CHAT_MSG_RAID_LEADER:
+                case CHAT_MSG_RAID_WARNING:
+                case CHAT_MSG_BATTLEGROUND:
+                case CHAT_MSG_BATTLEGROUND_LEADER:
+                    if (!from.groupGuid || from.groupGuid != to.groupGuid)
+                        result = LLM_PRESENCE_LEFT_GROUP;
+                    break;
+                default:
+                    // Whispers, guild and channels only need both players online
+                    break;
+            }
+        }
+    }
+
+    ++s_results[result];
+    return result;
+}
+
+char const* LLMChatPresence::GetResultName(LLMPresenceResult result)
+{
+    switch (result)
+    {
+        case LLM_PRESENCE_OK:           return "present";
+        case LLM_PRESENCE_OFFLINE:      return "offline";
+        case LLM_PRESENCE_OUT_OF_RANGE: return "out of range";
+        case LLM_PRESENCE_LEFT_GROUP:   return "left group";
+        default:                        return "unknown";
+    }
+}
+
+void LLMChatPresence::ReportStats()
+{
+    size_t watched;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        watched = s_samples.size();
+    }
+
+    LOG_INFO("module", "[LLMChat] Presence checks: {} {}, {} {}, {} {}, {} {} - {} players watched",
+        s_results[LLM_PRESENCE_OK].load(), GetResultName(LLM_PRESENCE_OK),
+        s_results[LLM_PRESENCE_OFFLINE].load(), GetResultName(LLM_PRESENCE_OFFLINE),
+        s_results[LLM_PRESENCE_OUT_OF_RANGE].load(), GetResultName(LLM_PRESENCE_OUT_OF_RANGE),
+        s_results[LLM_PRESENCE_LEFT_GROUP].load(), GetResultName(LLM_PRESENCE_LEFT_GROUP),
+        watched);
+}
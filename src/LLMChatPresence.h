@@ -0,0 +1,72 @@
+#ifndef MOD_LLM_CHAT_PRESENCE_H
+#define MOD_LLM_CHAT_PRESENCE_H
+
+#include "Define.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class Player;
+
+enum LLMPresenceResult : uint8
+{
+    LLM_PRESENCE_OK           = 0,
+    LLM_PRESENCE_OFFLINE      = 1,  // Sender or responder logged out or left the world
+    LLM_PRESENCE_OUT_OF_RANGE = 2,  // No longer close enough to hear a say, yell or emote
+    LLM_PRESENCE_LEFT_GROUP   = 3,  // No longer in the same party or raid
+    LLM_PRESENCE_COUNT
+};
+
+// Where the players of queued messages are, sampled on the world thread so the queue
+// worker can tell whether a reply still makes sense without touching a Player.
+// Only players referenced by a queued or generating message are watched.
+class LLMChatPresence
+{
+public:
+    static void Initialize();
+    static void Shutdown();
+
+    // Map thread: starts (or keeps) sampling a player and records where they are now
+    static void Watch(Player* player);
+    // Any thread: drops one reference taken by Watch
+    static void Unwatch(uint64 guid);
+
+    // World thread: resamples the watched players at most once per refresh interval
+    static void Update();
+    // Called on the world thread with each watched player found gone by Update
+    static void SetOfflineListener(std::function<void(uint64)> listener) { s_offlineListener = std::move(listener); }
+
+    // Any thread: whether the responder can still answer the sender in a chat of type `chatMsg`
+    static LLMPresenceResult Check(uint64 senderGuid, uint64 responderGuid, uint32 chatMsg);
+
+    static char const* GetResultName(LLMPresenceResult result);
+    static void ReportStats();
+
+private:
+    struct Sample
+    {
+        uint32 references = 0;
+        bool online = false;
+        uint32 mapId = 0;
+        uint32 instanceId = 0;
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        uint64 groupGuid = 0;
+    };
+
+    static void Record(Player* player, Sample& sample);
+
+    static std::unordered_map<uint64, Sample> s_samples;
+    static std::mutex s_mutex;
+    static std::chrono::steady_clock::time_point s_nextRefresh;
+    static std::function<void(uint64)> s_offlineListener;
+
+    static std::array<std::atomic<uint64>, LLM_PRESENCE_COUNT> s_results;
+};
+
+#endif // MOD_LLM_CHAT_PRESENCE_H
@@ -0,0 +1,404 @@
+#include "LLMChatPromptTemplate.h"
+#include "LLMChatCharacter.h"
+#include "mod-llm-chat-config.h"
+#include "Log.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+// Field ids: the message-wide fields, then each character attribute under the bot or the
+// sender scope
+enum LLMPromptField : uint8
+{
+    FIELD_MESSAGE,
+    FIELD_CHAT_TYPE,
+    FIELD_BOTS,
+
+    FIELD_SCOPE_BOT     = 0x10,
+    FIELD_SCOPE_SENDER  = 0x20,
+    FIELD_TRIM          = 0x40,     // | level: {{#trim.N}} sections
+    FIELD_ATTRIBUTE     = 0x0F
+};
+
+static constexpr uint8 MAX_TRIM_LEVEL = 9;
+
+enum LLMPromptAttribute : uint8
+{
+    ATTR_NAME,
+    ATTR_LEVEL,
+    ATTR_RACE,
+    ATTR_CLASS,
+    ATTR_FACTION,
+    ATTR_GUILD,
+    ATTR_LOCATION,
+    ATTR_IN_COMBAT,
+    ATTR_HEALTH,
+    ATTR_TARGET,
+    ATTR_COUNT
+};
+
+static constexpr std::array<std::string_view, ATTR_COUNT> ATTRIBUTE_NAMES =
+{
+    "name", "level", "race", "class", "faction", "guild", "location", "in_combat", "health", "target"
+};
+
+// The defaults reproduce the prompts the module always sent. The chat rules open every
+// prompt byte for byte the same, so the backend only evaluates them once and reuses the
+// cached prefix from then on; keep anything that varies per message out of them.
+// Over the token budget the details go first (trim.1), then the reminder paragraph
+// (trim.2), then the advice on giving directions (trim.3).
+static constexpr std::array<std::string_view, LLM_PROMPT_COUNT> DEFAULT_TEMPLATES =
+{
+    // LLM_PROMPT_CHAT_SYSTEM
+    "You are a WoW player chatting in game as the character described below. "
+    "Respond to the message you are given matching its tone and attitude - if they're friendly, be friendly back. "
+    "If they're rude or hostile, you can be snarky, defensive, or even toxic back. If they're joking, joke back. "
+    "Show faction pride when appropriate - defend your faction if they insult it, mock the opposite faction if they deserve it. "
+    "Consider level differences in your response - be more respectful to higher levels, maybe cocky to lower levels. "
+    "{{#trim.3}}If they ask about locations or directions, give accurate guidance based on both your current location and theirs. "
+    "For questions about where things are, provide specific directions relative to known landmarks, flight paths, or major cities. {{/trim.3}}"
+    "Don't hold back or filter your responses - be authentic to how real WoW players would actually respond. "
+    "Keep responses short and natural.{{#trim.2}}\n\n"
+    "Important: Match the tone and intensity of the message you received. Write exactly like a real player would - "
+    "be raw and unfiltered, using common WoW chat style and slang. Don't worry about being polite or politically correct. "
+    "Remember your faction loyalty - Alliance vs Horde rivalry is a core part of WoW culture. "
+    "When giving directions or location info, be specific and accurate to WoW geography. "
+    "You can mix in light roleplay elements if it fits, but focus on sounding like a real player in their natural habitat.{{/trim.2}}"
+    "\n\nYou are playing {{bot.name}} - a level {{bot.level}} {{bot.race}} {{bot.class}} of the {{bot.faction}} faction."
+    "{{#bot.guild}} Member of <{{bot.guild}}>.{{/bot.guild}}",
+
+    // LLM_PROMPT_CHAT_USER
+    "You're currently in {{bot.location}}"
+    "{{#bot.in_combat}}, in combat ({{bot.health}}% health){{/bot.in_combat}}"
+    "{{#trim.1}}{{#bot.target}}, targeting {{bot.target}}{{/bot.target}}{{/trim.1}}.\n"
+    "You're responding to {{sender.name}} - a level {{sender.level}} {{sender.race}} {{sender.class}} "
+    "of the {{sender.faction}} faction who is currently in {{sender.location}}"
+    "{{#trim.1}}{{#sender.guild}}\nMember of <{{sender.guild}}>{{/sender.guild}}{{/trim.1}}.\n"
+    "Here's the message: {{message}}",
+
+    // LLM_PROMPT_GROUP_SYSTEM
+    "You are writing chat replies for several WoW players who all just read the same chat message.\n"
+    "Write one short reply for each player, each in that player's own voice and from their own race, class, "
+    "level and faction point of view. Replies should not repeat each other; later speakers may react to earlier ones. "
+    "Match the tone and attitude of the message - friendly back to friendly, snarky or toxic back to rude. "
+    "Write exactly like real players would - raw and unfiltered, using common WoW chat style and slang. "
+    "Keep every reply short and natural.\n"
+    "Answer with JSON only, in exactly this form: "
+    "{\"replies\":[{\"speaker\":\"<player name>\",\"text\":\"<reply>\"}]}",
+
+    // LLM_PROMPT_GROUP_USER
+    "The {{chat_type}} chat message is from {{sender.name}} - a level {{sender.level}} {{sender.race}} "
+    "{{sender.class}} of the {{sender.faction}} faction who is currently in {{sender.location}}"
+    "{{#trim.1}}{{#sender.guild}}\nMember of <{{sender.guild}}>{{/sender.guild}}{{/trim.1}}.\n"
+    "The players replying are:\n"
+    "{{#bots}}- {{bot.name}}: a level {{bot.level}} {{bot.race}} {{bot.class}} of the {{bot.faction}} faction, "
+    "currently in {{bot.location}}{{#trim.1}}{{#bot.guild}}, member of <{{bot.guild}}>{{/bot.guild}}{{/trim.1}}"
+    "{{#bot.in_combat}}, in combat ({{bot.health}}% health){{/bot.in_combat}}\n{{/bots}}"
+    "Here's the message: {{message}}"
+};
+
+static bool ParseField(std::string_view name, uint8& field)
+{
+    if (name.size() == 6 && name.starts_with("trim.") && name[5] >= '1' && name[5] <= '0' + MAX_TRIM_LEVEL)
+        field = FIELD_TRIM | uint8(name[5] - '0');
+    else if (name == "message")
+        field = FIELD_MESSAGE;
+    else if (name == "chat_type")
+        field = FIELD_CHAT_TYPE;
+    else if (name == "bots")
+        field = FIELD_BOTS;
+    else
+    {
+        size_t dot = name.find('.');
+        if (dot == std::string_view::npos)
+            return false;
+
+        std::string_view scope = name.substr(0, dot);
+        if (scope != "bot" && scope != "sender")
+            return false;
+
+        auto attribute = std::find(ATTRIBUTE_NAMES.begin(), ATTRIBUTE_NAMES.end(), name.substr(dot + 1));
+        if (attribute == ATTRIBUTE_NAMES.end())
+            return false;
+
+        field = (scope == "bot" ? FIELD_SCOPE_BOT : FIELD_SCOPE_SENDER) | uint8(attribute - ATTRIBUTE_NAMES.begin());
+    }
+    return true;
+}
+
+static CharacterDetails const* GetCharacter(LLMPromptContext const& context, uint8 field)
+{
+    return (field & FIELD_SCOPE_BOT) ? context.bot : context.sender;
+}
+
+static bool IsSet(LLMPromptContext const& context, uint8 field)
+{
+    if (field & FIELD_TRIM)
+        return (field & FIELD_ATTRIBUTE) > context.trimLevel;
+    if (field == FIELD_MESSAGE)
+        return !context.message.empty();
+    if (field == FIELD_CHAT_TYPE)
+        return !context.chatType.empty();
+
+    CharacterDetails const* character = GetCharacter(context, field);
+    if (!character)
+        return false;
+
+    switch (field & FIELD_ATTRIBUTE)
+    {
+        case ATTR_NAME:      return !character->name.empty();
+        case ATTR_LEVEL:     return character->level != 0;
+        case ATTR_RACE:      return !character->raceName.empty();
+        case ATTR_CLASS:     return !character->className.empty();
+        case ATTR_FACTION:   return !character->faction.empty();
+        case ATTR_GUILD:     return !character->guildName.empty();
+        case ATTR_LOCATION:  return !character->location.empty();
+        case ATTR_IN_COMBAT: return character->isInCombat;
+        case ATTR_HEALTH:    return character->healthPct > 0.0f;
+        case ATTR_TARGET:    return !character->targetName.empty();
+        default:             return false;
+    }
+}
+
+static void AppendField(std::string& out, LLMPromptContext const& context, uint8 field)
+{
+    if (field == FIELD_MESSAGE)
+    {
+        out += context.message;
+        return;
+    }
+    if (field == FIELD_CHAT_TYPE)
+    {
+        out += context.chatType;
+        return;
+    }
+
+    CharacterDetails const* character = GetCharacter(context, field);
+    if (!character)
+        return;
+
+    switch (field & FIELD_ATTRIBUTE)
+    {
+        case ATTR_NAME:      out += character->name; break;
+        case ATTR_LEVEL:     fmt::format_to(std::back_inserter(out), "{}", character->level); break;
+        case ATTR_RACE:      out += character->raceName; break;
+        case ATTR_CLASS:     out += character->className; break;
+        case ATTR_FACTION:   out += character->faction; break;
+        case ATTR_GUILD:     out += character->guildName; break;
+        case ATTR_LOCATION:  out += character->location; break;
+        case ATTR_IN_COMBAT: out += character->isInCombat ? "true" : "false"; break;
+        case ATTR_HEALTH:    fmt::format_to(std::back_inserter(out), "{}", character->healthPct); break;
+        case ATTR_TARGET:    out += character->targetName; break;
+        default:             break;
+    }
+}
+
+bool LLMPromptTemplate::Compile(std::string_view text, std::string& error)
+{
+    std::vector<Instruction> program;
+    std::string literals;
+    // Open sections: instruction index and the tag name that closes it
+    std::vector<std::pair<size_t, std::string_view>> open;
+    bool inLoop = false;
+    uint8 maxTrimLevel = 0;
+
+    auto addLiteral = [&](std::string_view literal)
+    {
+        if (literal.empty())
+            return;
+        program.push_back({ OP_LITERAL, 0, uint32(literals.size()), uint32(literal.size()) });
+        literals += literal;
+    };
+
+    size_t position = 0;
+    while (position < text.size())
+    {
+        size_t tagStart = text.find("{{", position);
+        if (tagStart == std::string_view::npos)
+        {
+            addLiteral(text.substr(position));
+            break;
+        }
+
+        size_t tagEnd = text.find("}}", tagStart + 2);
+        if (tagEnd == std::string_view::npos)
+        {
+            error = fmt::format("unterminated tag at offset {}", tagStart);
+            return false;
+        }
+
+        addLiteral(text.substr(position, tagStart - position));
+        position = tagEnd + 2;
+
+        std::string_view tag = text.substr(tagStart + 2, tagEnd - tagStart - 2);
+        char kind = !tag.empty() && (tag.front() == '#' || tag.front() == '/') ? tag.front() : 0;
+        std::string_view name = kind ? tag.substr(1) : tag;
+
+        uint8 field = 0;
+        if (!ParseField(name, field))
+        {
+            error = fmt::format("unknown field '{}'", name);
+            return false;
+        }
+
+        if (kind == '#')
+        {
+            if (field == FIELD_BOTS && inLoop)
+            {
+                error = "{{#bots}} cannot be nested";
+                return false;
+            }
+            inLoop |= field == FIELD_BOTS;
+            if (field & FIELD_TRIM)
+                maxTrimLevel = std::max<uint8>(maxTrimLevel, field & FIELD_ATTRIBUTE);
+            open.emplace_back(program.size(), name);
+            program.push_back({ field == FIELD_BOTS ? OP_LOOP : OP_SECTION, field, 0, 0 });
+        }
+        else if (kind == '/')
+        {
+            if (open.empty() || open.back().second != name)
+            {
+                error = fmt::format("unexpected {{{{/{}}}}}", name);
+                return false;
+            }
+            program[open.back().first].length = uint32(program.size());
+            inLoop &= field != FIELD_BOTS;
+            open.pop_back();
+            program.push_back({ OP_END, field, 0, 0 });
+        }
+        else if (field == FIELD_BOTS)
+        {
+            error = "{{bots}} is a list; use {{#bots}}...{{/bots}}";
+            return false;
+        }
+        else if (field & FIELD_TRIM)
+        {
+            error = fmt::format("{{{{{}}}}} only opens a section; use {{{{#{}}}}}...{{{{/{}}}}}", name, name, name);
+            return false;
+        }
+        else
+            program.push_back({ OP_FIELD, field, 0, 0 });
+    }
+
+    if (!open.empty())
+    {
+        error = fmt::format("{{{{#{}}}}} is never closed", open.back().second);
+        return false;
+    }
+
+    m_program = std::move(program);
+    m_literals = std::move(literals);
+    m_maxTrimLevel = maxTrimLevel;
+    return true;
+}
+
+void LLMPromptTemplate::RenderRange(std::string& out, LLMPromptContext const& context, size_t begin, size_t end) const
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        Instruction const& instruction = m_program[i];
+        switch (instruction.op)
+        {
+            case OP_LITERAL:
+                out.append(m_literals, instruction.offset, instruction.length);
+                break;
+            case OP_FIELD:
+                AppendField(out, context, instruction.field);
+                break;
+            case OP_SECTION:
+                if (IsSet(context, instruction.field))
+                    RenderRange(out, context, i + 1, instruction.length);
+                i = instruction.length;
+                break;
+            case OP_LOOP:
+            {
+                LLMPromptContext each = context;
+                for (CharacterDetails const* bot : context.bots)
+                {
+                    each.bot = bot;
+                    RenderRange(out, each, i + 1, instruction.length);
+                }
+                i = instruction.length;
+                break;
+            }
+            case OP_END:
+                break;
+        }
+    }
+}
+
+void LLMPromptTemplate::RenderTo(std::string& out, LLMPromptContext const& context) const
+{
+    RenderRange(out, context, 0, m_program.size());
+}
+
+std::string LLMPromptTemplate::Render(LLMPromptContext const& context) const
+{
+    // Grows to the longest prompt once and is reused from then on
+    thread_local std::string t_buffer;
+    t_buffer.clear();
+    RenderTo(t_buffer, context);
+    return std::string(t_buffer);
+}
+
+char const* LLMPromptTemplates::GetFileName(LLMPromptTemplateId id)
+{
+    switch (id)
+    {
+        case LLM_PROMPT_CHAT_SYSTEM:  return "chat-system.txt";
+        case LLM_PROMPT_CHAT_USER:    return "chat-user.txt";
+        case LLM_PROMPT_GROUP_SYSTEM: return "group-system.txt";
+        case LLM_PROMPT_GROUP_USER:   return "group-user.txt";
+        default:                      return "";
+    }
+}
+
+std::shared_ptr<LLMPromptTemplates const> LLMPromptTemplates::Load(std::string const& directory)
+{
+    auto templates = std::make_shared<LLMPromptTemplates>();
+    for (uint32 i = 0; i < LLM_PROMPT_COUNT; ++i)
+    {
+        LLMPromptTemplateId id = LLMPromptTemplateId(i);
+        std::string error;
+        if (!templates->m_templates[i].Compile(DEFAULT_TEMPLATES[i], error))
+            LOG_ERROR("module", "[LLMChat] Built-in prompt template {}: {}", GetFileName(id), error);
+
+        if (directory.empty())
+            continue;
+
+        std::filesystem::path path = std::filesystem::path(directory) / GetFileName(id);
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            LOG_DEBUG("module", "[LLMChat] No {}, using the built-in prompt template", path.string());
+            continue;
+        }
+
+        std::stringstream contents;
+        contents << file.rdbuf();
+        std::string text = contents.str();
+        // Editors end files with a newline that is not part of the prompt
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+            text.pop_back();
+
+        if (templates->m_templates[i].Compile(text, error))
+            LOG_INFO("module", "[LLMChat] Prompt template loaded from {}", path.string());
+        else
+            LOG_ERROR("module", "[LLMChat] Prompt template {}: {}; keeping the built-in one", path.string(), error);
+    }
+    return templates;
+}
+
+std::shared_ptr<LLMPromptTemplates const> LLMPromptTemplates::Current()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (config->Prompts)
+        return config->Prompts;
+
+    // Before the first config load
+    static std::shared_ptr<LLMPromptTemplates const> const builtin = Load("");
+    return builtin;
+}
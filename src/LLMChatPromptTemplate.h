@@ -0,0 +1,99 @@
+#ifndef MOD_LLM_CHAT_PROMPT_TEMPLATE_H
+#define MOD_LLM_CHAT_PROMPT_TEMPLATE_H
+
+#include "Define.h"
+#include <array>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct CharacterDetails;
+
+enum LLMPromptTemplateId
+{
+    LLM_PROMPT_CHAT_SYSTEM,     // One bot replying: rules and the bot's persona
+    LLM_PROMPT_CHAT_USER,       // One bot replying: the situation and the message
+    LLM_PROMPT_GROUP_SYSTEM,    // Several bots in one generation: rules and answer format
+    LLM_PROMPT_GROUP_USER,      // Several bots in one generation: the speakers and the message
+    LLM_PROMPT_COUNT
+};
+
+// What a template can refer to. `bot` is the replying bot; inside a {{#bots}} section it is
+// each of the replying bots in turn.
+struct LLMPromptContext
+{
+    CharacterDetails const* bot = nullptr;
+    CharacterDetails const* sender = nullptr;
+    std::span<CharacterDetails const* const> bots;
+    std::string_view message;
+    std::string_view chatType;
+    uint8 trimLevel = 0;    // {{#trim.N}} sections with N up to this are left out
+};
+
+// A prompt template compiled once into literal text and typed placeholders, so rendering is
+// a walk over a short instruction list appending into one buffer.
+//
+// Syntax: {{sender.name}} inserts a field; {{#bot.guild}}...{{/bot.guild}} keeps its content
+// only when the field is set (non-empty text, non-zero number, true flag);
+// {{#bots}}...{{/bots}} repeats its content for every replying bot; {{#trim.N}}...{{/trim.N}}
+// (N from 1 to 9) marks content that can go when the prompt is over its token budget, the
+// lowest N first.
+class LLMPromptTemplate
+{
+public:
+    // Replaces the template; on a syntax error it is left unchanged and `error` says why
+    bool Compile(std::string_view text, std::string& error);
+
+    // Renders into the calling thread's scratch buffer and returns a copy of exactly its size
+    std::string Render(LLMPromptContext const& context) const;
+    void RenderTo(std::string& out, LLMPromptContext const& context) const;
+
+    // Highest N of the template's {{#trim.N}} sections; 0 when nothing can be trimmed
+    uint8 GetMaxTrimLevel() const { return m_maxTrimLevel; }
+
+private:
+    enum Op : uint8
+    {
+        OP_LITERAL,     // Append m_literals[offset, offset + length)
+        OP_FIELD,       // Append the field's value
+        OP_SECTION,     // Run up to `end` only if the field is set
+        OP_LOOP,        // Run up to `end` once per replying bot
+        OP_END
+    };
+
+    struct Instruction
+    {
+        Op op;
+        uint8 field;
+        uint32 offset;
+        uint32 length;  // OP_LITERAL: text length; OP_SECTION / OP_LOOP: index of the matching OP_END
+    };
+
+    void RenderRange(std::string& out, LLMPromptContext const& context, size_t begin, size_t end) const;
+
+    std::vector<Instruction> m_program;
+    std::string m_literals;     // All literal text, back to back
+    uint8 m_maxTrimLevel = 0;
+};
+
+// The full set of prompt templates: built-in defaults, each replaceable by a file
+class LLMPromptTemplates
+{
+public:
+    // Compiles the defaults, then every <name>.txt found in `directory`; a file that does not
+    // compile is reported and its default kept
+    static std::shared_ptr<LLMPromptTemplates const> Load(std::string const& directory);
+    // The templates of the current config snapshot
+    static std::shared_ptr<LLMPromptTemplates const> Current();
+
+    LLMPromptTemplate const& Get(LLMPromptTemplateId id) const { return m_templates[id]; }
+
+    static char const* GetFileName(LLMPromptTemplateId id);
+
+private:
+    std::array<LLMPromptTemplate, LLM_PROMPT_COUNT> m_templates;
+};
+
+#endif // MOD_LLM_CHAT_PROMPT_TEMPLATE_H
@@ -2,56 +2,170 @@
 #include "LLMChatEvents.h"
 #include "LLMChatLogger.h"
 #include "LLMChatCharacter.h"
+#include "LLMChatBackends.h"
+#include "LLMChatCache.h"
+#include "LLMChatSimilarity.h"
+#include "LLMChatEngine.h"
+#include "LLMChatHedgePolicy.h"
+#include "LLMChatJson.h"
+#include "LLMChatMetrics.h"
+#include "LLMChatPresence.h"
+#include "LLMChatPromptTemplate.h"
+#include "LLMChatRateLimiter.h"
+#include "LLMChatStream.h"
+#include "LLMChatTokenizer.h"
+#include "LLMChatTrace.h"
 #include "Player.h"
 #include "ObjectAccessor.h"
 #include "Log.h"
 #include "mod-llm-chat.h"
 #include "ChannelMgr.h"
 #include "Channel.h"
-#include "Configuration/Config.h"
 #include <fmt/format.h>
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <stdexcept>
 
-// Boost Beast includes
-#include <boost/beast/core.hpp>
-#include <boost/beast/http.hpp>
-#include <boost/beast/version.hpp>
-#include <boost/asio/connect.hpp>
-#include <boost/asio/ip/tcp.hpp>
-#include <boost/asio/ssl/stream.hpp>
-#include <boost/asio/ssl.hpp>
-
-namespace beast = boost::beast;
-namespace http = beast::http;
-namespace net = boost::asio;
-namespace ssl = boost::asio::ssl;
-using tcp = net::ip::tcp;
+// Role markers and turn separators the backend's chat template wraps around the prompt
+static constexpr uint32 CHAT_TEMPLATE_TOKENS = 32;
+// JSON around each reply of a group generation, and around the whole answer
+static constexpr uint32 GROUP_REPLY_OVERHEAD_TOKENS = 16;
 
 // Static member initialization
-std::queue<QueuedResponse> LLMChatQueue::responses = std::queue<QueuedResponse>();
+std::vector<std::unique_ptr<LLMChatRing<QueuedResponse>>> LLMChatQueue::s_ingress;
+std::atomic<uint32> LLMChatQueue::s_nextShard{0};
+std::array<std::deque<QueuedResponse>, LLM_PRIORITY_COUNT> LLMChatQueue::responses;
+std::unique_ptr<LLMChatRing<LLMChatCompletion>> LLMChatQueue::s_completions;
+std::atomic<uint64> LLMChatQueue::s_completionsDropped{0};
+std::atomic<uint64> LLMChatQueue::s_nextRequestId{0};
+std::array<LLMPriorityClassStats, LLM_PRIORITY_COUNT> LLMChatQueue::s_classStats;
+std::array<std::unique_ptr<LLMChatHedgePolicy>, LLM_PRIORITY_COUNT> LLMChatQueue::s_hedging;
+uint32 LLMChatQueue::s_queuedTotal = 0;
+std::unordered_map<LLMConversationKey, LLMConversation, LLMConversationKeyHash> LLMChatQueue::s_conversations;
+std::mutex LLMChatQueue::s_conversationMutex;
+std::atomic<uint64> LLMChatQueue::s_nextSequence{0};
 std::mutex LLMChatQueue::m_mutex;
-bool LLMChatQueue::m_initialized = false;
-bool LLMChatQueue::m_running = false;
+std::condition_variable LLMChatQueue::m_wakeCondition;
+std::atomic<bool> LLMChatQueue::m_wakePending{false};
+std::atomic<bool> LLMChatQueue::m_initialized{false};
+std::atomic<bool> LLMChatQueue::m_running{false};
 LLMChatQueue* LLMChatQueue::s_instance = nullptr;
-std::queue<std::shared_ptr<LLMRequest>> LLMChatQueue::s_requestQueue;
-std::mutex LLMChatQueue::s_queueMutex;
 std::atomic<bool> LLMChatQueue::m_processingQueue{false};
 std::thread LLMChatQueue::m_workerThread;
 
+// A streamed generation in progress; only touched by the coroutine that reads its response
+struct LLMStreamState
+{
+    LLMStreamState(size_t maxLineLength, uint32 firstLineDelay) : splitter(maxLineLength), firstLineDelay(firstLineDelay) {}
+
+    LLMChatStreamDecoder decoder;
+    LLMChatSentenceSplitter splitter;
+    std::shared_ptr<LLMChatSnapshot const> snapshot;
+    LLMReplyCacheKeys cacheKeys;
+    uint32 promptTokens = 0;                            // Estimated
+    std::string text;                                   // Everything generated so far
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point nextLineAt;   // Earliest time the next paced line may be shown
+    uint32 firstLineDelay;                              // ms between the first line being complete and shown
+    uint32 linesDelivered = 0;
+};
+
+// A coalesced generation read as a stream: its JSON reply is only split once it is complete
+struct LLMGroupStreamState
+{
+    LLMChatStreamDecoder decoder;
+    std::string text;
+};
+
+// Counts a reply and records it in the chat transcript and the trace as it is handed over for delivery
+static void LogTranscript(LLMChatSnapshot const& snapshot, LLMResponderSnapshot const& responder, std::string_view reply,
+    char const* source)
+{
+    if (snapshot.trace)
+    {
+        snapshot.trace->SetOutcome(source);
+        snapshot.trace->AddReply(responder.details.name, reply);
+    }
+
+    LLMChatTranscript transcript;
+    transcript.request = snapshot.requestId;
+    transcript.sender = snapshot.sender.name;
+    transcript.bot = responder.details.name;
+    transcript.chatType = LLMChatQueue::GetChatTypeName(snapshot.chatType);
+    transcript.message = snapshot.message;
+    transcript.reply = reply;
+    transcript.source = source;
+    LLMChatLogger::LogTranscript(transcript);
+    LLMChatMetrics::Add(LLM_COUNTER_REPLIES);
+}
+
+// Ends the message's wait in the queue on its trace, with what became of it unless dispatched
+static void TraceQueueWait(QueuedResponse const& response, char const* outcome)
+{
+    LLMTrace* trace = response.snapshot->trace.get();
+    if (!trace)
+        return;
+
+    trace->AddSpan("queue", LLM_TRACE_MESSAGE, response.enqueueTime, std::chrono::steady_clock::now(),
+        outcome ? outcome : "");
+    if (outcome)
+        trace->SetOutcome(outcome);
+}
+
+LLMChatSnapshot::~LLMChatSnapshot()
+{
+    if (sequence)
+        LLMChatQueue::ForgetConversation(*this);
+
+    LLMChatPresence::Unwatch(senderGuid);
+    for (LLMResponderSnapshot const& responder : responders)
+        LLMChatPresence::Unwatch(responder.guid);
+}
+
 bool LLMChatQueue::Initialize()
 {
     if (m_initialized)
         return true;
 
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+
+    s_ingress.clear();
+    for (uint32 i = 0; i < config->Queue.Shards; ++i)
+        s_ingress.push_back(std::make_unique<LLMChatRing<QueuedResponse>>(config->Queue.ShardCapacity));
+
+    // Kept across restarts: engine threads may still be finishing requests of the previous run
+    if (!s_completions)
+        s_completions = std::make_unique<LLMChatRing<LLMChatCompletion>>(config->Queue.MailboxCapacity);
+
+    for (uint8 i = 0; i < LLM_PRIORITY_COUNT; ++i)
+    {
+        if (!s_hedging[i])
+            s_hedging[i] = std::make_unique<LLMChatHedgePolicy>(LLMConfig::GetPriorityClassName(LLMChatPriority(i)));
+        s_hedging[i]->Reset();
+    }
+
+    LLMChatRateLimiter::Initialize();
+    LLMChatPresence::Initialize();
+    LLMChatCache::Initialize();
+    LLMChatSimilarityCache::Initialize();
+    LLMChatMetrics::Initialize();
+
     s_instance = new LLMChatQueue();
     m_initialized = true;
     m_running = true;
-    
+
+    // A finished request frees an engine slot the worker may be waiting for
+    LLMChatEngine::SetCapacityListener(&LLMChatQueue::Wake);
+    LLMChatPresence::SetOfflineListener(&LLMChatQueue::CancelConversationsWith);
+
     // Start the worker thread - using a static function
     m_workerThread = std::thread([]() {
         s_instance->ProcessQueueWorker();
     });
-    
+
+    LOG_INFO("module", "[LLMChat] Queue started - {} ingress shards of {} entries", s_ingress.size(), s_ingress[0]->Capacity());
     return true;
 }
 
@@ -59,6 +173,7 @@ void LLMChatQueue::Shutdown()
 {
     m_running = false;
     m_initialized = false;
+    Wake();
 
     // Wait for worker thread to finish
     if (m_workerThread.joinable())
@@ -66,11 +181,29 @@ void LLMChatQueue::Shutdown()
         m_workerThread.join();
     }
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-    while (!responses.empty())
+    ReportClassStats();
+    LLMChatRateLimiter::Shutdown();
+    LLMChatPresence::Shutdown();
+    LLMChatCache::Shutdown();
+    LLMChatSimilarityCache::Shutdown();
+
+    // Rings stay allocated in case a late producer still holds a reference to one
+    for (auto& ring : s_ingress)
+        while (ring->TryPop())
+            ;
+
+    for (auto& queue : responses)
+        queue.clear();
+    s_queuedTotal = 0;
+
+    // Requests still in flight finish on their own; dropping them here may release snapshots,
+    // which take the lock again
+    std::unordered_map<LLMConversationKey, LLMConversation, LLMConversationKeyHash> conversations;
     {
-        responses.pop();
+        std::lock_guard<std::mutex> lock(s_conversationMutex);
+        conversations.swap(s_conversations);
     }
+    conversations.clear();
 
     if (s_instance)
     {
@@ -79,38 +212,94 @@ void LLMChatQueue::Shutdown()
     }
 }
 
-void LLMChatQueue::EnqueueResponse(Player* responder, std::string const& message, std::string const& chatType)
+void LLMChatQueue::EnqueueResponse(Player* sender, Player* responder, std::string const& message, uint32 chatMsg)
 {
-    if (!m_initialized || !m_running)
+    if (!sender || !responder || !responder->IsInWorld())
     {
-        LOG_ERROR("module", "[LLMChat] Cannot enqueue - system not initialized or not running");
+        LOG_ERROR("module", "[LLMChat] Cannot enqueue response - sender or responder is null or not in world");
         return;
     }
 
-    if (!responder || !responder->IsInWorld())
+    EnqueueGroupResponse(sender, { responder }, message, chatMsg);
+}
+
+void LLMChatQueue::EnqueueGroupResponse(Player* sender, std::vector<Player*> const& responders, std::string const& message,
+    uint32 chatMsg)
+{
+    if (!m_initialized || !m_running)
     {
-        LOG_ERROR("module", "[LLMChat] Cannot enqueue response - responder is null or not in world");
+        LOG_ERROR("module", "[LLMChat] Cannot enqueue - system not initialized or not running");
         return;
     }
 
-    try 
+    if (!sender || responders.empty())
+        return;
+
+    try
     {
-        LOG_INFO("module", "[LLMChat] Enqueueing new response...");
-        uint64 senderGuid = responder->GetGUID().GetRawValue();
-        uint64 responderGuid = responder->GetGUID().GetRawValue();
-        
-        QueuedResponse queuedResponse(
-            senderGuid,
-            responderGuid,
-            message,
-            chatType
-        );
-        
-        LOG_INFO("module", "[LLMChat] Adding response to queue with chat type: {}", chatType);
+        // Cooldowns and the per-message reply cap decide which bots answer at all
+        std::vector<uint64> guids;
+        guids.reserve(responders.size());
+        for (Player* responder : responders)
+            guids.push_back(responder->GetGUID().GetRawValue());
+
+        std::vector<bool> allowed = LLMChatRateLimiter::Admit(sender->GetGUID().GetRawValue(), guids);
+        std::vector<Player*> admitted;
+        for (size_t i = 0; i < responders.size(); ++i)
         {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            responses.push(queuedResponse);
-            LOG_INFO("module", "[LLMChat] Added to queue. Current size: {}", responses.size());
+            if (allowed[i])
+                admitted.push_back(responders[i]);
+        }
+
+        if (admitted.empty())
+        {
+            LOG_DEBUG("module", "[LLMChat] Message from {} rate limited for all {} responders", sender->GetName(), responders.size());
+            return;
+        }
+
+        CharacterDetails senderDetails = LLMChatCharacter::GetCharacterDetails(sender);
+        std::shared_ptr<LLMConfig const> config = sLLMConfig;
+        LLMChatType chatType = GetChatType(chatMsg);
+        LLMChatPriority priority = GetPriorityClass(chatType);
+        std::chrono::milliseconds classDeadline = config->Priority.Classes[priority].Deadline;
+        auto deadline = classDeadline.count()
+            ? std::chrono::steady_clock::now() + classDeadline
+            : std::chrono::steady_clock::time_point::max();
+
+        // One generation per bot, or per batch of up to MaxSpeakers bots when coalescing
+        size_t batchSize = config->Queue.Coalesce ? config->Queue.CoalesceMaxSpeakers : 1;
+        for (size_t start = 0; start < admitted.size(); start += batchSize)
+        {
+            size_t end = std::min(start + batchSize, admitted.size());
+
+            auto snapshot = std::make_shared<LLMChatSnapshot>();
+            snapshot->senderGuid = sender->GetGUID().GetRawValue();
+            snapshot->sender = senderDetails;
+            for (size_t i = start; i < end; ++i)
+                snapshot->responders.push_back(CaptureResponder(admitted[i], chatType));
+            snapshot->message = message;
+            snapshot->chatType = chatType;
+            snapshot->deadline = deadline;
+            snapshot->requestId = ++s_nextRequestId;
+            if (LLMChatTrace::IsEnabled())
+            {
+                std::string name = fmt::format("{}: {} to {}", GetChatTypeName(chatType), senderDetails.name,
+                    snapshot->responders.front().details.name);
+                if (end - start > 1)
+                    name += fmt::format(" and {} more", end - start - 1);
+                snapshot->trace = LLMChatTrace::Start(snapshot->requestId, std::move(name), message);
+            }
+            Supersede(*snapshot);
+
+            // Released again by the snapshot's destructor
+            LLMChatPresence::Watch(sender);
+            for (size_t i = start; i < end; ++i)
+                LLMChatPresence::Watch(admitted[i]);
+
+            if (end - start > 1)
+                LLMCHAT_LOG(LLM_LOG_DETAIL, "Request #{}: coalescing {} responders into one request", snapshot->requestId,
+                    end - start);
+            Push(QueuedResponse(std::move(snapshot), priority));
         }
     }
     catch (const std::exception& e)
@@ -119,391 +308,1146 @@ void LLMChatQueue::EnqueueResponse(Player* responder, std::string const& message
     }
 }
 
-void LLMChatQueue::ProcessQueueWorker()
+LLMResponderSnapshot LLMChatQueue::CaptureResponder(Player* responder, LLMChatType chatType)
 {
-    LOG_INFO("module", "[LLMChat] Queue worker thread started");
-    
-    while (m_running)
+    LLMResponderSnapshot snapshot;
+    snapshot.guid = responder->GetGUID().GetRawValue();
+    snapshot.details = LLMChatCharacter::GetCharacterDetails(responder);
+    snapshot.chatMsg = GetReplyChatMsg(chatType, responder);
+    return snapshot;
+}
+
+bool LLMChatQueue::Push(QueuedResponse&& response)
+{
+    // Each producing thread sticks to its own shard, so map update threads rarely contend
+    thread_local uint32 shard = s_nextShard.fetch_add(1, std::memory_order_relaxed);
+    LLMChatRing<QueuedResponse>& ring = *s_ingress[shard % s_ingress.size()];
+
+    std::string responderName = response.snapshot->responders.front().details.name;
+    if (!ring.TryPush(std::move(response)))
+    {
+        LOG_ERROR("module", "[LLMChat] Ingress shard {} is full ({} entries), dropping message for {}",
+            shard % s_ingress.size(), ring.Capacity(), responderName);
+        return false;
+    }
+
+    Wake();
+    return true;
+}
+
+void LLMChatQueue::Supersede(LLMChatSnapshot& snapshot)
+{
+    if (!sLLMConfig->Queue.Supersede)
+        return;
+
+    snapshot.sequence = ++s_nextSequence;
+
+    // Released outside the lock: dropping the old request may destroy the snapshot it captured
+    std::shared_ptr<LLMHttpRequest> previous;
     {
-        if (!m_initialized)
+        std::lock_guard<std::mutex> lock(s_conversationMutex);
+        LLMConversation& conversation = s_conversations[snapshot.GetConversationKey()];
+        conversation.sequence = snapshot.sequence;
+        previous = std::move(conversation.request);
+    }
+
+    // An older message still queued is dropped when it reaches dispatch; one already
+    // generating is cut off so the backend stops spending time on it
+    if (previous && !previous->cancelled)
+    {
+        ++s_classStats[GetPriorityClass(snapshot.chatType)].cancelled;
+        LOG_DEBUG("module", "[LLMChat] Newer message from {} to {}, aborting the reply in flight",
+            snapshot.sender.name, snapshot.responders.front().details.name);
+        LLMChatEngine::Cancel(previous);
+    }
+}
+
+bool LLMChatQueue::IsSuperseded(LLMChatSnapshot const& snapshot)
+{
+    if (!snapshot.sequence)
+        return false;
+
+    std::lock_guard<std::mutex> lock(s_conversationMutex);
+    auto itr = s_conversations.find(snapshot.GetConversationKey());
+    return itr == s_conversations.end() || itr->second.sequence != snapshot.sequence;
+}
+
+void LLMChatQueue::TrackRequest(LLMChatSnapshot const& snapshot, std::shared_ptr<LLMHttpRequest> const& request)
+{
+    if (!snapshot.sequence)
+        return;
+
+    bool superseded = false;
+    {
+        std::lock_guard<std::mutex> lock(s_conversationMutex);
+        auto itr = s_conversations.find(snapshot.GetConversationKey());
+        if (itr != s_conversations.end() && itr->second.sequence == snapshot.sequence)
+            itr->second.request = request;
+        else
+            superseded = true;
+    }
+
+    // A newer message arrived between dispatch and submission
+    if (superseded)
+    {
+        ++s_classStats[GetPriorityClass(snapshot.chatType)].cancelled;
+        LLMChatEngine::Cancel(request);
+    }
+}
+
+void LLMChatQueue::ForgetConversation(LLMChatSnapshot const& snapshot)
+{
+    std::shared_ptr<LLMHttpRequest> request;
+    {
+        std::lock_guard<std::mutex> lock(s_conversationMutex);
+        auto itr = s_conversations.find(snapshot.GetConversationKey());
+        if (itr == s_conversations.end() || itr->second.sequence != snapshot.sequence)
+            return;
+
+        request = std::move(itr->second.request);
+        s_conversations.erase(itr);
+    }
+}
+
+void LLMChatQueue::CancelConversationsWith(uint64 guid)
+{
+    std::vector<std::pair<std::shared_ptr<LLMHttpRequest>, LLMChatPriority>> requests;
+    {
+        std::lock_guard<std::mutex> lock(s_conversationMutex);
+        for (auto const& [key, conversation] : s_conversations)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if ((key.senderGuid == guid || key.responderGuid == guid) && conversation.request)
+                requests.emplace_back(conversation.request, GetPriorityClass(key.chatType));
+        }
+    }
+
+    for (auto const& [request, priority] : requests)
+    {
+        if (request->cancelled)
             continue;
+
+        ++s_classStats[priority].abandoned;
+        LLMChatEngine::Cancel(request);
+    }
+
+    if (!requests.empty())
+        LOG_DEBUG("module", "[LLMChat] Player {} went offline, aborted {} requests", guid, requests.size());
+}
+
+bool LLMChatQueue::IsAudiencePresent(LLMChatSnapshot const& snapshot)
+{
+    // A coalesced generation goes ahead while any of its bots can still answer
+    for (LLMResponderSnapshot const& responder : snapshot.responders)
+    {
+        if (LLMChatPresence::Check(snapshot.senderGuid, responder.guid, responder.chatMsg) == LLM_PRESENCE_OK)
+            return true;
+    }
+    return false;
+}
+
+void LLMChatQueue::Wake()
+{
+    // Only the first producer after the worker went idle pays for the lock and notify
+    if (!m_wakePending.exchange(true, std::memory_order_acq_rel))
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wakeCondition.notify_one();
+    }
+}
+
+void LLMChatQueue::WaitForWork()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wakeCondition.wait_for(lock, std::chrono::seconds(1), []() {
+        return m_wakePending.load(std::memory_order_acquire) || !m_running;
+    });
+}
+
+void LLMChatQueue::DrainIngress()
+{
+    for (auto& ring : s_ingress)
+    {
+        while (std::optional<QueuedResponse> response = ring->TryPop())
+            Admit(std::move(*response));
+    }
+}
+
+void LLMChatQueue::Admit(QueuedResponse&& response)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    LLMChatPriority priority = response.priority;
+    LLMPriorityClassStats& stats = s_classStats[priority];
+    ++stats.enqueued;
+
+    if (s_queuedTotal >= config->Priority.HighWaterMark)
+    {
+        // Past the high-water mark the low classes are refused outright, and
+        // higher classes make room by pre-empting queued low-class work
+        LLMChatPriority shedFrom = config->Priority.ShedFrom;
+        if (priority >= shedFrom || !Evict(shedFrom, priority))
+        {
+            ++stats.shed;
+            TraceQueueWait(response, "shed");
+            Shed(response);
+            return;
+        }
+    }
+
+    std::deque<QueuedResponse>& queue = responses[priority];
+    if (queue.size() >= config->Priority.Classes[priority].Capacity)
+    {
+        ++stats.dropped;
+        if (queue.empty())
+        {
+            TraceQueueWait(response, "dropped");
+            return;
         }
 
-        bool hasMessage = false;
-        QueuedResponse* response = nullptr;
+        // The newest message is the one a player is most likely still waiting on
+        TraceQueueWait(queue.front(), "dropped");
+        queue.pop_front();
+        --stats.queued;
+        --s_queuedTotal;
+    }
 
+    queue.push_back(std::move(response));
+    ++stats.queued;
+    ++s_queuedTotal;
+}
+
+bool LLMChatQueue::Evict(LLMChatPriority lowestAllowed, LLMChatPriority above)
+{
+    // Take the oldest message of the lowest-priority non-empty class
+    for (int i = LLM_PRIORITY_COUNT - 1; i >= int(lowestAllowed) && i > int(above); --i)
+    {
+        std::deque<QueuedResponse>& queue = responses[i];
+        if (queue.empty())
+            continue;
+
+        QueuedResponse victim = std::move(queue.front());
+        queue.pop_front();
+        --s_queuedTotal;
+        --s_classStats[i].queued;
+        ++s_classStats[i].preempted;
+        TraceQueueWait(victim, "preempted");
+        Shed(victim);
+        return true;
+    }
+    return false;
+}
+
+void LLMChatQueue::Shed(QueuedResponse const& response)
+{
+    if (sLLMConfig->Priority.ShedWithTemplate)
+        SendDefaultResponse(*response.snapshot);
+}
+
+void LLMChatQueue::DispatchPending()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    auto now = std::chrono::steady_clock::now();
+
+    for (uint8 i = 0; i < LLM_PRIORITY_COUNT && m_running; ++i)
+    {
+        std::deque<QueuedResponse>& queue = responses[i];
+        LLMPriorityClassStats& stats = s_classStats[i];
+
+        // Classes that get shed under load may not take the reserved engine slots
+        uint32 reserved = i >= config->Priority.ShedFrom ? config->Priority.ReservedSlots : 0;
+
+        while (!queue.empty())
         {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            if (!responses.empty())
+            if (now - queue.front().enqueueTime > config->Priority.Classes[i].MaxAge || now >= queue.front().snapshot->deadline)
             {
-                // Get a copy of the front response
-                response = new QueuedResponse(
-                    responses.front().senderGuid,
-                    responses.front().responderGuid,
-                    responses.front().message,
-                    responses.front().personality  // Store the chat type
-                );
-                responses.pop();
-                hasMessage = true;
+                TraceQueueWait(queue.front(), "expired");
+                queue.pop_front();
+                ++stats.expired;
+                --stats.queued;
+                --s_queuedTotal;
+                continue;
             }
-        }
 
-        if (hasMessage && response)
-        {
-            try
+            if (IsSuperseded(*queue.front().snapshot))
             {
-                LOG_INFO("module", "[LLMChat] Processing message from queue");
-                LOG_INFO("module", "[LLMChat] Chat type: {}", response->personality);
-                
-                Player* sender = ObjectAccessor::FindPlayer(ObjectGuid(response->senderGuid));
-                Player* responder = ObjectAccessor::FindPlayer(ObjectGuid(response->responderGuid));
-
-                if (!sender || !responder)
-                {
-                    LOG_ERROR("module", "[LLMChat] Invalid sender or responder - Sender valid: {}, Responder valid: {}", 
-                        sender != nullptr, responder != nullptr);
-                    delete response;
-                    continue;
-                }
-
-                LOG_INFO("module", "[LLMChat] Processing message for:");
-                LOG_INFO("module", "[LLMChat] - Sender: {}", sender->GetName());
-                LOG_INFO("module", "[LLMChat] - Responder: {}", responder->GetName());
-                LOG_INFO("module", "[LLMChat] - Message: {}", response->message);
-                LOG_INFO("module", "[LLMChat] - Chat Type: {}", response->personality);
-
-                // Pass the chat type to QueryLLM
-                QueryLLM(response->message, responder, sender, response->personality);
-                delete response;
+                TraceQueueWait(queue.front(), "superseded");
+                queue.pop_front();
+                ++stats.superseded;
+                --stats.queued;
+                --s_queuedTotal;
+                continue;
             }
-            catch (const std::exception& e)
+
+            if (!LLMChatEngine::HasCapacity(reserved))
+                break;
+
+            QueuedResponse response = std::move(queue.front());
+            queue.pop_front();
+            --stats.queued;
+            --s_queuedTotal;
+
+            // Nobody left to read the reply
+            if (!IsAudiencePresent(*response.snapshot))
             {
-                LOG_ERROR("module", "[LLMChat] Error processing queued message: {}", e.what());
-                delete response;
+                ++stats.abandoned;
+                TraceQueueWait(response, "abandoned");
+                LOG_DEBUG("module", "[LLMChat] Dropping message from {} - no responder can still answer it",
+                    response.snapshot->sender.name);
+                continue;
             }
+
+            ++stats.dispatched;
+            LLMChatMetrics::Record(LLM_HISTOGRAM_QUEUE_WAIT, now - response.enqueueTime);
+            TraceQueueWait(response, nullptr);
+            DispatchResponse(response);
         }
-        else
+
+        // A higher class that is still waiting keeps lower classes from being dispatched
+        if (!queue.empty())
+            break;
+    }
+}
+
+void LLMChatQueue::ProcessQueueWorker()
+{
+    LOG_INFO("module", "[LLMChat] Queue worker thread started");
+
+    auto nextReport = std::chrono::steady_clock::now() + sLLMConfig->Queue.ReportInterval;
+
+    while (m_running)
+    {
+        // Cleared before draining so a push racing with the drain still wakes us again
+        m_wakePending.store(false, std::memory_order_release);
+
+        DrainIngress();
+        DispatchPending();
+
+        std::chrono::seconds reportInterval = sLLMConfig->Queue.ReportInterval;
+        if (reportInterval.count() > 0 && std::chrono::steady_clock::now() >= nextReport)
         {
-            // Sleep for a short time if queue is empty to prevent CPU spinning
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            ReportClassStats();
+            nextReport = std::chrono::steady_clock::now() + reportInterval;
         }
+        LLMChatMetrics::Update();
+
+        WaitForWork();
     }
-    
+
     LOG_INFO("module", "[LLMChat] Queue worker thread stopped");
 }
 
-void LLMChatQueue::QueryLLM(std::string const& message, Player* responder, Player* sender, std::string const& chatType)
+void LLMChatQueue::ReportClassStats()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    for (uint8 i = 0; i < LLM_PRIORITY_COUNT; ++i)
+    {
+        LLMPriorityClassStats const& stats = s_classStats[i];
+        LOG_INFO("module", "[LLMChat] Queue class {}: {} queued, {} enqueued, {} dispatched, {} dropped, {} expired, {} shed, {} preempted, "
+            "{} superseded, {} cancelled, {} abandoned, {} timed out",
+            LLMConfig::GetPriorityClassName(LLMChatPriority(i)), stats.queued.load(), stats.enqueued.load(), stats.dispatched.load(),
+            stats.dropped.load(), stats.expired.load(), stats.shed.load(), stats.preempted.load(),
+            stats.superseded.load(), stats.cancelled.load(), stats.abandoned.load(), stats.timedOut.load());
+        if (config->Priority.Classes[i].Hedge)
+            s_hedging[i]->ReportStats();
+    }
+    if (uint64 dropped = s_completionsDropped.load())
+        LOG_INFO("module", "[LLMChat] Completion mailbox: {} replies dropped while full", dropped);
+    LLMChatEngine::ReportStats();
+    LLMChatRateLimiter::ReportStats();
+    LLMChatPresence::ReportStats();
+    LLMChatCache::ReportStats();
+    LLMChatSimilarityCache::ReportStats();
+    LLMChatTrace::ReportStats();
+}
+
+LLMChatType LLMChatQueue::GetChatType(uint32 chatMsg)
+{
+    switch (chatMsg)
+    {
+        case CHAT_MSG_SAY:                 return LLM_CHAT_SAY;
+        case CHAT_MSG_YELL:                return LLM_CHAT_YELL;
+        case CHAT_MSG_EMOTE:               return LLM_CHAT_EMOTE;
+        case CHAT_MSG_TEXT_EMOTE:          return LLM_CHAT_TEXT_EMOTE;
+        case CHAT_MSG_WHISPER:             return LLM_CHAT_WHISPER;
+        case CHAT_MSG_PARTY:               return LLM_CHAT_PARTY;
+        case CHAT_MSG_PARTY_LEADER:        return LLM_CHAT_PARTY_LEADER;
+        case CHAT_MSG_RAID:                return LLM_CHAT_RAID;
+        case CHAT_MSG_RAID_LEADER:         return LLM_CHAT_RAID_LEADER;
+        case CHAT_MSG_RAID_WARNING:        return LLM_CHAT_RAID_WARNING;
+        case CHAT_MSG_BATTLEGROUND:        return LLM_CHAT_BATTLEGROUND;
+        case CHAT_MSG_BATTLEGROUND_LEADER: return LLM_CHAT_BATTLEGROUND_LEADER;
+        case CHAT_MSG_GUILD:               return LLM_CHAT_GUILD;
+        case CHAT_MSG_OFFICER:             return LLM_CHAT_OFFICER;
+        case CHAT_MSG_CHANNEL:             return LLM_CHAT_CHANNEL;
+        default:                           return LLM_CHAT_OTHER;
+    }
+}
+
+char const* LLMChatQueue::GetChatTypeName(LLMChatType chatType)
+{
+    static constexpr char const* names[LLM_CHAT_TYPE_COUNT] =
+    {
+        "Say", "Yell", "Emote", "TextEmote", "Whisper", "Party", "PartyLeader", "Raid", "RaidLeader",
+        "RaidWarning", "Battleground", "BattlegroundLeader", "Guild", "Officer", "Channel", "Other"
+    };
+    return chatType < LLM_CHAT_TYPE_COUNT ? names[chatType] : "Unknown";
+}
+
+LLMChatPriority LLMChatQueue::GetPriorityClass(LLMChatType chatType)
 {
-    std::string endpoint = sConfigMgr->GetOption<std::string>("LLMChat.Endpoint", "http://localhost:11434/api/generate");
-    std::string model = sConfigMgr->GetOption<std::string>("LLMChat.Model", "mistral");
-    bool enabled = sConfigMgr->GetOption<bool>("LLMChat.Enable", true);
-    
-    LOG_INFO("module", "[LLMChat] ========== BEGIN QUERY LLM ==========");
-    LOG_INFO("module", "[LLMChat] Configuration:");
-    LOG_INFO("module", "[LLMChat] - Endpoint: {}", endpoint);
-    LOG_INFO("module", "[LLMChat] - Model: {}", model);
-    LOG_INFO("module", "[LLMChat] - Enabled: {}", enabled);
-    
-    if (!enabled || endpoint.empty())
+    switch (chatType)
     {
-        LOG_ERROR("module", "[LLMChat] Module is disabled or API endpoint is not configured");
-        LOG_ERROR("module", "[LLMChat] Enable: {}, Endpoint: '{}'", enabled, endpoint);
-        SendDefaultResponse(responder, sender);
+        case LLM_CHAT_WHISPER:
+            return LLM_PRIORITY_WHISPER;
+        case LLM_CHAT_PARTY:
+        case LLM_CHAT_PARTY_LEADER:
+        case LLM_CHAT_RAID:
+        case LLM_CHAT_RAID_LEADER:
+        case LLM_CHAT_RAID_WARNING:
+        case LLM_CHAT_BATTLEGROUND:
+        case LLM_CHAT_BATTLEGROUND_LEADER:
+            return LLM_PRIORITY_GROUP;
+        case LLM_CHAT_SAY:
+        case LLM_CHAT_YELL:
+        case LLM_CHAT_EMOTE:
+        case LLM_CHAT_TEXT_EMOTE:
+            return LLM_PRIORITY_LOCAL;
+        default:
+            return LLM_PRIORITY_CHANNEL;
+    }
+}
+
+void LLMChatQueue::DispatchResponse(QueuedResponse const& response)
+{
+    try
+    {
+        LLMChatSnapshot const& snapshot = *response.snapshot;
+
+        LLMCHAT_LOG(LLM_LOG_DETAIL, "Request #{}: {} message from {} for {} responders: {}", snapshot.requestId,
+            GetChatTypeName(snapshot.chatType), snapshot.sender.name, snapshot.responders.size(), snapshot.message);
+
+        // Hands the request to the engine and returns without waiting for the reply
+        if (snapshot.responders.size() > 1)
+            QueryLLMGroup(response.snapshot);
+        else
+            QueryLLM(response.snapshot);
+    }
+    catch (const std::exception& e)
+    {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_EXCEPTION);
+        LOG_ERROR("module", "[LLMChat] Error processing queued message: {}", e.what());
+    }
+}
+
+void LLMChatQueue::QueryLLM(std::shared_ptr<LLMChatSnapshot const> const& snapshot)
+{
+    std::string const& message = snapshot->message;
+    LLMChatType chatType = snapshot->chatType;
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+
+    LLMCHAT_LOG(LLM_LOG_DEBUG, "========== BEGIN QUERY LLM ==========");
+
+    if (!config->Enable)
+    {
+        LOG_ERROR("module", "[LLMChat] Module is disabled");
+        SendDefaultResponse(*snapshot);
         return;
     }
 
+    auto prepareStart = std::chrono::steady_clock::now();
     try
     {
-        LOG_INFO("module", "[LLMChat] Starting URL parsing for endpoint: {}", endpoint);
-        
-        // Parse URL to get host, port, and target
-        std::string url = endpoint;
-        bool use_ssl = url.substr(0, 8) == "https://";
-        std::string protocol = use_ssl ? "https://" : "http://";
-        
-        LOG_INFO("module", "[LLMChat] - Protocol detected: {}", protocol);
-        
-        std::string host_and_path = url.substr(protocol.length());
-        LOG_INFO("module", "[LLMChat] - Host and path part: {}", host_and_path);
-        
-        size_t slash_pos = host_and_path.find('/');
-        std::string host = host_and_path.substr(0, slash_pos);
-        std::string target = slash_pos != std::string::npos ? host_and_path.substr(slash_pos) : "/";
-        
-        LOG_INFO("module", "[LLMChat] - Initial host parsing: {}", host);
-        LOG_INFO("module", "[LLMChat] - Target path: {}", target);
-        
-        // Extract port if specified, otherwise use default
-        size_t colon_pos = host.find(':');
-        std::string port;
-        if (colon_pos != std::string::npos)
+        CharacterDetails const& responderDetails = snapshot->responders.front().details;
+        CharacterDetails const& senderDetails = snapshot->sender;
+
+        LLMCHAT_LOG(LLM_LOG_DEBUG, "Responder: {} ({} {}) in {}", responderDetails.name, responderDetails.raceName,
+            responderDetails.className, responderDetails.location);
+
+        // "?" and "!!!" normalize to nothing and must not share a reply. With the keys left
+        // empty the reply is not stored either.
+        LLMReplyCacheKeys cacheKeys;
+        std::string cached;
+        std::string normalized = LLMChatCache::NormalizeMessage(message);
+        if (LLMChatCache::IsEnabled() && !normalized.empty())
         {
-            port = host.substr(colon_pos + 1);
-            host = host.substr(0, colon_pos);
-            LOG_INFO("module", "[LLMChat] - Found explicit port: {}", port);
+            cacheKeys.exact = LLMChatCache::BuildKey(normalized, responderDetails, senderDetails, chatType);
+            if (LLMChatCache::Lookup(cacheKeys.exact, GetPriorityClass(chatType), cached))
+            {
+                LLMChatMetrics::Add(LLM_COUNTER_CACHE_HITS);
+                if (snapshot->trace)
+                    snapshot->trace->AddSpan("prepare", LLM_TRACE_MESSAGE, prepareStart, std::chrono::steady_clock::now(),
+                        "response cache hit");
+                LLMCHAT_LOG(LLM_LOG_DETAIL, "Answered from the response cache");
+                SendCachedResponse(cached, snapshot);
+                return;
+            }
         }
-        else
+
+        if (LLMChatSimilarityCache::IsEnabled() && LLMChatSimilarityCache::IsLongEnough(normalized))
         {
-            port = use_ssl ? "443" : "80";
-            LOG_INFO("module", "[LLMChat] - Using default port for {}: {}", use_ssl ? "HTTPS" : "HTTP", port);
+            cacheKeys.profile = LLMChatSimilarityCache::HashProfile(
+                LLMChatCache::BuildProfile(responderDetails, senderDetails, chatType));
+            cacheKeys.fingerprint = LLMChatSimilarityCache::Fingerprint(normalized);
+
+            // Exact repeats stay with the exact-match cache so it can collect its variants
+            if (LLMChatSimilarityCache::Lookup(cacheKeys.profile, cacheKeys.fingerprint, LLMChatCache::IsEnabled(), cached))
+            {
+                LLMChatMetrics::Add(LLM_COUNTER_SIMILARITY_HITS);
+                if (snapshot->trace)
+                    snapshot->trace->AddSpan("prepare", LLM_TRACE_MESSAGE, prepareStart, std::chrono::steady_clock::now(),
+                        "similarity cache hit");
+                LLMCHAT_LOG(LLM_LOG_DETAIL, "Answered from the similarity cache");
+                SendCachedResponse(cached, snapshot);
+                return;
+            }
         }
 
-        LOG_INFO("module", "[LLMChat] Final connection parameters:");
-        LOG_INFO("module", "[LLMChat] - Protocol: {}", protocol);
-        LOG_INFO("module", "[LLMChat] - Host: {}", host);
-        LOG_INFO("module", "[LLMChat] - Port: {}", port);
-        LOG_INFO("module", "[LLMChat] - Target: {}", target);
-        LOG_INFO("module", "[LLMChat] - SSL: {}", use_ssl ? "Yes" : "No");
-
-        // Build request body
-        LOG_INFO("module", "[LLMChat] Building request body...");
-        
-        CharacterDetails responderDetails = LLMChatCharacter::GetCharacterDetails(responder);
-        CharacterDetails senderDetails = LLMChatCharacter::GetCharacterDetails(sender);
-        
-        LOG_INFO("module", "[LLMChat] Character details loaded:");
-        LOG_INFO("module", "[LLMChat] - Responder: {} ({} {})", 
-            responderDetails.name, responderDetails.raceName, responderDetails.className);
-        LOG_INFO("module", "[LLMChat] - Location: {}", responderDetails.location);
-
-        // Format prompt
-        std::string prompt = fmt::format(
-            "You are a WoW player controlling {} - a level {} {} {} of the {} faction. You're currently in {}{}{}{}. "
-            "\nYou're responding to {} - a level {} {} {} of the {} faction who is currently in {}{}. "
-            "\nRespond to this message matching its tone and attitude - if they're friendly, be friendly back. "
-            "If they're rude or hostile, you can be snarky, defensive, or even toxic back. If they're joking, joke back. "
-            "Show faction pride when appropriate - defend your faction if they insult it, mock the opposite faction if they deserve it. "
-            "Consider level differences in your response - be more respectful to higher levels, maybe cocky to lower levels. "
-            "If they ask about locations or directions, give accurate guidance based on both your current location and theirs. "
-            "For questions about where things are, provide specific directions relative to known landmarks, flight paths, or major cities. "
-            "Don't hold back or filter your responses - be authentic to how real WoW players would actually respond. "
-            "Keep responses short and natural. Here's the message: {}\n\n"
-            "Important: Match the tone and intensity of the message you received. Write exactly like a real player would - "
-            "be raw and unfiltered, using common WoW chat style and slang. Don't worry about being polite or politically correct. "
-            "Remember your faction loyalty - Alliance vs Horde rivalry is a core part of WoW culture. "
-            "When giving directions or location info, be specific and accurate to WoW geography. "
-            "You can mix in light roleplay elements if it fits, but focus on sounding like a real player in their natural habitat.",
-            responderDetails.name,
-            responderDetails.level,
-            responderDetails.raceName,
-            responderDetails.className,
-            responderDetails.faction,
-            responderDetails.location,
-            !responderDetails.guildName.empty() ? fmt::format("\nMember of <{}>", responderDetails.guildName) : "",
-            responderDetails.isInCombat ? fmt::format("\nCurrently in combat ({}% health)", responderDetails.healthPct) : "",
-            !responderDetails.targetName.empty() ? fmt::format("\nTargeting: {}", responderDetails.targetName) : "",
-            senderDetails.name,
-            senderDetails.level,
-            senderDetails.raceName,
-            senderDetails.className,
-            senderDetails.faction,
-            senderDetails.location,
-            !senderDetails.guildName.empty() ? fmt::format("\nMember of <{}>", senderDetails.guildName) : "",
-            message);
-
-        LOG_INFO("module", "[LLMChat] Generated prompt:\n{}", prompt);
-
-        // Create the JSON request
-        LOG_INFO("module", "[LLMChat] Creating JSON request...");
-        nlohmann::json requestJson;
-        requestJson["model"] = model;
-        requestJson["prompt"] = prompt;
-        requestJson["stream"] = false;
-        requestJson["raw"] = false;
-
-        std::string body = requestJson.dump();
-        LOG_INFO("module", "[LLMChat] Request payload:\n{}", body);
-
-        LOG_INFO("module", "[LLMChat] Setting up network connection...");
-        
-        // Create and configure IO context
-        auto ioc = std::make_shared<net::io_context>();
-        auto resolver = std::make_shared<tcp::resolver>(*ioc);
-        auto stream = std::make_shared<beast::tcp_stream>(*ioc);
-        auto req = std::make_shared<http::request<http::string_body>>();
-
-        LOG_INFO("module", "[LLMChat] Configuring HTTP request...");
-        
-        // Set up the request
-        req->method(http::verb::post);
-        req->target(target);
-        req->version(11);
-        req->set(http::field::host, host);
-        req->set(http::field::user_agent, "AzerothCore-LLMChat/1.0");
-        req->set(http::field::content_type, "application/json");
-        req->set(http::field::accept, "application/json");
-        req->set(http::field::connection, "close");
-        req->body() = body;
-        req->prepare_payload();
-
-        LOG_INFO("module", "[LLMChat] Request headers:");
-        LOG_INFO("module", "[LLMChat] - Method: POST");
-        LOG_INFO("module", "[LLMChat] - Target: {}", target);
-        LOG_INFO("module", "[LLMChat] - Host: {}", host);
-        LOG_INFO("module", "[LLMChat] - Content-Type: application/json");
-        LOG_INFO("module", "[LLMChat] - Content-Length: {}", body.length());
-
-        LOG_INFO("module", "[LLMChat] Starting DNS resolution for host: {}", host);
-
-        // Start the async operation
-        resolver->async_resolve(host, port,
-            [ioc, resolver, stream, req, responder, sender, chatType](beast::error_code ec, tcp::resolver::results_type results)
+        auto request = CreateRequest(*snapshot);
+        if (!request)
+            return;
+
+        LLMPrompt prompt = BuildPrompt(*snapshot, *request->backend);
+        if (snapshot->trace)
+            snapshot->trace->SetPrompt(prompt.system, prompt.user);
+        // Prompts and payloads run to kilobytes each; only a sample of them is logged
+        LLMCHAT_LOG_SAMPLED(LLM_LOG_DEBUG, "Generated prompt (~{} tokens):\n{}\n{}", prompt.tokens, prompt.system, prompt.user);
+
+        request->body = BuildRequestBody(*request->backend, prompt, config->Stream.Enable, false);
+        LLMCHAT_LOG_SAMPLED(LLM_LOG_DEBUG, "Request payload:\n{}", request->body);
+
+        // Replies go back through the completion mailbox; the world thread checks the bots are still there
+        if (config->Stream.Enable)
+        {
+            auto state = std::make_shared<LLMStreamState>(config->Stream.MaxLineLength, config->Stream.FirstLineDelay);
+            state->snapshot = snapshot;
+            state->cacheKeys = std::move(cacheKeys);
+            state->promptTokens = prompt.tokens;
+            state->startTime = std::chrono::steady_clock::now();
+
+            request->onChunk = [state](std::string_view chunk) { HandleStreamChunk(*state, chunk); };
+            request->onComplete = [state](LLMHttpResult const& result) { HandleStreamComplete(*state, result); };
+        }
+        else
+        {
+            request->onComplete = [snapshot, cacheKeys, promptTokens = prompt.tokens](LLMHttpResult const& result)
             {
-                if (ec)
-                {
-                    LOG_ERROR("module", "[LLMChat] DNS resolve failed: {}", ec.message());
-                    LOG_ERROR("module", "[LLMChat] Error code: {}", ec.value());
-                    LOG_ERROR("module", "[LLMChat] Category: {}", ec.category().name());
-                    SendDefaultResponse(responder, sender);
-                    return;
-                }
-
-                LOG_INFO("module", "[LLMChat] DNS resolution successful");
-                LOG_INFO("module", "[LLMChat] Resolved endpoints:");
-                for(auto const& endpoint : results)
-                {
-                    LOG_INFO("module", "[LLMChat] - {}:{}", endpoint.endpoint().address().to_string(), endpoint.endpoint().port());
-                }
-
-                LOG_INFO("module", "[LLMChat] Attempting connection...");
-                stream->expires_after(std::chrono::seconds(30));
-                stream->async_connect(results,
-                    [ioc, stream, req, responder, sender, chatType](beast::error_code ec, tcp::resolver::results_type::endpoint_type endpoint)
-                    {
-                        if (ec)
-                        {
-                            LOG_ERROR("module", "[LLMChat] Connection failed:");
-                            LOG_ERROR("module", "[LLMChat] - Error: {}", ec.message());
-                            LOG_ERROR("module", "[LLMChat] - Error code: {}", ec.value());
-                            LOG_ERROR("module", "[LLMChat] - Category: {}", ec.category().name());
-                            SendDefaultResponse(responder, sender);
-                            return;
-                        }
-
-                        LOG_INFO("module", "[LLMChat] Connected successfully to {}:{}", 
-                            endpoint.address().to_string(), endpoint.port());
-
-                        LOG_INFO("module", "[LLMChat] Sending HTTP request...");
-                        stream->expires_after(std::chrono::seconds(30));
-                        http::async_write(*stream, *req,
-                            [ioc, stream, req, responder, sender, chatType](beast::error_code ec, std::size_t bytes_transferred)
-                            {
-                                if (ec)
-                                {
-                                    LOG_ERROR("module", "[LLMChat] Failed to send request:");
-                                    LOG_ERROR("module", "[LLMChat] - Error: {}", ec.message());
-                                    LOG_ERROR("module", "[LLMChat] - Error code: {}", ec.value());
-                                    LOG_ERROR("module", "[LLMChat] - Category: {}", ec.category().name());
-                                    SendDefaultResponse(responder, sender);
-                                    return;
-                                }
-
-                                LOG_INFO("module", "[LLMChat] Request sent successfully ({} bytes)", bytes_transferred);
-                                LOG_INFO("module", "[LLMChat] Waiting for response...");
-
-                                auto res = std::make_shared<http::response<http::string_body>>();
-                                auto buffer = std::make_shared<beast::flat_buffer>();
-
-                                stream->expires_after(std::chrono::seconds(30));
-                                http::async_read(*stream, *buffer, *res,
-                                    [ioc, stream, res, responder, sender, chatType](beast::error_code ec, std::size_t bytes_transferred)
-                                    {
-                                        if (ec)
-                                        {
-                                            LOG_ERROR("module", "[LLMChat] Failed to read response:");
-                                            LOG_ERROR("module", "[LLMChat] - Error: {}", ec.message());
-                                            LOG_ERROR("module", "[LLMChat] - Error code: {}", ec.value());
-                                            LOG_ERROR("module", "[LLMChat] - Category: {}", ec.category().name());
-                                            SendDefaultResponse(responder, sender);
-                                            return;
-                                        }
-
-                                        LOG_INFO("module", "[LLMChat] Response received:");
-                                        LOG_INFO("module", "[LLMChat] - Status: {}", res->result_int());
-                                        LOG_INFO("module", "[LLMChat] - Version: HTTP/{}.{}", 
-                                            res->version() / 10, res->version() % 10);
-                                        LOG_INFO("module", "[LLMChat] - Content-Length: {}", bytes_transferred);
-                                        // Escape curly braces in the response body for fmt
-                                        std::string escaped_body = res->body();
-                                        LOG_INFO("module", "[LLMChat] Response body: {}", escaped_body);
-
-                                        try {
-                                            LOG_INFO("module", "[LLMChat] Parsing JSON response...");
-                                            auto jsonResponse = nlohmann::json::parse(res->body());
-                                            
-                                            if(jsonResponse.contains("error")) {
-                                                LOG_ERROR("module", "[LLMChat] API error: {}", 
-                                                    jsonResponse["error"].get<std::string>());
-                                                SendDefaultResponse(responder, sender);
-                                                return;
-                                            }
-                                            
-                                            std::string response;
-                                            if(jsonResponse.contains("response")) {
-                                                response = jsonResponse["response"].get<std::string>();
-                                                LOG_INFO("module", "[LLMChat] Successfully parsed response: {}", response);
-                                            } else {
-                                                LOG_ERROR("module", "[LLMChat] No response field in API response");
-                                                SendDefaultResponse(responder, sender);
-                                                return;
-                                            }
-
-                                            if(!response.empty() && responder && responder->IsInWorld()) {
-                                                uint32 delay = urand(2000, 3500);
-                                                LOG_INFO("module", "[LLMChat] Scheduling response with delay: {}ms", delay);
-                                                
-                                                // Convert the chat type string to enum
-                                                uint32 chatTypeEnum = GetChatTypeFromString(chatType, responder);
-                                                LOG_INFO("module", "[LLMChat] Using chat type: {} ({})", chatType, chatTypeEnum);
-                                                
-                                                responder->m_Events.AddEvent(
-                                                    new BotResponseEvent(responder, sender, response, chatTypeEnum),
-                                                    responder->m_Events.CalculateTime(delay)
-                                                );
-                                            } else {
-                                                LOG_ERROR("module", "[LLMChat] Empty response or invalid responder");
-                                                SendDefaultResponse(responder, sender);
-                                            }
-                                        }
-                                        catch (const std::exception& e) {
-                                            LOG_ERROR("module", "[LLMChat] Error parsing response: {}", e.what());
-                                            LOG_ERROR("module", "[LLMChat] Exception details: {}", e.what());
-                                            SendDefaultResponse(responder, sender);
-                                        }
-
-                                        LOG_INFO("module", "[LLMChat] Closing connection...");
-                                        beast::error_code bec;
-                                        stream->socket().shutdown(tcp::socket::shutdown_both, bec);
-                                        if(bec && bec != beast::errc::not_connected) {
-                                            LOG_ERROR("module", "[LLMChat] Error during shutdown: {}", bec.message());
-                                        }
-                                        LOG_INFO("module", "[LLMChat] Connection closed");
-                                    });
-                            });
-                    });
-            });
-
-        LOG_INFO("module", "[LLMChat] Starting IO context...");
-        ioc->run();
-        LOG_INFO("module", "[LLMChat] IO context completed");
+                HandleLLMResponse(result, *snapshot, cacheKeys, promptTokens);
+            };
+        }
+
+        if (snapshot->trace)
+            snapshot->trace->AddSpan("prepare", LLM_TRACE_MESSAGE, prepareStart, std::chrono::steady_clock::now());
+        LLMChatEngine::Submit(request);
+        TrackRequest(*snapshot, request);
+        LLMCHAT_LOG(LLM_LOG_DEBUG, "Request #{} submitted ({} in flight)", snapshot->requestId, LLMChatEngine::GetInFlight());
     }
     catch (const std::exception& e)
     {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_EXCEPTION);
         LOG_ERROR("module", "[LLMChat] Critical error in QueryLLM:");
         LOG_ERROR("module", "[LLMChat] - Exception: {}", e.what());
-        SendDefaultResponse(responder, sender);
+        SendDefaultResponse(*snapshot);
+    }
+
+    LLMCHAT_LOG(LLM_LOG_DEBUG, "========== END QUERY LLM ==========");
+}
+
+void LLMChatQueue::QueryLLMGroup(std::shared_ptr<LLMChatSnapshot const> const& snapshot)
+{
+    auto prepareStart = std::chrono::steady_clock::now();
+    try
+    {
+        auto request = CreateRequest(*snapshot);
+        if (!request)
+            return;
+
+        LLMPrompt prompt = BuildGroupPrompt(*snapshot, *request->backend);
+        if (snapshot->trace)
+            snapshot->trace->SetPrompt(prompt.system, prompt.user);
+        LLMCHAT_LOG_SAMPLED(LLM_LOG_DEBUG, "Generated group prompt for {} speakers (~{} tokens):\n{}\n{}",
+            snapshot->responders.size(), prompt.tokens, prompt.system, prompt.user);
+
+        bool streamed = sLLMConfig->Stream.Enable;
+        request->body = BuildRequestBody(*request->backend, prompt, streamed, true);
+
+        // Streamed like single replies, so the backend's first byte arrives with the first
+        // token and its latency means the same for both
+        std::shared_ptr<LLMGroupStreamState> stream;
+        if (streamed)
+        {
+            stream = std::make_shared<LLMGroupStreamState>();
+            request->onChunk = [stream](std::string_view chunk) { stream->decoder.Feed(chunk, stream->text); };
+        }
+        request->onComplete = [snapshot, stream, promptTokens = prompt.tokens](LLMHttpResult const& result)
+        {
+            HandleGroupResponse(result, *snapshot, promptTokens, stream.get());
+        };
+
+        if (snapshot->trace)
+            snapshot->trace->AddSpan("prepare", LLM_TRACE_MESSAGE, prepareStart, std::chrono::steady_clock::now());
+        LLMChatEngine::Submit(request);
+        TrackRequest(*snapshot, request);
+    }
+    catch (const std::exception& e)
+    {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_EXCEPTION);
+        LOG_ERROR("module", "[LLMChat] Critical error in QueryLLMGroup: {}", e.what());
+        SendDefaultResponse(*snapshot);
+    }
+}
+
+LLMPrompt LLMChatQueue::BuildPrompt(LLMChatSnapshot const& snapshot, LLMBackend const& backend)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::shared_ptr<LLMPromptTemplates const> templates = LLMPromptTemplates::Current();
+
+    LLMPromptContext context;
+    context.bot = &snapshot.responders.front().details;
+    context.sender = &snapshot.sender;
+    context.message = snapshot.message;
+    context.chatType = GetChatTypeName(snapshot.chatType);
+
+    LLMPrompt prompt;
+    prompt.maxTokens = config->API.MaxTokens;
+    prompt.stop = true;
+    RenderPrompt(templates->Get(LLM_PROMPT_CHAT_SYSTEM), templates->Get(LLM_PROMPT_CHAT_USER), context,
+        GetPromptBudget(*config, backend, prompt.maxTokens), prompt);
+    return prompt;
+}
+
+LLMPrompt LLMChatQueue::BuildGroupPrompt(LLMChatSnapshot const& snapshot, LLMBackend const& backend)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::shared_ptr<LLMPromptTemplates const> templates = LLMPromptTemplates::Current();
+
+    thread_local std::vector<CharacterDetails const*> t_bots;
+    t_bots.clear();
+    for (LLMResponderSnapshot const& responder : snapshot.responders)
+        t_bots.push_back(&responder.details);
+
+    LLMPromptContext context;
+    context.bot = t_bots.front();
+    context.sender = &snapshot.sender;
+    context.bots = t_bots;
+    context.message = snapshot.message;
+    context.chatType = GetChatTypeName(snapshot.chatType);
+
+    // One reply per speaker, each wrapped in {"speaker":"...","text":"..."}; no stop
+    // sequences, a blank line inside the JSON must not end it
+    LLMPrompt prompt;
+    if (config->API.MaxTokens)
+        prompt.maxTokens = (config->API.MaxTokens + GROUP_REPLY_OVERHEAD_TOKENS) * uint32(t_bots.size()) +
+            GROUP_REPLY_OVERHEAD_TOKENS;
+    RenderPrompt(templates->Get(LLM_PROMPT_GROUP_SYSTEM), templates->Get(LLM_PROMPT_GROUP_USER), context,
+        GetPromptBudget(*config, backend, prompt.maxTokens), prompt);
+    return prompt;
+}
+
+uint32 LLMChatQueue::GetPromptBudget(LLMConfig const& config, LLMBackend const& backend, uint32 maxTokens)
+{
+    uint32 budget = config.API.PromptTokens ? config.API.PromptTokens : std::numeric_limits<uint32>::max();
+
+    // The prompt and the reply share the context window; a prompt that does not leave room for
+    // the reply gets its beginning cut off by the backend, system prompt first
+    uint32 contextLength = backend.contextLength;
+    uint32 reserved = maxTokens + CHAT_TEMPLATE_TOKENS;
+    if (contextLength > reserved)
+        budget = std::min(budget, contextLength - reserved);
+    return budget;
+}
+
+void LLMChatQueue::RenderPrompt(LLMPromptTemplate const& system, LLMPromptTemplate const& user, LLMPromptContext& context,
+    uint32 budget, LLMPrompt& prompt)
+{
+    // The system part only changes with the bot, so it trims the same way for every message
+    // of a conversation until the user part alone pushes the prompt over
+    uint8 maxTrimLevel = std::max(system.GetMaxTrimLevel(), user.GetMaxTrimLevel());
+    for (context.trimLevel = 0; ; ++context.trimLevel)
+    {
+        prompt.system = system.Render(context);
+        prompt.user = user.Render(context);
+        prompt.tokens = LLMChatTokenizer::Estimate(prompt.system) + LLMChatTokenizer::Estimate(prompt.user);
+        if (prompt.tokens <= budget || context.trimLevel >= maxTrimLevel)
+            break;
+    }
+
+    if (prompt.tokens > budget)
+        LOG_WARN("module", "[LLMChat] Prompt of ~{} tokens is over the {} token budget with everything optional trimmed",
+            prompt.tokens, budget);
+    else if (context.trimLevel)
+        LOG_DEBUG("module", "[LLMChat] Prompt trimmed to level {} to fit ~{} tokens into {}", context.trimLevel,
+            prompt.tokens, budget);
+}
+
+std::string LLMChatQueue::BuildRequestBody(LLMBackend const& backend, LLMPrompt const& prompt, bool stream, bool json)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+
+    // Written straight into the body: prompts are long strings, and a DOM would copy each of
+    // them once more only to serialize it
+    std::string body;
+    body.reserve(prompt.system.size() + prompt.user.size() + 256);
+    LLMJsonWriter writer(body);
+    writer.BeginObject();
+    writer.Key("model").String(backend.model);
+    if (backend.api == LLM_API_CHAT || backend.api == LLM_API_OPENAI)
+    {
+        writer.Key("messages").BeginArray();
+        writer.BeginObject().Key("role").String("system").Key("content").String(prompt.system).EndObject();
+        writer.BeginObject().Key("role").String("user").Key("content").String(prompt.user).EndObject();
+        writer.EndArray();
+    }
+    else
+    {
+        writer.Key("system").String(prompt.system);
+        writer.Key("prompt").String(prompt.user);
+        writer.Key("raw").Bool(false);
     }
-    
-    LOG_INFO("module", "[LLMChat] ========== END QUERY LLM ==========");
+    writer.Key("stream").Bool(stream);
+
+    // OpenAI-compatible servers take the sampling settings at the top level and know nothing
+    // of Ollama's options or keep_alive
+    if (backend.api == LLM_API_OPENAI)
+    {
+        if (json)
+            writer.Key("response_format").BeginObject().Key("type").String("json_object").EndObject();
+        writer.Key("temperature").Double(config->API.Temperature);
+        if (prompt.maxTokens)
+            writer.Key("max_tokens").Uint(prompt.maxTokens);
+        if (prompt.stop && !config->API.StopSequences.empty())
+        {
+            writer.Key("stop").BeginArray();
+            for (std::string const& sequence : config->API.StopSequences)
+                writer.String(sequence);
+            writer.EndArray();
+        }
+        writer.EndObject();
+        return body;
+    }
+
+    if (json)
+        writer.Key("format").String("json");
+
+    writer.Key("options").BeginObject();
+    writer.Key("temperature").Double(config->API.Temperature);
+    if (prompt.maxTokens)
+        writer.Key("num_predict").Uint(prompt.maxTokens);
+    if (prompt.stop && !config->API.StopSequences.empty())
+    {
+        writer.Key("stop").BeginArray();
+        for (std::string const& sequence : config->API.StopSequences)
+            writer.String(sequence);
+        writer.EndArray();
+    }
+    writer.EndObject();
+
+    if (!config->Warmup.KeepAlive.empty())
+        writer.Key("keep_alive").String(config->Warmup.KeepAlive);
+    writer.EndObject();
+    return body;
 }
 
-void LLMChatQueue::SendDefaultResponse(Player* responder, Player* sender)
+void LLMChatQueue::RecordTokens(LLMBackend& backend, uint32 estimatedPromptTokens, LLMGenerationStats const& stats)
 {
-    if (!responder || !responder->IsInWorld())
+    LLMChatBackends::RecordGeneration(backend, stats);
+    // The backend counts only the prompt tokens it evaluated; a reused prefix is not among them
+    LLMCHAT_LOG(LLM_LOG_DEBUG, "Tokens: prompt ~{} ({} evaluated), output {}", estimatedPromptTokens,
+        stats.promptTokens, stats.outputTokens);
+}
+
+std::shared_ptr<LLMHttpRequest> LLMChatQueue::CreateRequest(LLMChatSnapshot const& snapshot)
+{
+    std::shared_ptr<LLMBackend> backend = LLMChatBackends::Select();
+    if (!backend)
+    {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_NO_BACKEND);
+        LOG_ERROR("module", "[LLMChat] No LLM backend available (all ejected or failing), sending fallback reply");
+        SendDefaultResponse(snapshot);
+        return nullptr;
+    }
+
+    LLMChatPriority priority = GetPriorityClass(snapshot.chatType);
+    auto request = std::make_shared<LLMHttpRequest>();
+    request->backend = backend;
+    request->endpoint = backend->endpoint;
+    request->deadline = snapshot.deadline;
+    request->trace = snapshot.trace;
+    if (sLLMConfig->Priority.Classes[priority].Hedge)
+        request->hedging = s_hedging[priority].get();
+
+    LLMCHAT_LOG(LLM_LOG_DEBUG, "Routing to backend {} ({} in flight), model {}", backend->url,
+        backend->outstanding.load(), backend->model);
+    return request;
+}
+
+bool LLMChatQueue::ExtractResponseText(LLMHttpResult const& result, uint64 requestId, uint32 promptTokens, std::string& text)
+{
+    if (!result.success)
+    {
+        LLMChatMetrics::Add(result.rejected ? LLM_COUNTER_ERROR_BREAKER : LLM_COUNTER_ERROR_TRANSPORT);
+        LOG_ERROR("module", "[LLMChat] Request #{} failed: {}", requestId, result.error);
+        return false;
+    }
+
+    LLMCHAT_LOG(LLM_LOG_DEBUG, "Request #{}: response received - status {}, {} bytes", requestId, result.status,
+        result.body.size());
+    LLMCHAT_LOG_SAMPLED(LLM_LOG_DEBUG, "Response body: {}", result.body);
+
+    LLMResponseChunk chunk;
+    if (!LLMResponseChunk::Parse(result.body, chunk, text))
+    {
+        LLMChatMetrics::Add(result.status != 200 ? LLM_COUNTER_ERROR_HTTP : LLM_COUNTER_ERROR_PARSE);
+        LOG_ERROR("module", "[LLMChat] Error parsing response: not a JSON object");
+        return false;
+    }
+
+    if (result.backend && chunk.hasStats)
+        RecordTokens(*result.backend, promptTokens, chunk.stats);
+
+    if (chunk.hasError)
+    {
+        LLMChatMetrics::Add(result.status != 200 ? LLM_COUNTER_ERROR_HTTP : LLM_COUNTER_ERROR_API);
+        LOG_ERROR("module", "[LLMChat] API error: {}", chunk.error);
+        return false;
+    }
+
+    if (chunk.hasText)
+    {
+        LLMCHAT_LOG_SAMPLED(LLM_LOG_DEBUG, "Successfully parsed response: {}", text);
+        return true;
+    }
+
+    LLMChatMetrics::Add(result.status != 200 ? LLM_COUNTER_ERROR_HTTP : LLM_COUNTER_ERROR_PARSE);
+    LOG_ERROR("module", "[LLMChat] No response field in API response");
+    return false;
+}
+
+bool LLMChatQueue::ExtractStreamedText(LLMHttpResult const& result, uint64 requestId, uint32 promptTokens,
+    LLMGroupStreamState& stream, std::string& text)
+{
+    if (!result.success)
+    {
+        LLMChatMetrics::Add(result.rejected ? LLM_COUNTER_ERROR_BREAKER : LLM_COUNTER_ERROR_TRANSPORT);
+        LOG_ERROR("module", "[LLMChat] Request #{} failed: {}", requestId, result.error);
+        return false;
+    }
+
+    // An error status is not streamed out; its body is kept whole
+    if (result.status != 200)
+    {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_HTTP);
+        LOG_ERROR("module", "[LLMChat] Request #{} returned HTTP {}: {}", requestId, result.status, result.body);
+        return false;
+    }
+
+    stream.decoder.Finish(stream.text);
+    if (result.backend && stream.decoder.HasStats())
+        RecordTokens(*result.backend, promptTokens, stream.decoder.GetStats());
+
+    if (!stream.decoder.GetError().empty())
+    {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_API);
+        LOG_ERROR("module", "[LLMChat] API error: {}", stream.decoder.GetError());
+        return false;
+    }
+
+    text = std::move(stream.text);
+    LLMCHAT_LOG_SAMPLED(LLM_LOG_DEBUG, "Request #{}: streamed response: {}", requestId, text);
+    return true;
+}
+
+void LLMChatQueue::HandleLLMResponse(LLMHttpResult const& result, LLMChatSnapshot const& snapshot, LLMReplyCacheKeys const& cacheKeys,
+    uint32 promptTokens)
+{
+    if (IsDiscarded(result, snapshot))
         return;
 
+    std::string response;
+    if (!ExtractResponseText(result, snapshot.requestId, promptTokens, response))
+    {
+        SendDefaultResponse(snapshot);
+        return;
+    }
+    if (response.empty())
+    {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_EMPTY);
+        SendDefaultResponse(snapshot);
+        return;
+    }
+
+    LLMChatMetrics::Record(LLM_HISTOGRAM_GENERATION, result.elapsed);
+    StoreReply(cacheKeys, snapshot, response);
+
+    LLMResponderSnapshot const& responder = snapshot.responders.front();
+    LogTranscript(snapshot, responder, response, "llm");
+    uint32 delay = urand(2000, 3500);
+    LLMCHAT_LOG(LLM_LOG_DEBUG, "Scheduling response with delay: {}ms, chat type: {} ({})", delay, GetChatTypeName(snapshot.chatType),
+        responder.chatMsg);
+
+    LLMChatCompletion completion;
+    completion.senderGuid = snapshot.senderGuid;
+    completion.responderGuid = responder.guid;
+    completion.text = std::move(response);
+    completion.chatMsg = responder.chatMsg;
+    completion.deliverAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+    completion.trace = snapshot.trace;
+    Deliver(std::move(completion));
+}
+
+bool LLMChatQueue::IsDiscarded(LLMHttpResult const& result, LLMChatSnapshot const& snapshot)
+{
+    // Superseded by a newer message, which gets its own reply, or the player went away
+    if (result.cancelled)
+    {
+        if (snapshot.trace)
+            snapshot.trace->SetOutcome("cancelled");
+        return true;
+    }
+
+    // A canned line long after the message would read worse than no reply at all
+    if (result.expired)
+    {
+        ++s_classStats[GetPriorityClass(snapshot.chatType)].timedOut;
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_TIMEOUT);
+        if (snapshot.trace)
+            snapshot.trace->SetOutcome("timed out");
+        LOG_INFO("module", "[LLMChat] Request #{}: reply to {} abandoned - {} deadline exceeded", snapshot.requestId,
+            snapshot.sender.name, GetChatTypeName(snapshot.chatType));
+        return true;
+    }
+    return false;
+}
+
+void LLMChatQueue::HandleStreamChunk(LLMStreamState& state, std::string_view chunk)
+{
+    std::string text;
+    state.decoder.Feed(chunk, text);
+    if (text.empty())
+        return;
+
+    if (state.text.empty())
+        LLMChatMetrics::Record(LLM_HISTOGRAM_FIRST_TOKEN, std::chrono::steady_clock::now() - state.startTime);
+    state.text += text;
+
+    std::vector<std::string> lines;
+    state.splitter.Append(text, std::chrono::steady_clock::now() >= state.nextLineAt, lines);
+    if (!lines.empty())
+        DeliverStreamLines(state, lines);
+}
+
+void LLMChatQueue::HandleStreamComplete(LLMStreamState& state, LLMHttpResult const& result)
+{
+    // Lines already posted stay; the rest of the reply is dropped
+    if (IsDiscarded(result, *state.snapshot))
+    {
+        LOG_DEBUG("module", "[LLMChat] Streamed reply cut off after {} lines: {}", state.linesDelivered, result.error);
+        return;
+    }
+
+    std::string text;
+    state.decoder.Finish(text);
+    state.text += text;
+
+    if (result.backend && state.decoder.HasStats())
+        RecordTokens(*result.backend, state.promptTokens, state.decoder.GetStats());
+
+    std::vector<std::string> lines;
+    state.splitter.Append(text, std::chrono::steady_clock::now() >= state.nextLineAt, lines);
+    state.splitter.Flush(lines);
+    if (!lines.empty())
+        DeliverStreamLines(state, lines);
+
+    bool complete = false;
+    if (!result.success)
+    {
+        LLMChatMetrics::Add(result.rejected ? LLM_COUNTER_ERROR_BREAKER : LLM_COUNTER_ERROR_TRANSPORT);
+        LOG_ERROR("module", "[LLMChat] Streamed request failed after {} lines: {}", state.linesDelivered, result.error);
+    }
+    else if (result.status != 200)
+    {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_HTTP);
+        LOG_ERROR("module", "[LLMChat] Streamed request returned HTTP {}: {}", result.status, result.body);
+    }
+    else if (!state.decoder.GetError().empty())
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_API);
+    else
+        complete = true;
+    if (!state.decoder.GetError().empty())
+        LOG_ERROR("module", "[LLMChat] API error: {}", state.decoder.GetError());
+
+    if (state.linesDelivered)
+    {
+        // Only complete generations are worth replaying
+        if (complete)
+        {
+            LLMChatMetrics::Record(LLM_HISTOGRAM_GENERATION, result.elapsed);
+            StoreReply(state.cacheKeys, *state.snapshot, state.text);
+        }
+
+        LogTranscript(*state.snapshot, state.snapshot->responders.front(), state.text, "stream");
+
+        LLMCHAT_LOG(LLM_LOG_DETAIL, "Request #{}: streamed reply finished - {} lines in {}ms", state.snapshot->requestId,
+            state.linesDelivered,
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state.startTime).count());
+        return;
+    }
+
+    if (complete)
+    {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_EMPTY);
+        LOG_ERROR("module", "[LLMChat] Empty streamed response");
+    }
+    SendDefaultResponse(*state.snapshot);
+}
+
+void LLMChatQueue::StoreReply(LLMReplyCacheKeys const& cacheKeys, LLMChatSnapshot const& snapshot, std::string const& reply)
+{
+    // Neither key holds the names, so a reply that uses one only fits this pair of characters
+    if (LLMChatCache::MentionsName(reply, snapshot.responders.front().details, snapshot.sender))
+        return;
+
+    if (!cacheKeys.exact.empty())
+        LLMChatCache::Store(cacheKeys.exact, GetPriorityClass(snapshot.chatType), reply);
+    if (cacheKeys.profile)
+        LLMChatSimilarityCache::Store(cacheKeys.profile, cacheKeys.fingerprint, reply);
+}
+
+void LLMChatQueue::SendCachedResponse(std::string const& reply, std::shared_ptr<LLMChatSnapshot const> const& snapshot)
+{
+    // Replayed through the same splitter and pacing as a streamed generation, but after the
+    // delay of a generated reply: an instant answer would give the cache away
+    LLMStreamState state(sLLMConfig->Stream.MaxLineLength, urand(2000, 3500));
+    state.snapshot = snapshot;
+    state.startTime = std::chrono::steady_clock::now();
+
+    // Every line after the first is queued behind it at once, so the rest is packed
+    std::vector<std::string> lines;
+    state.splitter.Append(reply, false, lines);
+    state.splitter.Flush(lines);
+    DeliverStreamLines(state, lines);
+
+    LogTranscript(*snapshot, snapshot->responders.front(), reply, "cache");
+}
+
+void LLMChatQueue::DeliverStreamLines(LLMStreamState& state, std::vector<std::string> const& lines)
+{
+    LLMResponderSnapshot const& responder = state.snapshot->responders.front();
+    std::chrono::milliseconds lineDelay(sLLMConfig->Stream.LineDelay);
+    auto now = std::chrono::steady_clock::now();
+
+    for (std::string const& line : lines)
+    {
+        // The first sentence goes out as soon as it is complete; later ones are paced behind it
+        LLMChatCompletion completion;
+        if (!state.linesDelivered)
+        {
+            completion.deliverAt = now + std::chrono::milliseconds(state.firstLineDelay);
+            LLMCHAT_LOG(LLM_LOG_DEBUG, "First streamed line after {}ms",
+                std::chrono::duration_cast<std::chrono::milliseconds>(now - state.startTime).count());
+        }
+        else
+            completion.deliverAt = std::max(state.nextLineAt, now);
+        state.nextLineAt = completion.deliverAt + lineDelay;
+
+        completion.senderGuid = state.snapshot->senderGuid;
+        completion.responderGuid = responder.guid;
+        completion.text = line;
+        completion.chatMsg = responder.chatMsg;
+        completion.trace = state.snapshot->trace;
+        Deliver(std::move(completion));
+        ++state.linesDelivered;
+    }
+}
+
+void LLMChatQueue::HandleGroupResponse(LLMHttpResult const& result, LLMChatSnapshot const& snapshot, uint32 promptTokens,
+    LLMGroupStreamState* stream)
+{
+    if (IsDiscarded(result, snapshot))
+        return;
+
+    std::string text;
+    bool extracted = stream ? ExtractStreamedText(result, snapshot.requestId, promptTokens, *stream, text)
+        : ExtractResponseText(result, snapshot.requestId, promptTokens, text);
+    if (!extracted)
+    {
+        SendDefaultResponse(snapshot);
+        return;
+    }
+
+    // Collect (speaker, reply) pairs; accept the requested array form or a plain name -> text object
+    std::vector<std::pair<std::string, std::string>> replies;
+    try
+    {
+        size_t begin = text.find('{');
+        size_t end = text.rfind('}');
+        if (begin == std::string::npos || end == std::string::npos || end < begin)
+            throw std::runtime_error("no JSON object in reply");
+
+        auto replyJson = nlohmann::json::parse(text.substr(begin, end - begin + 1));
+        if (replyJson.contains("replies") && replyJson["replies"].is_array())
+        {
+            for (auto const& item : replyJson["replies"])
+            {
+                if (item.is_object() && item.contains("speaker") && item.contains("text") &&
+                    item["speaker"].is_string() && item["text"].is_string())
+                    replies.emplace_back(item["speaker"].get<std::string>(), item["text"].get<std::string>());
+            }
+        }
+        else if (replyJson.is_object())
+        {
+            for (auto const& [speaker, value] : replyJson.items())
+            {
+                if (value.is_string())
+                    replies.emplace_back(speaker, value.get<std::string>());
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        LLMChatMetrics::Add(LLM_COUNTER_ERROR_PARSE);
+        LOG_ERROR("module", "[LLMChat] Could not split coalesced reply: {}", e.what());
+    }
+    if (!replies.empty())
+        LLMChatMetrics::Record(LLM_HISTOGRAM_GENERATION, result.elapsed);
+
+    auto deliverAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(urand(2000, 3500));
+    uint32 delivered = 0;
+    for (LLMResponderSnapshot const& responder : snapshot.responders)
+    {
+        std::string const& name = responder.details.name;
+        auto itr = std::find_if(replies.begin(), replies.end(), [&name](auto const& reply) {
+            return reply.first.size() == name.size() &&
+                std::equal(name.begin(), name.end(), reply.first.begin(), [](char a, char b) {
+                    return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+                });
+        });
+
+        if (itr == replies.end() || itr->second.empty())
+            continue;
+
+        LLMChatCompletion completion;
+        completion.senderGuid = snapshot.senderGuid;
+        completion.responderGuid = responder.guid;
+        completion.text = itr->second;
+        completion.chatMsg = responder.chatMsg;
+        completion.deliverAt = deliverAt;
+        completion.trace = snapshot.trace;
+        Deliver(std::move(completion));
+        LogTranscript(snapshot, responder, itr->second, "group");
+
+        // Stagger the speakers so the replies read like a conversation
+        deliverAt += std::chrono::milliseconds(urand(1500, 3000));
+        ++delivered;
+    }
+
+    LLMCHAT_LOG(LLM_LOG_DETAIL, "Request #{}: coalesced reply delivered to {} of {} responders", snapshot.requestId, delivered,
+        snapshot.responders.size());
+
+    if (!delivered)
+        SendDefaultResponse(snapshot);
+}
+
+void LLMChatQueue::SendDefaultResponse(LLMChatSnapshot const& snapshot)
+{
     // List of default responses
     static const std::vector<std::string> defaultResponses = {
         "Greetings, traveler.",
@@ -520,92 +1464,111 @@ void LLMChatQueue::SendDefaultResponse(Player* responder, Player* sender)
 
     // Pick a random response
     uint32 index = urand(0, defaultResponses.size() - 1);
-    std::string response = defaultResponses[index];
 
-    uint32 delay = urand(2000, 3500);
-    responder->m_Events.AddEvent(
-        new BotResponseEvent(responder, sender, response, CHAT_MSG_SAY),
-        responder->m_Events.CalculateTime(delay)
-    );
-}
-
-uint32 LLMChatQueue::GetChatTypeFromString(const std::string& chatType, Player* responder)
-{
-    if (chatType == "Say" || chatType == "SAY")
-        return CHAT_MSG_SAY;  // 0x01
-    if (chatType == "Party" || chatType == "PARTY")
-        return CHAT_MSG_PARTY;  // 0x02
-    if (chatType == "Raid" || chatType == "RAID")
-        return CHAT_MSG_RAID;  // 0x03
-    if (chatType == "Guild" || chatType == "GUILD")
-        return CHAT_MSG_GUILD;  // 0x04
-    if (chatType == "Officer" || chatType == "OFFICER")
-    {
-        // Only use officer chat if bot has rights
-        Guild* guild = responder->GetGuild();
-        if (guild && guild->HasRankRight(responder, GR_RIGHT_OFFCHATSPEAK))
-            return CHAT_MSG_OFFICER;  // 0x05
-        return CHAT_MSG_GUILD;  // 0x04
-    }
-    if (chatType == "Yell" || chatType == "YELL")
-        return CHAT_MSG_YELL;  // 0x06
-    if (chatType == "Whisper" || chatType == "WHISPER")
-        return CHAT_MSG_WHISPER;  // 0x07
-    if (chatType == "Emote" || chatType == "EMOTE")
-        return CHAT_MSG_EMOTE;  // 0x0A
-    if (chatType == "TextEmote" || chatType == "TEXT_EMOTE")
-        return CHAT_MSG_TEXT_EMOTE;  // 0x0B
-    if (chatType == "System" || chatType == "SYSTEM")
-        return CHAT_MSG_SYSTEM;  // 0x00
-    if (chatType == "PartyLeader" || chatType == "PARTY_LEADER")
-    {
-        // If message was in party leader chat but bot isn't leader, use regular party chat
-        Group* group = responder->GetGroup();
-        if (group && group->IsLeader(responder->GetGUID()))
-            return CHAT_MSG_PARTY_LEADER;  // 0x33
-        return CHAT_MSG_PARTY;  // 0x02
-    }
-    if (chatType == "RaidLeader" || chatType == "RAID_LEADER")
-    {
-        // Only use raid leader chat if bot is raid leader
-        Group* group = responder->GetGroup();
-        if (group && group->IsLeader(responder->GetGUID()) && group->isRaidGroup())
-            return CHAT_MSG_RAID_LEADER;  // 0x27
-        return CHAT_MSG_RAID;  // 0x03
-    }
-    if (chatType == "RaidWarning" || chatType == "RAID_WARNING")
-    {
-        // Only use raid warning if bot is raid leader or assistant
-        Group* group = responder->GetGroup();
-        if (group && (group->IsLeader(responder->GetGUID()) || group->IsAssistant(responder->GetGUID())) && group->isRaidGroup())
-            return CHAT_MSG_RAID_WARNING;  // 0x28
-        return CHAT_MSG_RAID;  // 0x03
-    }
-    if (chatType == "Battleground" || chatType == "BG")
-        return CHAT_MSG_BATTLEGROUND;  // 0x2C
-    if (chatType == "BattlegroundLeader" || chatType == "BG_LEADER")
-    {
-        // Only use BG leader chat if bot is BG leader
-        if (Battleground* bg = responder->GetBattleground())
+    LLMChatCompletion completion;
+    completion.senderGuid = snapshot.senderGuid;
+    completion.responderGuid = snapshot.responders.front().guid;
+    completion.text = defaultResponses[index];
+    completion.chatMsg = CHAT_MSG_SAY;
+    completion.deliverAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(urand(2000, 3500));
+    completion.trace = snapshot.trace;
+    if (snapshot.trace)
+        snapshot.trace->SetOutcome("fallback");
+    LLMChatMetrics::Add(LLM_COUNTER_FALLBACKS);
+    Deliver(std::move(completion));
+}
+
+void LLMChatQueue::Deliver(LLMChatCompletion&& completion)
+{
+    completion.readyAt = std::chrono::steady_clock::now();
+    if (!s_completions || !s_completions->TryPush(std::move(completion)))
+    {
+        ++s_completionsDropped;
+        LOG_ERROR("module", "[LLMChat] Completion mailbox is full, dropping a reply");
+    }
+}
+
+void LLMChatQueue::ProcessCompletions()
+{
+    if (!s_completions)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    while (std::optional<LLMChatCompletion> completion = s_completions->TryPop())
+    {
+        // The bot may have logged out or changed maps while the reply was generated
+        Player* responder = ObjectAccessor::FindPlayer(ObjectGuid(completion->responderGuid));
+        if (!responder || !responder->IsInWorld())
+            continue;
+
+        Player* sender = ObjectAccessor::FindPlayer(ObjectGuid(completion->senderGuid));
+        uint64 delay = completion->deliverAt > now
+            ? std::chrono::duration_cast<std::chrono::milliseconds>(completion->deliverAt - now).count() : 0;
+        LLMChatMetrics::Record(LLM_HISTOGRAM_DELIVERY, std::max(completion->deliverAt, now) - completion->readyAt);
+        if (completion->trace)
+            completion->trace->AddDelivery(completion->readyAt, std::max(completion->deliverAt, now));
+
+        responder->m_Events.AddEvent(
+            new BotResponseEvent(responder, sender, std::move(completion->text), completion->chatMsg),
+            responder->m_Events.CalculateTime(delay)
+        );
+    }
+}
+
+uint32 LLMChatQueue::GetReplyChatMsg(LLMChatType chatType, Player* responder)
+{
+    switch (chatType)
+    {
+        case LLM_CHAT_YELL:         return CHAT_MSG_YELL;
+        case LLM_CHAT_EMOTE:        return CHAT_MSG_EMOTE;
+        case LLM_CHAT_TEXT_EMOTE:   return CHAT_MSG_TEXT_EMOTE;
+        case LLM_CHAT_WHISPER:      return CHAT_MSG_WHISPER;
+        case LLM_CHAT_PARTY:        return CHAT_MSG_PARTY;
+        case LLM_CHAT_RAID:         return CHAT_MSG_RAID;
+        case LLM_CHAT_BATTLEGROUND: return CHAT_MSG_BATTLEGROUND;
+        case LLM_CHAT_GUILD:        return CHAT_MSG_GUILD;
+        case LLM_CHAT_CHANNEL:      return CHAT_MSG_CHANNEL;
+        case LLM_CHAT_OFFICER:
+        {
+            // Only use officer chat if bot has rights
+            Guild* guild = responder->GetGuild();
+            if (guild && guild->HasRankRight(responder, GR_RIGHT_OFFCHATSPEAK))
+                return CHAT_MSG_OFFICER;
+            return CHAT_MSG_GUILD;
+        }
+        case LLM_CHAT_PARTY_LEADER:
         {
-            // Check if player is the leader using group leader status in battleground
+            // If message was in party leader chat but bot isn't leader, use regular party chat
             Group* group = responder->GetGroup();
             if (group && group->IsLeader(responder->GetGUID()))
-                return CHAT_MSG_BATTLEGROUND_LEADER;  // 0x2D
+                return CHAT_MSG_PARTY_LEADER;
+            return CHAT_MSG_PARTY;
+        }
+        case LLM_CHAT_RAID_LEADER:
+        {
+            // Only use raid leader chat if bot is raid leader
+            Group* group = responder->GetGroup();
+            if (group && group->IsLeader(responder->GetGUID()) && group->isRaidGroup())
+                return CHAT_MSG_RAID_LEADER;
+            return CHAT_MSG_RAID;
         }
-        return CHAT_MSG_BATTLEGROUND;  // 0x2C
-    }
-    
-    // All channel-based chat types use CHAT_MSG_CHANNEL (0x11)
-    if (chatType == "Trade" || chatType == "TRADE" ||
-        chatType == "LFG" || chatType == "LookingForGroup" ||
-        chatType == "LocalDefense" || chatType == "LOCAL_DEFENSE" ||
-        chatType == "WorldDefense" || chatType == "WORLD_DEFENSE" ||
-        chatType == "General" || chatType == "GENERAL" ||
-        chatType == "Channel" || chatType == "CHANNEL")
-        return CHAT_MSG_CHANNEL;  // 0x11
-
-    // Default to SAY if unknown
-    LOG_DEBUG("module", "[LLMChat] Unknown chat type '{}', defaulting to SAY", chatType);
-    return CHAT_MSG_SAY;  // 0x01
+        case LLM_CHAT_RAID_WARNING:
+        {
+            // Only use raid warning if bot is raid leader or assistant
+            Group* group = responder->GetGroup();
+            if (group && (group->IsLeader(responder->GetGUID()) || group->IsAssistant(responder->GetGUID())) && group->isRaidGroup())
+                return CHAT_MSG_RAID_WARNING;
+            return CHAT_MSG_RAID;
+        }
+        case LLM_CHAT_BATTLEGROUND_LEADER:
+        {
+            // Only use BG leader chat if bot is BG leader, by its group leader status in the battleground
+            Group* group = responder->GetGroup();
+            if (responder->GetBattleground() && group && group->IsLeader(responder->GetGUID()))
+                return CHAT_MSG_BATTLEGROUND_LEADER;
+            return CHAT_MSG_BATTLEGROUND;
+        }
+        default:
+            return CHAT_MSG_SAY;
+    }
 } 
\ No newline at end of file
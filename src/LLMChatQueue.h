@@ -8,34 +8,157 @@
 #include "Log.h"
 #include "mod-llm-chat.h"
 #include "Playerbots.h"
+#include "LLMChatCharacter.h"
 #include "LLMChatEvents.h"
-#include <queue>
+#include "LLMChatRing.h"
+#include "LLMChatSimilarity.h"
+#include "mod-llm-chat-config.h"
+#include <array>
+#include <chrono>
+#include <deque>
 #include <string>
+#include <string_view>
 #include <mutex>
 #include <memory>
 #include <atomic>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+#include <condition_variable>
 
 // Forward declarations
 class BotResponseEvent;
+struct LLMHttpRequest;
+struct LLMHttpResult;
+struct LLMBackend;
+struct LLMGenerationStats;
+struct LLMPromptContext;
+struct LLMStreamState;
+struct LLMGroupStreamState;
+class LLMChatHedgePolicy;
+class LLMPromptTemplate;
+class LLMTrace;
 
-struct LLMRequest
+// One bot answering a queued message, captured on the world thread
+struct LLMResponderSnapshot
 {
-    Player* responder;
+    uint64 guid = 0;
+    CharacterDetails details;
+    uint32 chatMsg = 0;     // ChatMsg the reply is posted in, resolved against the bot's guild and group
+};
+
+// One sender talking to one bot in one channel; a newer message supersedes older ones
+struct LLMConversationKey
+{
+    uint64 senderGuid = 0;
+    uint64 responderGuid = 0;       // Leading responder of a coalesced generation
+    LLMChatType chatType = LLM_CHAT_SAY;
+
+    bool operator==(LLMConversationKey const& other) const
+    {
+        return senderGuid == other.senderGuid && responderGuid == other.responderGuid && chatType == other.chatType;
+    }
+};
+
+struct LLMConversationKeyHash
+{
+    size_t operator()(LLMConversationKey const& key) const
+    {
+        size_t hash = std::hash<uint64>()(key.senderGuid);
+        hash ^= std::hash<uint64>()(key.responderGuid) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<uint8>()(key.chatType) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+};
+
+// Latest message of a conversation and the request generating its reply, if one is in flight
+struct LLMConversation
+{
+    uint64 sequence = 0;
+    std::shared_ptr<LLMHttpRequest> request;
+};
+
+// Everything a generation needs, read from the game on the world thread when the
+// message is queued. Immutable once queued, so any thread may use it without
+// touching a Player.
+struct LLMChatSnapshot
+{
+    // Releases the conversation once nothing refers to its latest message any more, and
+    // stops sampling the players' presence for it
+    ~LLMChatSnapshot();
+
+    LLMConversationKey GetConversationKey() const
+    {
+        return { senderGuid, responders.empty() ? 0 : responders.front().guid, chatType };
+    }
+
+    uint64 senderGuid = 0;
+    CharacterDetails sender;
+    std::vector<LLMResponderSnapshot> responders;   // Several for a coalesced generation
     std::string message;
-    uint32 chatType;
-    BotResponseEvent* responseEvent;
+    LLMChatType chatType = LLM_CHAT_SAY;
+    uint64 sequence = 0;    // Order within its conversation; 0 when superseding is off
+    uint64 requestId = 0;   // Names the request in the log, the transcript and the trace
+    std::shared_ptr<LLMTrace> trace;    // Null unless LLMChat.Trace.File is set
+    // Queue wait and generation together must fit before it, or the reply is abandoned
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
 };
 
 struct QueuedResponse
 {
-    uint64 senderGuid;
-    uint64 responderGuid;
-    std::string message;
-    std::string personality;
+    std::shared_ptr<LLMChatSnapshot const> snapshot;
+    LLMChatPriority priority;
+    std::chrono::steady_clock::time_point enqueueTime;
 
-    QueuedResponse(uint64 sender, uint64 responder, std::string const& msg, std::string const& pers)
-        : senderGuid(sender), responderGuid(responder), message(msg), personality(pers) {}
+    QueuedResponse(std::shared_ptr<LLMChatSnapshot const> snap, LLMChatPriority prio)
+        : snapshot(std::move(snap)), priority(prio), enqueueTime(std::chrono::steady_clock::now()) {}
+};
+
+// A finished chat line on its way back to the world thread
+struct LLMChatCompletion
+{
+    uint64 senderGuid = 0;
+    uint64 responderGuid = 0;
+    std::string text;
+    uint32 chatMsg = 0;
+    std::chrono::steady_clock::time_point deliverAt;    // Earliest time the line may be posted
+    std::chrono::steady_clock::time_point readyAt;      // Set by Deliver
+    std::shared_ptr<LLMTrace> trace;
+};
+
+// Where a generated reply is filed once it arrives
+struct LLMReplyCacheKeys
+{
+    std::string exact;                  // Exact-match cache key; empty when that cache is off
+    uint64 profile = 0;                 // Similarity cache profile; 0 when that cache is off
+    LLMMessageFingerprint fingerprint;
+};
+
+// A prompt laid out for the backend's prompt cache. `system` holds the fixed rules followed
+// by what only changes with the responding bot, so consecutive requests share an evaluated
+// prefix; everything specific to the message goes in `user`.
+struct LLMPrompt
+{
+    std::string system;
+    std::string user;
+    uint32 tokens = 0;      // Estimated, system and user together
+    uint32 maxTokens = 0;   // Generation limit (num_predict); 0 leaves the backend's default
+    bool stop = false;      // Send the configured stop sequences
+};
+
+struct LLMPriorityClassStats
+{
+    std::atomic<uint64> enqueued{0};
+    std::atomic<uint64> dispatched{0};
+    std::atomic<uint64> dropped{0};     // Class queue was full
+    std::atomic<uint64> expired{0};     // Waited longer than the class max age
+    std::atomic<uint64> shed{0};        // Refused above the high-water mark
+    std::atomic<uint64> preempted{0};   // Evicted to make room for a higher class
+    std::atomic<uint64> superseded{0};  // Dropped from the queue for a newer message in the same conversation
+    std::atomic<uint64> cancelled{0};   // Aborted in flight for a newer message in the same conversation
+    std::atomic<uint64> abandoned{0};   // Sender or responder went offline, out of range or left the group
+    std::atomic<uint64> timedOut{0};    // Generation ran past the deadline
+    std::atomic<uint32> queued{0};
 };
 
 class LLMChatQueue
@@ -43,23 +166,108 @@ class LLMChatQueue
 public:
     static bool Initialize();
     static void Shutdown();
-    static void EnqueueResponse(Player* responder, std::string const& message, std::string const& chatType);
+    // `chatMsg` is the ChatMsg the message was said in
+    static void EnqueueResponse(Player* sender, Player* responder, std::string const& message, uint32 chatMsg);
+    // Queues one message for several bots, subject to the rate limiter, coalescing them into
+    // shared generations when enabled
+    static void EnqueueGroupResponse(Player* sender, std::vector<Player*> const& responders, std::string const& message,
+        uint32 chatMsg);
+
+    // World thread only: posts the replies finished since the last tick
+    static void ProcessCompletions();
+
+    static LLMChatType GetChatType(uint32 chatMsg);
+    static char const* GetChatTypeName(LLMChatType chatType);
+    static LLMChatPriority GetPriorityClass(LLMChatType chatType);
+    static LLMPriorityClassStats const& GetClassStats(LLMChatPriority priority) { return s_classStats[priority]; }
 
 private:
+    friend struct LLMChatSnapshot;
+
     static void ProcessQueueWorker();
-    static void QueryLLM(std::string const& message, Player* responder, Player* sender, std::string const& chatType);
-    static void SendDefaultResponse(Player* responder, Player* sender);
-    static uint32 GetChatTypeFromString(const std::string& chatType, Player* responder);
+    static void DrainIngress();
+    static void WaitForWork();
+    static void Wake();
+    static void Admit(QueuedResponse&& response);
+    static bool Evict(LLMChatPriority lowestAllowed, LLMChatPriority above);
+    static void Shed(QueuedResponse const& response);
+    static void DispatchPending();
+    static void ReportClassStats();
+    static void DispatchResponse(QueuedResponse const& response);
+    static LLMResponderSnapshot CaptureResponder(Player* responder, LLMChatType chatType);
+    static bool Push(QueuedResponse&& response);
+    // Makes the snapshot the latest message of its conversation, aborting the older one's request
+    static void Supersede(LLMChatSnapshot& snapshot);
+    static bool IsSuperseded(LLMChatSnapshot const& snapshot);
+    static void TrackRequest(LLMChatSnapshot const& snapshot, std::shared_ptr<LLMHttpRequest> const& request);
+    static void ForgetConversation(LLMChatSnapshot const& snapshot);
+    // World thread: aborts the requests in flight for a player who just went offline
+    static void CancelConversationsWith(uint64 guid);
+    static bool IsAudiencePresent(LLMChatSnapshot const& snapshot);
+    // Cancelled and timed out replies are dropped without a fallback line
+    static bool IsDiscarded(LLMHttpResult const& result, LLMChatSnapshot const& snapshot);
+    static void QueryLLM(std::shared_ptr<LLMChatSnapshot const> const& snapshot);
+    static void QueryLLMGroup(std::shared_ptr<LLMChatSnapshot const> const& snapshot);
+    // Routes a new request to a backend; sends the fallback reply and returns null when none is available
+    static std::shared_ptr<LLMHttpRequest> CreateRequest(LLMChatSnapshot const& snapshot);
+    static LLMPrompt BuildPrompt(LLMChatSnapshot const& snapshot, LLMBackend const& backend);
+    static LLMPrompt BuildGroupPrompt(LLMChatSnapshot const& snapshot, LLMBackend const& backend);
+    // Prompt tokens `backend` can take next to a generation of `maxTokens`
+    static uint32 GetPromptBudget(LLMConfig const& config, LLMBackend const& backend, uint32 maxTokens);
+    // Renders both templates, trimming {{#trim.N}} sections level by level until the estimate fits
+    static void RenderPrompt(LLMPromptTemplate const& system, LLMPromptTemplate const& user, LLMPromptContext& context,
+        uint32 budget, LLMPrompt& prompt);
+    // Request body in the format the backend's API expects; `json` asks for a JSON-only reply
+    static std::string BuildRequestBody(LLMBackend const& backend, LLMPrompt const& prompt, bool stream, bool json);
+    // Hands the timings to the backend's counters and logs the request's token counts
+    static void RecordTokens(LLMBackend& backend, uint32 estimatedPromptTokens, LLMGenerationStats const& stats);
+    static void HandleLLMResponse(LLMHttpResult const& result, LLMChatSnapshot const& snapshot, LLMReplyCacheKeys const& cacheKeys,
+        uint32 promptTokens);
+    // `stream` holds the text decoded so far when the generation was streamed
+    static void HandleGroupResponse(LLMHttpResult const& result, LLMChatSnapshot const& snapshot, uint32 promptTokens,
+        LLMGroupStreamState* stream);
+    static void HandleStreamChunk(LLMStreamState& state, std::string_view chunk);
+    static void HandleStreamComplete(LLMStreamState& state, LLMHttpResult const& result);
+    static void DeliverStreamLines(LLMStreamState& state, std::vector<std::string> const& lines);
+    static void StoreReply(LLMReplyCacheKeys const& cacheKeys, LLMChatSnapshot const& snapshot, std::string const& reply);
+    static void SendCachedResponse(std::string const& reply, std::shared_ptr<LLMChatSnapshot const> const& snapshot);
+    // `promptTokens` is the prompt's estimated size, logged next to what the backend reports
+    static bool ExtractResponseText(LLMHttpResult const& result, uint64 requestId, uint32 promptTokens, std::string& text);
+    // The same for a streamed generation whose text was decoded as it arrived
+    static bool ExtractStreamedText(LLMHttpResult const& result, uint64 requestId, uint32 promptTokens,
+        LLMGroupStreamState& stream, std::string& text);
+    static void SendDefaultResponse(LLMChatSnapshot const& snapshot);
+    // Any thread: hands a finished line to the completion mailbox
+    static void Deliver(LLMChatCompletion&& completion);
+    // ChatMsg the responder answers in, as far as its guild and group rank allow
+    static uint32 GetReplyChatMsg(LLMChatType chatType, Player* responder);
+
+    // Ingress rings, one per producer shard; only the worker thread pops from them
+    static std::vector<std::unique_ptr<LLMChatRing<QueuedResponse>>> s_ingress;
+    static std::atomic<uint32> s_nextShard;
+    // Drained messages waiting for engine capacity, one FIFO per priority class; owned by the worker thread
+    static std::array<std::deque<QueuedResponse>, LLM_PRIORITY_COUNT> responses;
+    // Finished lines from the engine threads; only the world thread pops from it
+    static std::unique_ptr<LLMChatRing<LLMChatCompletion>> s_completions;
+    static std::atomic<uint64> s_completionsDropped;
+    static std::atomic<uint64> s_nextRequestId;
+    static std::array<LLMPriorityClassStats, LLM_PRIORITY_COUNT> s_classStats;
+    // Latency history and hedge budget per class; kept across restarts like the mailbox
+    static std::array<std::unique_ptr<LLMChatHedgePolicy>, LLM_PRIORITY_COUNT> s_hedging;
+    static uint32 s_queuedTotal;
+    // Latest message per conversation; shared by the map, worker and engine threads
+    static std::unordered_map<LLMConversationKey, LLMConversation, LLMConversationKeyHash> s_conversations;
+    static std::mutex s_conversationMutex;
+    static std::atomic<uint64> s_nextSequence;
 
-    static std::queue<QueuedResponse> responses;
     static std::mutex m_mutex;
-    static bool m_initialized;
-    static bool m_running;
+    static std::condition_variable m_wakeCondition;
+    static std::atomic<bool> m_wakePending;
+    static std::atomic<bool> m_initialized;
+    static std::atomic<bool> m_running;
     static std::atomic<bool> m_processingQueue;
     static std::thread m_workerThread;
     static LLMChatQueue* s_instance;
-    static std::queue<std::shared_ptr<LLMRequest>> s_requestQueue;
-    static std::mutex s_queueMutex;
 };
 
 #endif 
\ No newline at end of file
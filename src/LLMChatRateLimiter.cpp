@@ -0,0 +1,227 @@
+#include "LLMChatRateLimiter.h"
+#include "mod-llm-chat-config.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+// Static member initialization
+LLMChatRateLimiter::TokenBucket LLMChatRateLimiter::s_global;
+std::unordered_map<uint64, LLMChatRateLimiter::TokenBucket> LLMChatRateLimiter::s_senders;
+std::unordered_map<uint64, LLMChatRateLimiter::TokenBucket> LLMChatRateLimiter::s_bots;
+std::array<std::vector<LLMChatRateLimiter::WheelEntry>, LLMChatRateLimiter::WHEEL_SLOTS> LLMChatRateLimiter::s_wheel;
+uint64 LLMChatRateLimiter::s_wheelTick = 0;
+std::mutex LLMChatRateLimiter::s_mutex;
+std::array<std::atomic<uint64>, LLM_RATE_LIMIT_COUNT> LLMChatRateLimiter::s_rejected{};
+
+LLMChatRateLimiter::BucketConfig LLMChatRateLimiter::MakeBucket(uint32 cooldownMs, uint32 burst)
+{
+    BucketConfig config;
+    config.capacity = std::max<uint32>(1, burst);
+    config.refillPerMs = cooldownMs ? 1.0 / cooldownMs : 0.0;
+    return config;
+}
+
+void LLMChatRateLimiter::Initialize()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    s_global.tokens = std::max<uint32>(1, config->Queue.GlobalBurst);
+    s_global.updatedMs = NowMs();
+    s_senders.clear();
+    s_bots.clear();
+    for (auto& slot : s_wheel)
+        slot.clear();
+    s_wheelTick = s_global.updatedMs / WHEEL_TICK_MS;
+
+    LOG_INFO("module", "[LLMChat] Rate limiter: {} replies per message, global burst {}, bot burst {}, sender burst {}",
+        config->Queue.MaxResponses, config->Queue.GlobalBurst, config->Queue.BotBurst, config->Queue.SenderBurst);
+}
+
+void LLMChatRateLimiter::Shutdown()
+{
+    ReportStats();
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_senders.clear();
+    s_bots.clear();
+    for (auto& slot : s_wheel)
+        slot.clear();
+}
+
+uint64 LLMChatRateLimiter::NowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double LLMChatRateLimiter::Available(TokenBucket const& bucket, BucketConfig const& config, uint64 nowMs)
+{
+    return std::min(config.capacity, bucket.tokens + (nowMs - bucket.updatedMs) * config.refillPerMs);
+}
+
+void LLMChatRateLimiter::Take(TokenBucket& bucket, BucketConfig const& config, uint64 nowMs, double tokens)
+{
+    bucket.tokens = Available(bucket, config, nowMs) - tokens;
+    bucket.updatedMs = nowMs;
+}
+
+void LLMChatRateLimiter::Schedule(uint64 guid, bool bot, TokenBucket& bucket, BucketConfig const& config)
+{
+    // First tick at which the bucket has refilled completely
+    double fullMs = bucket.updatedMs + (config.capacity - bucket.tokens) / config.refillPerMs;
+    uint64 tick = static_cast<uint64>(std::ceil(fullMs / WHEEL_TICK_MS));
+    tick = std::max(tick, s_wheelTick + 1);
+
+    // An earlier entry for the same bucket is left behind and ignored once its tick comes up
+    bucket.fullTick = tick;
+    s_wheel[tick & WHEEL_MASK].push_back({ guid, tick, bot });
+}
+
+void LLMChatRateLimiter::Advance(uint64 nowMs)
+{
+    uint64 target = nowMs / WHEEL_TICK_MS;
+    if (target <= s_wheelTick)
+        return;
+
+    // After a long idle stretch one pass over the wheel covers everything that is due
+    uint64 steps = std::min<uint64>(target - s_wheelTick, WHEEL_SLOTS);
+    for (uint64 step = 1; step <= steps; ++step)
+    {
+        std::vector<WheelEntry>& slot = s_wheel[(s_wheelTick + step) & WHEEL_MASK];
+        slot.erase(std::remove_if(slot.begin(), slot.end(), [target](WheelEntry const& entry)
+        {
+            // Entries more than one revolution ahead stay for a later pass
+            if (entry.tick > target)
+                return false;
+
+            auto& buckets = entry.bot ? s_bots : s_senders;
+            auto itr = buckets.find(entry.guid);
+            if (itr != buckets.end() && itr->second.fullTick == entry.tick)
+                buckets.erase(itr);
+            return true;
+        }), slot.end());
+    }
+
+    s_wheelTick = target;
+}
+
+std::vector<bool> LLMChatRateLimiter::Admit(uint64 senderGuid, std::vector<uint64> const& botGuids)
+{
+    std::vector<bool> allowed(botGuids.size(), false);
+
+    // A bucket refilled at an older rate only lives until its scheduled tick, then starts full
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    BucketConfig globalConfig = MakeBucket(config->Queue.GlobalCooldown, config->Queue.GlobalBurst);
+    BucketConfig senderConfig = MakeBucket(config->Chat.ResponseCooldown * 1000, config->Queue.SenderBurst);
+    BucketConfig botConfig = MakeBucket(config->Queue.BotCooldown, config->Queue.BotBurst);
+    uint32 maxResponses = config->Queue.MaxResponses;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    uint64 now = NowMs();
+    Advance(now);
+
+    bool senderLimited = senderConfig.refillPerMs > 0.0;
+    if (senderLimited)
+    {
+        auto itr = s_senders.find(senderGuid);
+        if (itr != s_senders.end() && Available(itr->second, senderConfig, now) < 1.0)
+        {
+            Reject(LLM_RATE_LIMIT_SENDER, botGuids.size());
+            return allowed;
+        }
+    }
+
+    bool globalLimited = globalConfig.refillPerMs > 0.0;
+    double globalTokens = globalLimited ? Available(s_global, globalConfig, now) : std::numeric_limits<double>::max();
+    uint32 count = 0;
+
+    for (size_t i = 0; i < botGuids.size(); ++i)
+    {
+        if (maxResponses && count >= maxResponses)
+        {
+            Reject(LLM_RATE_LIMIT_MAX_RESPONSES);
+            continue;
+        }
+
+        if (globalTokens < 1.0)
+        {
+            Reject(LLM_RATE_LIMIT_GLOBAL);
+            continue;
+        }
+
+        if (botConfig.refillPerMs > 0.0)
+        {
+            auto [itr, inserted] = s_bots.try_emplace(botGuids[i]);
+            TokenBucket& bucket = itr->second;
+            if (inserted)
+            {
+                bucket.tokens = botConfig.capacity;
+                bucket.updatedMs = now;
+            }
+            else if (Available(bucket, botConfig, now) < 1.0)
+            {
+                Reject(LLM_RATE_LIMIT_BOT);
+                continue;
+            }
+
+            Take(bucket, botConfig, now, 1.0);
+            Schedule(botGuids[i], true, bucket, botConfig);
+        }
+
+        globalTokens -= 1.0;
+        allowed[i] = true;
+        ++count;
+    }
+
+    if (!count)
+        return allowed;
+
+    if (globalLimited)
+        Take(s_global, globalConfig, now, count);
+
+    if (senderLimited)
+    {
+        auto [itr, inserted] = s_senders.try_emplace(senderGuid);
+        if (inserted)
+        {
+            itr->second.tokens = senderConfig.capacity;
+            itr->second.updatedMs = now;
+        }
+        Take(itr->second, senderConfig, now, 1.0);
+        Schedule(senderGuid, false, itr->second, senderConfig);
+    }
+
+    return allowed;
+}
+
+char const* LLMChatRateLimiter::GetReasonName(LLMRateLimitReason reason)
+{
+    switch (reason)
+    {
+        case LLM_RATE_LIMIT_GLOBAL:        return "global";
+        case LLM_RATE_LIMIT_SENDER:        return "sender";
+        case LLM_RATE_LIMIT_BOT:           return "bot";
+        case LLM_RATE_LIMIT_MAX_RESPONSES: return "max responses";
+        default:                           return "unknown";
+    }
+}
+
+void LLMChatRateLimiter::ReportStats()
+{
+    size_t senders, bots;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        senders = s_senders.size();
+        bots = s_bots.size();
+    }
+
+    LOG_INFO("module", "[LLMChat] Rate limiter: rejected {} {}, {} {}, {} {}, {} {} - {} senders and {} bots cooling down",
+        GetRejected(LLM_RATE_LIMIT_GLOBAL), GetReasonName(LLM_RATE_LIMIT_GLOBAL),
+        GetRejected(LLM_RATE_LIMIT_SENDER), GetReasonName(LLM_RATE_LIMIT_SENDER),
+        GetRejected(LLM_RATE_LIMIT_BOT), GetReasonName(LLM_RATE_LIMIT_BOT),
+        GetRejected(LLM_RATE_LIMIT_MAX_RESPONSES), GetReasonName(LLM_RATE_LIMIT_MAX_RESPONSES),
+        senders, bots);
+}
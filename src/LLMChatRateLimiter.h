@@ -0,0 +1,82 @@
+#ifndef MOD_LLM_CHAT_RATE_LIMITER_H
+#define MOD_LLM_CHAT_RATE_LIMITER_H
+
+#include "Define.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+enum LLMRateLimitReason : uint8
+{
+    LLM_RATE_LIMIT_GLOBAL        = 0,   // Server-wide reply budget spent (GlobalCooldown)
+    LLM_RATE_LIMIT_SENDER        = 1,   // Sender talks to bots faster than ResponseCooldown
+    LLM_RATE_LIMIT_BOT           = 2,   // Bot replied within its BotCooldown
+    LLM_RATE_LIMIT_MAX_RESPONSES = 3,   // Message already has MaxResponses bots answering
+    LLM_RATE_LIMIT_COUNT
+};
+
+// Token buckets per bot, per sender and server-wide. Only buckets that are still
+// refilling are kept; each is filed in a hashed timing wheel under the tick it
+// becomes full again and dropped from there, since a full bucket behaves exactly
+// like a missing one. Checks stay O(1) however many bots have ever talked. Rates and
+// bursts come from the config snapshot of each message, so a reload applies at once.
+class LLMChatRateLimiter
+{
+public:
+    static void Initialize();
+    static void Shutdown();
+
+    // Decides which bots may answer one message; rejected bots are cleared in the returned mask.
+    // Tokens are only taken when at least one bot is allowed.
+    static std::vector<bool> Admit(uint64 senderGuid, std::vector<uint64> const& botGuids);
+
+    static uint64 GetRejected(LLMRateLimitReason reason) { return s_rejected[reason].load(std::memory_order_relaxed); }
+    static char const* GetReasonName(LLMRateLimitReason reason);
+    static void ReportStats();
+
+private:
+    struct BucketConfig
+    {
+        double capacity = 1.0;
+        double refillPerMs = 0.0;   // 0 disables the bucket
+    };
+
+    struct TokenBucket
+    {
+        double tokens = 0.0;
+        uint64 updatedMs = 0;
+        uint64 fullTick = 0;        // Wheel tick the bucket is scheduled to be dropped at
+    };
+
+    struct WheelEntry
+    {
+        uint64 guid;
+        uint64 tick;
+        bool bot;
+    };
+
+    static constexpr uint32 WHEEL_SLOTS = 512;
+    static constexpr uint32 WHEEL_MASK = WHEEL_SLOTS - 1;
+    static constexpr uint64 WHEEL_TICK_MS = 100;
+
+    static BucketConfig MakeBucket(uint32 cooldownMs, uint32 burst);
+    static uint64 NowMs();
+    static double Available(TokenBucket const& bucket, BucketConfig const& config, uint64 nowMs);
+    static void Take(TokenBucket& bucket, BucketConfig const& config, uint64 nowMs, double tokens);
+    static void Schedule(uint64 guid, bool bot, TokenBucket& bucket, BucketConfig const& config);
+    static void Advance(uint64 nowMs);
+    static void Reject(LLMRateLimitReason reason, uint64 count = 1) { s_rejected[reason].fetch_add(count, std::memory_order_relaxed); }
+
+    static TokenBucket s_global;
+    static std::unordered_map<uint64, TokenBucket> s_senders;
+    static std::unordered_map<uint64, TokenBucket> s_bots;
+    static std::array<std::vector<WheelEntry>, WHEEL_SLOTS> s_wheel;
+    static uint64 s_wheelTick;
+    static std::mutex s_mutex;
+
+    static std::array<std::atomic<uint64>, LLM_RATE_LIMIT_COUNT> s_rejected;
+};
+
+#endif // MOD_LLM_CHAT_RATE_LIMITER_H
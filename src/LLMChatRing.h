@@ -0,0 +1,99 @@
+#ifndef MOD_LLM_CHAT_RING_H
+#define MOD_LLM_CHAT_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+// Bounded lock-free queue for many producers and a single consumer.
+// Each cell carries a sequence number telling producers and the consumer
+// whose turn it is, so a push is one CAS on the tail and a pop takes no
+// atomic read-modify-write at all.
+template <typename T>
+class LLMChatRing
+{
+public:
+    explicit LLMChatRing(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        m_mask = size - 1;
+        m_cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~LLMChatRing()
+    {
+        while (TryPop())
+            ;
+    }
+
+    LLMChatRing(LLMChatRing const&) = delete;
+    LLMChatRing& operator=(LLMChatRing const&) = delete;
+
+    // Safe to call from any thread; returns false when the ring is full
+    bool TryPush(T&& value)
+    {
+        Cell* cell;
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = m_tail.load(std::memory_order_relaxed);
+        }
+
+        new (&cell->storage) T(std::move(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    std::optional<T> TryPop()
+    {
+        Cell& cell = m_cells[m_head & m_mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(m_head + 1) < 0)
+            return std::nullopt;
+
+        T* item = std::launder(reinterpret_cast<T*>(&cell.storage));
+        std::optional<T> value(std::move(*item));
+        item->~T();
+
+        cell.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+        ++m_head;
+        return value;
+    }
+
+    size_t Capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) size_t m_head = 0;
+};
+
+#endif // MOD_LLM_CHAT_RING_H
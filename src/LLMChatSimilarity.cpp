@@ -0,0 +1,215 @@
+#include "LLMChatSimilarity.h"
+#include "mod-llm-chat-config.h"
+#include "Log.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <bit>
+
+// Static member initialization
+std::unordered_map<uint64, LLMChatSimilarityCache::Profile> LLMChatSimilarityCache::s_profiles;
+std::deque<uint64> LLMChatSimilarityCache::s_profileOrder;
+std::mutex LLMChatSimilarityCache::s_mutex;
+std::array<std::atomic<uint64>, 65> LLMChatSimilarityCache::s_distanceHistogram{};
+std::atomic<uint64> LLMChatSimilarityCache::s_hits{0};
+std::atomic<uint64> LLMChatSimilarityCache::s_misses{0};
+
+static uint64 Mix(uint64 x)
+{
+    // splitmix64 finalizer, spreads the shingle hash over all 64 bits
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static uint64 HashBytes(char const* data, size_t length)
+{
+    uint64 hash = 0xcbf29ce484222325ULL;    // FNV-1a
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void LLMChatSimilarityCache::Initialize()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (config->Similarity.Enable)
+        LOG_INFO("module", "[LLMChat] Similarity cache enabled - threshold {:.2f} (up to {} differing bits)",
+            config->Similarity.Threshold, config->Similarity.MaxDistance);
+}
+
+bool LLMChatSimilarityCache::IsEnabled()
+{
+    return sLLMConfig->Similarity.Enable;
+}
+
+bool LLMChatSimilarityCache::IsLongEnough(std::string const& normalizedMessage)
+{
+    // Normalized text is words separated by single spaces
+    if (normalizedMessage.empty())
+        return false;
+    size_t tokens = std::count(normalizedMessage.begin(), normalizedMessage.end(), ' ') + 1;
+    return tokens >= sLLMConfig->Similarity.MinTokens;
+}
+
+void LLMChatSimilarityCache::Shutdown()
+{
+    ReportStats();
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_profiles.clear();
+    s_profileOrder.clear();
+    for (auto& bucket : s_distanceHistogram)
+        bucket = 0;
+    s_hits = 0;
+    s_misses = 0;
+}
+
+LLMMessageFingerprint LLMChatSimilarityCache::Fingerprint(std::string const& normalizedMessage)
+{
+    LLMMessageFingerprint fingerprint;
+    fingerprint.textHash = HashBytes(normalizedMessage.data(), normalizedMessage.size());
+
+    // Stretched letters ("heyyy", "sooo") collapse to one, and the text is padded so
+    // one- and two-letter messages still yield shingles
+    std::string text = " ";
+    for (char c : normalizedMessage)
+    {
+        if (text.back() != c)
+            text += c;
+    }
+    text += ' ';
+
+    int32 weights[64] = {};
+    for (size_t i = 0; i + 3 <= text.size(); ++i)
+    {
+        uint64 hash = Mix(HashBytes(text.data() + i, 3));
+        for (uint32 bit = 0; bit < 64; ++bit)
+            weights[bit] += (hash >> bit) & 1 ? 1 : -1;
+    }
+
+    for (uint32 bit = 0; bit < 64; ++bit)
+    {
+        if (weights[bit] > 0)
+            fingerprint.simhash |= uint64(1) << bit;
+    }
+    return fingerprint;
+}
+
+uint64 LLMChatSimilarityCache::HashProfile(std::string const& profile)
+{
+    return HashBytes(profile.data(), profile.size());
+}
+
+bool LLMChatSimilarityCache::Lookup(uint64 profile, LLMMessageFingerprint const& fingerprint, bool skipExact, std::string& reply)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Similarity.Enable)
+        return false;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    auto found = s_profiles.find(profile);
+    if (found == s_profiles.end())
+    {
+        ++s_misses;
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    Entry const* best = nullptr;
+    uint32 bestDistance = 65;
+    for (Entry const& entry : found->second.entries)
+    {
+        if (entry.expiry <= now || (skipExact && entry.textHash == fingerprint.textHash))
+            continue;
+
+        uint32 distance = static_cast<uint32>(std::popcount(entry.simhash ^ fingerprint.simhash));
+        if (distance < bestDistance)
+        {
+            best = &entry;
+            bestDistance = distance;
+        }
+    }
+
+    if (!best)
+    {
+        ++s_misses;
+        return false;
+    }
+
+    ++s_distanceHistogram[bestDistance];
+    if (bestDistance > config->Similarity.MaxDistance)
+    {
+        ++s_misses;
+        return false;
+    }
+
+    reply = best->reply;
+    ++s_hits;
+    return true;
+}
+
+void LLMChatSimilarityCache::Store(uint64 profile, LLMMessageFingerprint const& fingerprint, std::string const& reply)
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Similarity.Enable || reply.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    auto [itr, inserted] = s_profiles.try_emplace(profile);
+    if (inserted)
+    {
+        s_profileOrder.push_back(profile);
+        while (s_profileOrder.size() > config->Similarity.MaxProfiles)
+        {
+            s_profiles.erase(s_profileOrder.front());
+            s_profileOrder.pop_front();
+        }
+    }
+
+    Entry entry;
+    entry.simhash = fingerprint.simhash;
+    entry.textHash = fingerprint.textHash;
+    entry.reply = reply;
+    entry.expiry = std::chrono::steady_clock::now() + config->Similarity.TTL;
+
+    Profile& bucket = itr->second;
+    uint32 entriesPerProfile = config->Similarity.EntriesPerProfile;
+    if (bucket.entries.size() < entriesPerProfile)
+        bucket.entries.push_back(std::move(entry));
+    else
+    {
+        bucket.entries[bucket.next] = std::move(entry);
+        bucket.next = (bucket.next + 1) % entriesPerProfile;
+    }
+}
+
+void LLMChatSimilarityCache::ReportStats()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Similarity.Enable)
+        return;
+
+    uint64 hits = s_hits;
+    uint64 misses = s_misses;
+    LOG_INFO("module", "[LLMChat] Similarity cache: {:.1f}% hit ratio ({} hits, {} misses), threshold {:.2f}",
+        hits + misses ? 100.0 * hits / (hits + misses) : 0.0, hits, misses, 1.0 - config->Similarity.MaxDistance / 64.0);
+
+    // Best-match similarity of each lookup, to see where a threshold would cut
+    std::string histogram;
+    for (uint32 distance = 0; distance <= 64; ++distance)
+    {
+        if (uint64 count = s_distanceHistogram[distance])
+            histogram += fmt::format(" {:.2f}:{}", 1.0 - distance / 64.0, count);
+    }
+
+    if (!histogram.empty())
+        LOG_INFO("module", "[LLMChat] Similarity scores (score:lookups):{}", histogram);
+}
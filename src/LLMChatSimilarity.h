@@ -0,0 +1,70 @@
+#ifndef MOD_LLM_CHAT_SIMILARITY_H
+#define MOD_LLM_CHAT_SIMILARITY_H
+
+#include "Define.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Locality-sensitive fingerprint of one chat message
+struct LLMMessageFingerprint
+{
+    uint64 simhash = 0;     // 64-bit SimHash over character shingles
+    uint64 textHash = 0;    // Exact hash of the normalized text
+};
+
+// Reuses replies to near-duplicate messages ("how are you", "how are youuu?", "how are you :)")
+// sent to characters with the same profile. Messages are reduced to a 64-bit SimHash
+// over character trigrams; similarity is the share of matching bits. Each profile
+// keeps a small ring of fingerprints, so a lookup is a handful of XOR/popcounts.
+class LLMChatSimilarityCache
+{
+public:
+    static void Initialize();
+    static void Shutdown();
+
+    static bool IsEnabled();
+    // Whether the message has enough words to be compared: between short ones a few letters
+    // decide the similarity, so "ok" and "go" would share a reply
+    static bool IsLongEnough(std::string const& normalizedMessage);
+    static LLMMessageFingerprint Fingerprint(std::string const& normalizedMessage);
+    static uint64 HashProfile(std::string const& profile);
+
+    // Finds the reply of the most similar message at or above the threshold. Exact repeats
+    // are skipped when `skipExact` is set, leaving them to the exact-match cache.
+    static bool Lookup(uint64 profile, LLMMessageFingerprint const& fingerprint, bool skipExact, std::string& reply);
+    static void Store(uint64 profile, LLMMessageFingerprint const& fingerprint, std::string const& reply);
+
+    static void ReportStats();
+
+private:
+    struct Entry
+    {
+        uint64 simhash = 0;
+        uint64 textHash = 0;
+        std::string reply;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    struct Profile
+    {
+        std::vector<Entry> entries;
+        uint32 next = 0;    // Slot overwritten by the next store once the ring is full
+    };
+
+    static std::unordered_map<uint64, Profile> s_profiles;
+    static std::deque<uint64> s_profileOrder;   // Creation order, oldest evicted first
+    static std::mutex s_mutex;
+
+    // Best-match Hamming distance of every lookup that had candidates, 0 to 64 bits
+    static std::array<std::atomic<uint64>, 65> s_distanceHistogram;
+    static std::atomic<uint64> s_hits;
+    static std::atomic<uint64> s_misses;
+};
+
+#endif // MOD_LLM_CHAT_SIMILARITY_H
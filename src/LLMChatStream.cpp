@@ -0,0 +1,297 @@
+#include "LLMChatStream.h"
+#include "LLMChatJson.h"
+#include <cctype>
+
+static std::string_view Trim(std::string_view text)
+{
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front())))
+        text.remove_prefix(1);
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back())))
+        text.remove_suffix(1);
+    return text;
+}
+
+void LLMChatStreamDecoder::Feed(std::string_view bytes, std::string& text)
+{
+    m_pending.append(bytes.data(), bytes.size());
+
+    size_t start = 0;
+    size_t newline;
+    while ((newline = m_pending.find('\n', start)) != std::string::npos)
+    {
+        ProcessLine(std::string_view(m_pending).substr(start, newline - start), text);
+        start = newline + 1;
+    }
+    m_pending.erase(0, start);
+}
+
+void LLMChatStreamDecoder::Finish(std::string& text)
+{
+    if (!m_pending.empty())
+        ProcessLine(m_pending, text);
+    m_pending.clear();
+}
+
+void LLMChatStreamDecoder::ProcessLine(std::string_view line, std::string& text)
+{
+    line = Trim(line);
+    if (line.empty() || line.front() == ':')
+        return;
+
+    // Server-sent events carry the JSON payload in "data:" fields and ignore everything else
+    if (line.rfind("data:", 0) == 0)
+        line = Trim(line.substr(5));
+    else if (line.front() != '{')
+        return;
+
+    if (line == "[DONE]")
+    {
+        m_done = true;
+        return;
+    }
+
+    // A malformed line is skipped; the rest of the stream may still be usable
+    LLMResponseChunk chunk;
+    if (!LLMResponseChunk::Parse(line, chunk, text))
+        return;
+
+    if (chunk.hasError)
+    {
+        m_error = std::move(chunk.error);
+        m_done = true;
+        return;
+    }
+
+    if (chunk.done)
+    {
+        m_done = true;
+        m_hasStats = chunk.hasStats;
+        m_stats = chunk.stats;
+    }
+}
+
+bool LLMGenerationStats::ReadMember(std::string_view key, LLMJsonReader& reader, bool& timed)
+{
+    uint64* field = key == "eval_duration" ? &outputNs
+        : key == "eval_count" ? &outputTokens
+        : key == "prompt_eval_count" ? &promptTokens
+        : key == "prompt_eval_duration" ? &promptEvalNs
+        : nullptr;
+    if (!field)
+        return false;
+
+    if (reader.ReadUint(*field) && field == &outputNs)
+        timed = true;
+    return true;
+}
+
+// Appends the string `member` of the object that comes next
+static bool ReadStringMember(LLMJsonReader& reader, std::string_view member, std::string& text)
+{
+    if (!reader.BeginObject())
+    {
+        reader.Skip();
+        return false;
+    }
+
+    bool found = false;
+    std::string_view key;
+    while (reader.NextMember(key))
+    {
+        if (!found && key == member)
+            found = reader.ReadString(text);
+        else
+            reader.Skip();
+    }
+    return found;
+}
+
+bool LLMResponseChunk::Parse(std::string_view json, LLMResponseChunk& chunk, std::string& text)
+{
+    size_t textSize = text.size();
+    LLMJsonReader reader(json);
+    if (!reader.BeginObject())
+        return false;
+
+    std::string_view key;
+    while (reader.NextMember(key))
+    {
+        if (key == "error")
+        {
+            chunk.hasError = true;
+            std::string_view raw;
+            if (reader.Peek() == LLM_JSON_STRING)
+                reader.ReadString(chunk.error);
+            else if (reader.Skip(raw))
+            {
+                // An object with a message (OpenAI-compatible servers), else the value as written
+                LLMJsonReader error(raw);
+                if (!ReadStringMember(error, "message", chunk.error))
+                    chunk.error.assign(raw);
+            }
+        }
+        // The first field with generated text wins
+        else if (!chunk.hasText && key == "response")               // Ollama /api/generate
+            chunk.hasText = reader.ReadString(text);
+        else if (!chunk.hasText && key == "message")                // Ollama /api/chat
+            chunk.hasText = ReadStringMember(reader, "content", text);
+        else if (!chunk.hasText && key == "content")                // llama.cpp /completion
+            chunk.hasText = reader.ReadString(text);
+        else if (!chunk.hasText && key == "choices")                // OpenAI-compatible
+        {
+            if (reader.BeginArray())
+            {
+                // Only the first choice; a streamed delta, a whole chat message or a completion's text
+                for (bool first = true; reader.NextElement(); first = false)
+                {
+                    if (!first || !reader.BeginObject())
+                    {
+                        reader.Skip();
+                        continue;
+                    }
+                    std::string_view choiceKey;
+                    while (reader.NextMember(choiceKey))
+                    {
+                        if (!chunk.hasText && (choiceKey == "delta" || choiceKey == "message"))
+                            chunk.hasText = ReadStringMember(reader, "content", text);
+                        else if (!chunk.hasText && choiceKey == "text")
+                            chunk.hasText = reader.ReadString(text);
+                        else
+                            reader.Skip();
+                    }
+                }
+            }
+            else
+                reader.Skip();
+        }
+        else if (key == "done" || key == "stop")
+        {
+            bool done = false;
+            if (reader.ReadBool(done))
+                chunk.done |= done;
+        }
+        else if (!chunk.stats.ReadMember(key, reader, chunk.hasStats))
+            reader.Skip();
+    }
+
+    if (!reader.IsValid())
+    {
+        text.resize(textSize);
+        return false;
+    }
+    return true;
+}
+
+// Moves a cut back onto the start of a UTF-8 character, so a hard break never splits one
+static size_t CutAtCharacter(std::string_view text, size_t cut)
+{
+    size_t start = cut;
+    while (start > 0 && (static_cast<unsigned char>(text[start]) & 0xC0) == 0x80)
+        --start;
+    return start > 0 ? start : cut;
+}
+
+void LLMChatSentenceSplitter::Append(std::string_view text, bool lineDue, std::vector<std::string>& lines)
+{
+    // Sentences packed while the previous line waited go out once it has been shown
+    m_lineDue = lineDue;
+    if (m_lineDue && !m_line.empty())
+    {
+        lines.push_back(std::move(m_line));
+        m_line.clear();
+        m_lineDue = false;
+    }
+
+    m_buffer.append(text.data(), text.size());
+
+    size_t sentenceStart = 0;
+    // A terminator only ends a sentence once the following character is known, so stop one short
+    for (size_t i = m_scanned; i + 1 < m_buffer.size(); ++i)
+    {
+        char c = m_buffer[i];
+        bool boundary = c == '\n' ||
+            ((c == '.' || c == '!' || c == '?') && std::isspace(static_cast<unsigned char>(m_buffer[i + 1])));
+        if (!boundary)
+            continue;
+
+        Emit(std::string_view(m_buffer).substr(sentenceStart, i + 1 - sentenceStart), lines);
+        sentenceStart = i + 1;
+    }
+
+    m_buffer.erase(0, sentenceStart);
+    m_scanned = m_buffer.empty() ? 0 : m_buffer.size() - 1;
+
+    // Never hold back more than a full line waiting for punctuation
+    if (m_buffer.size() > m_maxLineLength)
+    {
+        size_t cut = m_buffer.rfind(' ', m_maxLineLength);
+        if (cut == std::string::npos || cut == 0)
+            cut = CutAtCharacter(m_buffer, m_maxLineLength);
+        Emit(std::string_view(m_buffer).substr(0, cut), lines);
+        m_buffer.erase(0, cut);
+        m_scanned = 0;
+    }
+}
+
+void LLMChatSentenceSplitter::Flush(std::vector<std::string>& lines)
+{
+    Emit(m_buffer, lines);
+    if (!m_line.empty())
+        lines.push_back(std::move(m_line));
+
+    m_buffer.clear();
+    m_line.clear();
+    m_scanned = 0;
+    m_firstLineEmitted = false;
+    m_lineDue = false;
+}
+
+void LLMChatSentenceSplitter::Emit(std::string_view sentence, std::vector<std::string>& lines)
+{
+    sentence = Trim(sentence);
+    while (!sentence.empty())
+    {
+        if (sentence.size() <= m_maxLineLength)
+        {
+            Pack(sentence, lines);
+            return;
+        }
+
+        // Break overlong sentences on the last space that fits
+        size_t cut = sentence.rfind(' ', m_maxLineLength);
+        if (cut == std::string_view::npos || cut == 0)
+            cut = CutAtCharacter(sentence, m_maxLineLength);
+        Pack(Trim(sentence.substr(0, cut)), lines);
+        sentence = Trim(sentence.substr(cut));
+    }
+}
+
+void LLMChatSentenceSplitter::Pack(std::string_view piece, std::vector<std::string>& lines)
+{
+    if (!m_firstLineEmitted)
+    {
+        lines.emplace_back(piece);
+        m_firstLineEmitted = true;
+        m_lineDue = false;
+        return;
+    }
+
+    // While the previous line waits, sentences share the next one until it is full
+    if (!m_line.empty() && m_line.size() + 1 + piece.size() > m_maxLineLength)
+    {
+        lines.push_back(std::move(m_line));
+        m_line.clear();
+    }
+
+    if (!m_line.empty())
+        m_line += ' ';
+    m_line.append(piece.data(), piece.size());
+
+    // Once the next line is due, a completed sentence goes out at once; what follows waits behind it
+    if (m_lineDue)
+    {
+        lines.push_back(std::move(m_line));
+        m_line.clear();
+        m_lineDue = false;
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef MOD_LLM_CHAT_STREAM_H
+#define MOD_LLM_CHAT_STREAM_H
+
+#include "Define.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+class LLMJsonReader;
+
+// Timings Ollama reports along with the end of a generation
+struct LLMGenerationStats
+{
+    uint64 promptTokens = 0;        // prompt_eval_count: prompt tokens evaluated, not served from the prompt cache
+    uint64 promptEvalNs = 0;        // prompt_eval_duration
+    uint64 outputTokens = 0;        // eval_count
+    uint64 outputNs = 0;            // eval_duration
+
+    // Reads the member `key` when it is one of the timings; false, with nothing consumed, otherwise.
+    // `timed` is set when it was eval_duration and held a count of nanoseconds.
+    bool ReadMember(std::string_view key, LLMJsonReader& reader, bool& timed);
+};
+
+// The fields the module uses from one response object: a streamed line or a whole
+// non-streamed body, in any of the formats LLMChatStreamDecoder understands. Read in place,
+// without building a JSON document.
+struct LLMResponseChunk
+{
+    bool hasText = false;       // Carried generated text, possibly empty
+    bool done = false;          // Last object of the generation
+    bool hasError = false;
+    std::string error;
+    bool hasStats = false;      // Carried the generation's timings
+    LLMGenerationStats stats;
+
+    // Appends the generated text to `text`. False when `json` is not a well-formed object, in
+    // which case `text` is left as it was.
+    static bool Parse(std::string_view json, LLMResponseChunk& chunk, std::string& text);
+};
+
+// Turns a streamed response body into generated text. Understands Ollama
+// NDJSON lines ({"response": ...} or {"message": {"content": ...}}) and
+// server-sent events ("data: {...}") from OpenAI-compatible and llama.cpp servers.
+class LLMChatStreamDecoder
+{
+public:
+    // Appends raw body bytes; text decoded from every complete line is appended to `text`
+    void Feed(std::string_view bytes, std::string& text);
+    // Decodes a final line that was not terminated by a newline
+    void Finish(std::string& text);
+
+    bool IsDone() const { return m_done; }
+    std::string const& GetError() const { return m_error; }
+    // Set once the final line carried timings
+    bool HasStats() const { return m_hasStats; }
+    LLMGenerationStats const& GetStats() const { return m_stats; }
+
+private:
+    void ProcessLine(std::string_view line, std::string& text);
+
+    std::string m_pending;
+    std::string m_error;
+    LLMGenerationStats m_stats;
+    bool m_hasStats = false;
+    bool m_done = false;
+};
+
+// Cuts generated text into chat lines at sentence boundaries, never longer
+// than the client chat message limit. The first sentence is its own line so it
+// can be shown at once; a later one is emitted as soon as it is complete and the
+// next line is due, and only packed with what follows while the line before it waits.
+class LLMChatSentenceSplitter
+{
+public:
+    explicit LLMChatSentenceSplitter(size_t maxLineLength) : m_maxLineLength(maxLineLength) {}
+
+    // Appends text; every line completed by it is appended to `lines`. `lineDue` says the
+    // previous line has been shown long enough for the next one to follow.
+    void Append(std::string_view text, bool lineDue, std::vector<std::string>& lines);
+    // Emits whatever is left once the generation has finished
+    void Flush(std::vector<std::string>& lines);
+
+private:
+    void Emit(std::string_view sentence, std::vector<std::string>& lines);
+    void Pack(std::string_view piece, std::vector<std::string>& lines);
+
+    std::string m_buffer;
+    std::string m_line;             // Sentences packed so far into the next line
+    size_t m_scanned = 0;
+    size_t m_maxLineLength;
+    bool m_firstLineEmitted = false;
+    bool m_lineDue = false;
+};
+
+#endif // MOD_LLM_CHAT_STREAM_H
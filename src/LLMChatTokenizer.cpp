@@ -0,0 +1,102 @@
+#include "LLMChatTokenizer.h"
+#include <algorithm>
+#include <array>
+
+// The pieces a BPE pre-tokenizer cuts text into
+enum LLMRunClass : uint8
+{
+    RUN_PUNCT,
+    RUN_WORD,       // Letters and non-ASCII text
+    RUN_DIGIT,
+    RUN_SPACE,      // Spaces and tabs
+    RUN_NEWLINE,
+    RUN_NONE,       // Before the first byte and after the last
+    RUN_COUNT
+};
+
+// Runs longer than this are charged as if they stopped here
+static constexpr uint32 MAX_RUN_LENGTH = 63;
+
+struct LLMTokenTables
+{
+    std::array<uint8, 256> classes{};
+    std::array<uint8, 256> extra{};     // First byte of a UTF-8 sequence: non-ASCII characters tend to be tokens of their own
+    // [run][class of the byte after it][length]
+    std::array<std::array<std::array<uint8, MAX_RUN_LENGTH + 1>, RUN_COUNT>, RUN_COUNT> cost{};
+};
+
+// Common words are single tokens; longer ones split into pieces of about five letters
+static constexpr uint32 WordTokens(uint32 letters)
+{
+    return letters <= 8 ? 1 : 1 + (letters - 4) / 5;
+}
+
+static constexpr uint32 RunTokens(uint32 run, uint32 next, uint32 length)
+{
+    switch (run)
+    {
+        case RUN_WORD:    return WordTokens(length);
+        case RUN_DIGIT:   return (length + 2) / 3;
+        case RUN_PUNCT:   return (length + 1) / 2;
+        case RUN_NEWLINE: return 1;                 // A run of line breaks, blank lines included
+        case RUN_SPACE:
+            // A single space joins the word or punctuation after it; digits do not take it,
+            // and a longer run keeps all but its last space to itself. Before a line break
+            // the spaces go with it.
+            if (next == RUN_NEWLINE)
+                return 0;
+            if (next == RUN_NONE)
+                return 1;
+            return length > 1 || next == RUN_DIGIT ? 1 : 0;
+        default:
+            return 0;
+    }
+}
+
+static constexpr LLMTokenTables BuildTables()
+{
+    LLMTokenTables tables;
+    for (uint32 c = 0; c < 256; ++c)
+    {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80)
+            tables.classes[c] = RUN_WORD;
+        else if (c >= '0' && c <= '9')
+            tables.classes[c] = RUN_DIGIT;
+        else if (c == ' ' || c == '\t')
+            tables.classes[c] = RUN_SPACE;
+        else if (c == '\r' || c == '\n')
+            tables.classes[c] = RUN_NEWLINE;
+        else
+            tables.classes[c] = RUN_PUNCT;
+        tables.extra[c] = c >= 0xC0 ? 1 : 0;
+    }
+
+    for (uint32 run = 0; run < RUN_COUNT; ++run)
+        for (uint32 next = 0; next < RUN_COUNT; ++next)
+            for (uint32 length = 1; length <= MAX_RUN_LENGTH; ++length)
+                tables.cost[run][next][length] = uint8(RunTokens(run, next, length));
+    return tables;
+}
+
+static constexpr LLMTokenTables TABLES = BuildTables();
+
+uint32 LLMChatTokenizer::Estimate(std::string_view text)
+{
+    // Each run is charged once, when the byte class changes and the class after it is known
+    uint32 tokens = 0;
+    uint32 run = RUN_NONE;
+    size_t runStart = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        uint8 c = static_cast<unsigned char>(text[i]);
+        uint32 next = TABLES.classes[c];
+        tokens += TABLES.extra[c];
+        if (next != run)
+        {
+            tokens += TABLES.cost[run][next][std::min<size_t>(i - runStart, MAX_RUN_LENGTH)];
+            runStart = i;
+            run = next;
+        }
+    }
+    return tokens + TABLES.cost[run][RUN_NONE][std::min<size_t>(text.size() - runStart, MAX_RUN_LENGTH)];
+}
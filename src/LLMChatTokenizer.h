@@ -0,0 +1,19 @@
+#ifndef MOD_LLM_CHAT_TOKENIZER_H
+#define MOD_LLM_CHAT_TOKENIZER_H
+
+#include "Define.h"
+#include <string_view>
+
+// Estimates how many tokens a BPE tokenizer (Llama 3, GPT-4 style vocabularies) turns a text
+// into, without loading a vocabulary. The text is split the way those tokenizers pre-split
+// it - words with their leading space, digit groups of three, punctuation runs, newline runs -
+// and every piece is charged what the vocabulary typically makes of it: one token for a
+// word of up to eight letters, one more for every five letters after that. Good enough to
+// keep an English prompt inside a context window; it is meant for budgets, not billing.
+class LLMChatTokenizer
+{
+public:
+    static uint32 Estimate(std::string_view text);
+};
+
+#endif // MOD_LLM_CHAT_TOKENIZER_H
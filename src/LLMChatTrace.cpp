@@ -0,0 +1,384 @@
+#include "LLMChatTrace.h"
+#include "LLMChatJson.h"
+#include "LLMChatRing.h"
+#include "mod-llm-chat-config.h"
+#include "Log.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <thread>
+
+// How long a finished trace may wait in the ring before the writer picks it up
+static constexpr std::chrono::milliseconds FLUSH_INTERVAL{200};
+// The tail threshold is taken over this many of the latest requests...
+static constexpr size_t TAIL_WINDOW = 1000;
+// ...and every request is written in full until this many have finished
+static constexpr size_t TAIL_WARMUP = 100;
+// Every request is drawn under one process, on rows numbered from its ID and track
+static constexpr uint32 PROCESS_ID = 1;
+
+bool LLMChatTrace::s_enabled = false;
+
+static std::unique_ptr<LLMChatRing<LLMTrace*>> s_ring;
+static std::atomic<bool> s_accepting{false};
+static std::atomic<bool> s_stopping{false};
+static std::mutex s_wakeMutex;
+static std::condition_variable s_wakeCondition;
+static std::thread s_writerThread;
+static std::chrono::steady_clock::time_point s_epoch;
+
+// Opened at startup; the sampling settings are read from the config snapshot per trace
+static std::string s_path;
+
+// Writer thread only, or Shutdown once it has stopped
+static FILE* s_file = nullptr;
+static uint64 s_fileSize = 0;
+static std::vector<uint64> s_window;    // Total times of the latest requests, in microseconds
+static size_t s_windowNext = 0;
+static uint64 s_sampleCounter = 0;
+
+static std::atomic<uint64> s_finished{0};
+static std::atomic<uint64> s_written{0};
+static std::atomic<uint64> s_writtenInFull{0};
+static std::atomic<uint64> s_dropped{0};
+static std::atomic<uint64> s_threshold{0};
+
+LLMTrace::LLMTrace(uint64 id, std::string name, std::string_view message)
+    : m_id(id), m_name(std::move(name)), m_start(std::chrono::steady_clock::now()),
+    m_wallStart(std::chrono::system_clock::now()), m_message(message)
+{
+    m_spans.reserve(8);
+}
+
+void LLMTrace::AddSpan(char const* name, LLMTraceTrack track, std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end, std::string detail)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_spans.push_back(LLMTraceSpan{ name, track, start, std::max(start, end), std::move(detail) });
+}
+
+void LLMTrace::SetOutcome(char const* outcome)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_outcome)
+        m_outcome = outcome;
+}
+
+void LLMTrace::AddDelivery(std::chrono::steady_clock::time_point readyAt, std::chrono::steady_clock::time_point postedAt)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_deliveryStart = std::min(m_deliveryStart, readyAt);
+    m_deliveryEnd = std::max(m_deliveryEnd, postedAt);
+    ++m_lines;
+}
+
+void LLMTrace::SetPrompt(std::string_view system, std::string_view user)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_prompt.reserve(system.size() + user.size() + 1);
+    m_prompt.assign(system);
+    m_prompt += '\n';
+    m_prompt += user;
+}
+
+void LLMTrace::AddReply(std::string_view speaker, std::string_view reply)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_reply.empty())
+        m_reply += '\n';
+    m_reply += speaker;
+    m_reply += ": ";
+    m_reply += reply;
+}
+
+static uint64 ToMicros(std::chrono::steady_clock::time_point time)
+{
+    int64 micros = std::chrono::duration_cast<std::chrono::microseconds>(time - s_epoch).count();
+    return micros > 0 ? uint64(micros) : 0;
+}
+
+static uint64 ToMicros(std::chrono::steady_clock::duration duration)
+{
+    int64 micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    return micros > 0 ? uint64(micros) : 0;
+}
+
+// Each event is written with the comma that separates it from the one before
+static LLMJsonWriter BeginEvent(std::string& out, char const* phase, std::string_view name, uint64 thread)
+{
+    out += ",\n";
+    LLMJsonWriter writer(out);
+    writer.BeginObject();
+    writer.Key("name").String(name);
+    writer.Key("ph").String(phase);
+    writer.Key("pid").Uint(PROCESS_ID);
+    writer.Key("tid").Uint(thread);
+    return writer;
+}
+
+static void AppendRowName(std::string& out, uint64 thread, std::string const& name)
+{
+    BeginEvent(out, "M", "thread_name", thread).Key("args").BeginObject().Key("name").String(name).EndObject().EndObject();
+    // Rows in the order the requests came in
+    BeginEvent(out, "M", "thread_sort_index", thread).Key("args").BeginObject().Key("sort_index").Uint(thread).EndObject()
+        .EndObject();
+}
+
+static LLMJsonWriter BeginSpan(std::string& out, std::string_view name, uint64 thread,
+    std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    LLMJsonWriter writer = BeginEvent(out, "X", name, thread);
+    writer.Key("ts").Uint(ToMicros(start));
+    writer.Key("dur").Uint(ToMicros(end - start));
+    return writer;
+}
+
+void LLMChatTrace::Format(std::string& out, LLMTrace const& trace, std::chrono::steady_clock::time_point end, bool full)
+{
+    uint64 firstRow = trace.GetId() * LLM_TRACE_TRACKS;
+    bool used[LLM_TRACE_TRACKS] = { true };
+    for (LLMTraceSpan const& span : trace.m_spans)
+        used[span.track] = true;
+
+    static constexpr char const* ROWS[LLM_TRACE_TRACKS] = { "", "backend", "hedge" };
+    for (uint32 track = 0; track < LLM_TRACE_TRACKS; ++track)
+    {
+        if (used[track])
+            AppendRowName(out, firstRow + track, track == LLM_TRACE_MESSAGE ? fmt::format("#{} {}", trace.GetId(), trace.m_name) :
+                fmt::format("#{} {}", trace.GetId(), ROWS[track]));
+    }
+
+    std::time_t wallStart = std::chrono::system_clock::to_time_t(trace.m_wallStart);
+    std::tm utc{};
+    gmtime_r(&wallStart, &utc);
+    char started[24];
+    std::strftime(started, sizeof(started), "%Y-%m-%d %H:%M:%S", &utc);
+
+    LLMJsonWriter root = BeginSpan(out, "request", firstRow, trace.m_start, end);
+    root.Key("args").BeginObject();
+    root.Key("id").Uint(trace.GetId());
+    root.Key("outcome").String(trace.m_outcome ? trace.m_outcome : "none");
+    root.Key("started").String(started);
+    root.Key("detail").String(full ? "full" : "timings");
+    if (full)
+    {
+        root.Key("message").String(trace.m_message);
+        if (!trace.m_prompt.empty())
+            root.Key("prompt").String(trace.m_prompt);
+        if (!trace.m_reply.empty())
+            root.Key("reply").String(trace.m_reply);
+    }
+    root.EndObject().EndObject();
+
+    for (LLMTraceSpan const& span : trace.m_spans)
+    {
+        LLMJsonWriter writer = BeginSpan(out, span.name, firstRow + span.track, span.start, span.end);
+        if (!span.detail.empty())
+            writer.Key("args").BeginObject().Key("detail").String(span.detail).EndObject();
+        writer.EndObject();
+    }
+
+    if (trace.m_lines)
+        BeginSpan(out, "delivery", firstRow, trace.m_deliveryStart, trace.m_deliveryEnd)
+            .Key("args").BeginObject().Key("lines").Uint(trace.m_lines).EndObject().EndObject();
+}
+
+static void CloseFile()
+{
+    if (!s_file)
+        return;
+
+    std::fputs("\n]\n", s_file);
+    std::fclose(s_file);
+    s_file = nullptr;
+}
+
+// Starts a new file; the previous one, from before a restart or grown past its limit, is
+// kept as .1. Closed files are complete JSON; the open one is read fine without its "]".
+static bool OpenFile()
+{
+    std::error_code error;
+    if (std::filesystem::exists(s_path, error))
+        std::filesystem::rename(s_path, s_path + ".1", error);
+
+    s_file = std::fopen(s_path.c_str(), "wb");
+    if (!s_file)
+    {
+        LOG_ERROR("module", "[LLMChat] Cannot open trace file {}, tracing disabled", s_path);
+        return false;
+    }
+
+    // The array opens in place of the first event's comma
+    std::string header;
+    BeginEvent(header, "M", "process_name", 0).Key("args").BeginObject().Key("name").String("mod-llm-chat").EndObject().EndObject();
+    header[0] = '[';
+    std::fwrite(header.data(), 1, header.size(), s_file);
+    s_fileSize = header.size();
+    return true;
+}
+
+// Whether the request is among the slowest `tailFraction` of the latest ones, itself included
+static bool IsTail(uint64 micros, double tailFraction)
+{
+    if (s_window.size() < TAIL_WINDOW)
+        s_window.push_back(micros);
+    else
+        s_window[s_windowNext] = micros;
+    s_windowNext = (s_windowNext + 1) % TAIL_WINDOW;
+
+    if (tailFraction <= 0.0)
+        return false;
+    if (s_window.size() < TAIL_WARMUP)
+        return true;
+
+    thread_local std::vector<uint64> t_sorted;
+    t_sorted = s_window;
+    size_t rank = std::min(t_sorted.size() - 1, size_t(double(t_sorted.size()) * (1.0 - tailFraction)));
+    std::nth_element(t_sorted.begin(), t_sorted.begin() + rank, t_sorted.end());
+    s_threshold.store(t_sorted[rank], std::memory_order_relaxed);
+    return micros >= t_sorted[rank];
+}
+
+void LLMChatTrace::Write(LLMTrace const& trace)
+{
+    ++s_finished;
+
+    auto end = trace.m_start;
+    for (LLMTraceSpan const& span : trace.m_spans)
+        end = std::max(end, span.end);
+    if (trace.m_lines)
+        end = std::max(end, trace.m_deliveryEnd);
+
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    bool full = IsTail(ToMicros(end - trace.m_start), config->Trace.TailFraction);
+    uint32 sampleEvery = config->Trace.SampleEvery;
+    if (!full && (!sampleEvery || ++s_sampleCounter % sampleEvery))
+        return;
+    if (!s_file)
+        return;
+
+    thread_local std::string t_text;
+    t_text.clear();
+    Format(t_text, trace, end, full);
+
+    if (config->Trace.MaxFileSize && s_fileSize + t_text.size() > config->Trace.MaxFileSize)
+    {
+        CloseFile();
+        if (!OpenFile())
+            return;
+    }
+
+    // The file opens with its own event, so every trace follows with a comma
+    std::fwrite(t_text.data(), 1, t_text.size(), s_file);
+    s_fileSize += t_text.size();
+    ++s_written;
+    if (full)
+        ++s_writtenInFull;
+}
+
+void LLMChatTrace::Drain()
+{
+    bool wrote = false;
+    while (std::optional<LLMTrace*> trace = s_ring->TryPop())
+    {
+        Write(**trace);
+        delete *trace;
+        wrote = true;
+    }
+    if (wrote && s_file)
+        std::fflush(s_file);
+}
+
+void LLMChatTrace::Initialize()
+{
+    if (s_accepting)
+        return;
+
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    s_path = config->Trace.File;
+    if (s_path.empty() || !OpenFile())
+        return;
+
+    // Kept across restarts, like the logger's ring: a trace may still be finishing on another thread
+    if (!s_ring)
+        s_ring = std::make_unique<LLMChatRing<LLMTrace*>>(4096);
+
+    s_epoch = std::chrono::steady_clock::now();
+    s_window.clear();
+    s_window.reserve(TAIL_WINDOW);
+    s_windowNext = 0;
+    s_stopping = false;
+    s_writerThread = std::thread(&LLMChatTrace::WriterThread);
+    s_accepting.store(true, std::memory_order_release);
+    s_enabled = true;
+
+    LOG_INFO("module", "[LLMChat] Tracing requests to {} - slowest {}% in full, 1 in {} of the rest as timings", s_path,
+        config->Trace.TailFraction * 100.0, config->Trace.SampleEvery);
+}
+
+void LLMChatTrace::Shutdown()
+{
+    s_enabled = false;
+    if (!s_writerThread.joinable())
+        return;
+
+    // Traces finished from here on are dropped
+    s_accepting.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(s_wakeMutex);
+        s_stopping = true;
+    }
+    s_wakeCondition.notify_one();
+    s_writerThread.join();
+
+    Drain();
+    CloseFile();
+    ReportStats();
+}
+
+std::shared_ptr<LLMTrace> LLMChatTrace::Start(uint64 id, std::string name, std::string_view message)
+{
+    if (!s_enabled)
+        return nullptr;
+    return std::shared_ptr<LLMTrace>(new LLMTrace(id, std::move(name), message), &LLMChatTrace::Finish);
+}
+
+void LLMChatTrace::Finish(LLMTrace* trace)
+{
+    // The ring is never freed, so a thread that saw it accepting may still push after Shutdown
+    // began; what it pushes then is written by Shutdown's last drain or dropped
+    if (s_accepting.load(std::memory_order_acquire))
+    {
+        if (s_ring->TryPush(std::move(trace)))
+            return;
+        s_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    delete trace;
+}
+
+void LLMChatTrace::WriterThread()
+{
+    while (true)
+    {
+        Drain();
+
+        std::unique_lock<std::mutex> lock(s_wakeMutex);
+        if (s_stopping)
+            break;
+        s_wakeCondition.wait_for(lock, FLUSH_INTERVAL, [] { return s_stopping.load(); });
+    }
+}
+
+void LLMChatTrace::ReportStats()
+{
+    if (s_path.empty())
+        return;
+
+    LOG_INFO("module", "[LLMChat] Traces: {} finished, {} written ({} in full), {} dropped while the writer was behind; "
+        "slowest requests from {}ms", s_finished.load(), s_written.load(), s_writtenInFull.load(), s_dropped.load(),
+        s_threshold.load() / 1000);
+}
@@ -0,0 +1,98 @@
+#ifndef MOD_LLM_CHAT_TRACE_H
+#define MOD_LLM_CHAT_TRACE_H
+
+#include "Define.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Row of the trace viewer a span is drawn on. Spans on one row nest; the two attempts of a
+// hedged request overlap, so each gets its own.
+enum LLMTraceTrack : uint8
+{
+    LLM_TRACE_MESSAGE,      // Queue wait, preparing the request and delivery in game
+    LLM_TRACE_ATTEMPT,      // The exchange with the backend
+    LLM_TRACE_HEDGE,        // The copy racing it on another backend
+    LLM_TRACE_TRACKS
+};
+
+struct LLMTraceSpan
+{
+    char const* name = nullptr;
+    LLMTraceTrack track = LLM_TRACE_MESSAGE;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+    std::string detail;     // Backend, status, error
+};
+
+// Timeline of one request, from EnqueueResponse to its last line said in game. Shared by
+// whatever works on the request, on any thread; the last owner to let go hands it to the
+// trace writer, which decides what to keep once the request's total time is known.
+class LLMTrace
+{
+public:
+    LLMTrace(uint64 id, std::string name, std::string_view message);
+
+    uint64 GetId() const { return m_id; }
+
+    void AddSpan(char const* name, LLMTraceTrack track, std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end, std::string detail = {});
+    // What became of the request; the first call wins, so a fallback sent for a shed message
+    // stays "shed"
+    void SetOutcome(char const* outcome);
+    // One line handed over at `readyAt` and said in game at `postedAt`
+    void AddDelivery(std::chrono::steady_clock::time_point readyAt, std::chrono::steady_clock::time_point postedAt);
+
+    // Only written out for the slowest requests
+    void SetPrompt(std::string_view system, std::string_view user);
+    void AddReply(std::string_view speaker, std::string_view reply);
+
+private:
+    friend class LLMChatTrace;
+
+    std::mutex m_mutex;
+    uint64 m_id;
+    std::string m_name;         // Row label: chat type, sender and bots
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::system_clock::time_point m_wallStart;
+    std::vector<LLMTraceSpan> m_spans;
+    char const* m_outcome = nullptr;
+    std::chrono::steady_clock::time_point m_deliveryStart = std::chrono::steady_clock::time_point::max();
+    std::chrono::steady_clock::time_point m_deliveryEnd = std::chrono::steady_clock::time_point::min();
+    uint32 m_lines = 0;
+    std::string m_message;
+    std::string m_prompt;
+    std::string m_reply;
+};
+
+// Writes finished traces to LLMChat.Trace.File in the Chrome trace-event format, which
+// Perfetto (ui.perfetto.dev) and chrome://tracing open. Every request is traced while a file
+// is configured, but only the slowest LLMChat.Trace.TailPercent are written in full, with
+// message, prompt and reply; of the rest one in LLMChat.Trace.SampleEvery keeps its timings.
+class LLMChatTrace
+{
+public:
+    static void Initialize();
+    static void Shutdown();     // Writes out what is still queued and closes the file
+
+    static bool IsEnabled() { return s_enabled; }
+    // A trace for a new request, or null while tracing is off
+    static std::shared_ptr<LLMTrace> Start(uint64 id, std::string name, std::string_view message);
+
+    static void ReportStats();
+
+private:
+    // Deleter of the traces handed out by Start
+    static void Finish(LLMTrace* trace);
+    static void WriterThread();
+    static void Drain();
+    static void Write(LLMTrace const& trace);
+    static void Format(std::string& out, LLMTrace const& trace, std::chrono::steady_clock::time_point end, bool full);
+
+    static bool s_enabled;
+};
+
+#endif // MOD_LLM_CHAT_TRACE_H
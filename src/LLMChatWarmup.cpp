@@ -0,0 +1,238 @@
+#include "LLMChatWarmup.h"
+#include "LLMChatBackends.h"
+#include "Log.h"
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <sstream>
+
+// Static member initialization
+std::chrono::steady_clock::time_point LLMChatWarmup::s_nextPing;
+std::unordered_map<LLMBackend const*, uint64> LLMChatWarmup::s_requestsAtPing;
+
+void LLMChatWarmup::Initialize()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    s_nextPing = std::chrono::steady_clock::now() + config->Warmup.PingInterval;
+    s_requestsAtPing.clear();
+
+    if (!config->Warmup.Enable)
+        return;
+
+    for (std::shared_ptr<LLMBackend> const& backend : LLMChatBackends::GetBackends())
+    {
+        Discover(backend);
+        WarmUp(backend, false, *config);
+    }
+}
+
+void LLMChatWarmup::Update()
+{
+    std::shared_ptr<LLMConfig const> config = sLLMConfig;
+    if (!config->Warmup.Enable || !config->Warmup.PingInterval.count())
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < s_nextPing)
+        return;
+    s_nextPing = now + config->Warmup.PingInterval;
+
+    // Warm-ups and pings are not counted as requests, so an idle backend stays idle here
+    for (std::shared_ptr<LLMBackend> const& backend : LLMChatBackends::GetBackends())
+    {
+        uint64 requests = backend->requests.load(std::memory_order_relaxed);
+        uint64& seen = s_requestsAtPing[backend.get()];
+        if (requests == seen)
+            WarmUp(backend, true, *config);
+        seen = requests;
+    }
+}
+
+bool LLMChatWarmup::IsOllama(LLMBackend const& backend)
+{
+    return backend.endpoint.target.rfind("/api/", 0) == 0;
+}
+
+void LLMChatWarmup::Send(std::shared_ptr<LLMBackend> const& backend, std::string const& target, std::string body,
+    std::function<void(LLMHttpResult const&)> onComplete)
+{
+    // Sent untracked: a cold model load must not count against the backend's breaker or
+    // teach its concurrency limit a baseline latency
+    auto request = std::make_shared<LLMHttpRequest>();
+    request->endpoint = backend->endpoint;
+    request->endpoint.target = target;
+    request->get = body.empty();
+    request->body = std::move(body);
+    request->onComplete = std::move(onComplete);
+    LLMChatEngine::Submit(std::move(request));
+}
+
+void LLMChatWarmup::Discover(std::shared_ptr<LLMBackend> const& backend)
+{
+    LLMBackend* target = backend.get();
+    if (IsOllama(*backend))
+    {
+        Send(backend, "/api/tags", "", [target](LLMHttpResult const& result) { OnModels(*target, result); });
+        Send(backend, "/api/show", nlohmann::json{ { "model", backend->model } }.dump(),
+            [target](LLMHttpResult const& result) { OnShow(*target, result); });
+        return;
+    }
+
+    // OpenAI-compatible servers list their models; llama.cpp also reports its slots and context
+    Send(backend, "/v1/models", "", [target](LLMHttpResult const& result) { OnModels(*target, result); });
+    Send(backend, "/props", "", [target](LLMHttpResult const& result) { OnProps(*target, result); });
+}
+
+void LLMChatWarmup::WarmUp(std::shared_ptr<LLMBackend> const& backend, bool ping, LLMConfig const& config)
+{
+    // One generated token is enough to load the model and evaluate a prompt
+    nlohmann::json body;
+    body["model"] = backend->model;
+    if (backend->api == LLM_API_GENERATE)
+        body["prompt"] = config.Warmup.Prompt;
+    else
+        body["messages"] = nlohmann::json::array({ { { "role", "user" }, { "content", config.Warmup.Prompt } } });
+    body["stream"] = false;
+    if (backend->api == LLM_API_OPENAI)
+        body["max_tokens"] = 1;
+    else
+    {
+        body["options"] = { { "num_predict", 1 } };
+        if (!config.Warmup.KeepAlive.empty())
+            body["keep_alive"] = config.Warmup.KeepAlive;
+    }
+
+    std::string name = backend->name;
+    auto start = std::chrono::steady_clock::now();
+    Send(backend, backend->endpoint.target, body.dump(), [name, start, ping](LLMHttpResult const& result)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (!result.success || result.status != 200)
+            LOG_WARN("module", "[LLMChat] Backend {}: {} failed after {}ms: {}", name, ping ? "keep-alive ping" : "warm-up",
+                elapsed, result.success ? fmt::format("HTTP {} {}", result.status, result.body) : result.error);
+        else if (ping)
+            LOG_DEBUG("module", "[LLMChat] Backend {}: keep-alive ping answered in {}ms", name, elapsed);
+        else
+            LOG_INFO("module", "[LLMChat] Backend {}: model loaded and warmed up in {}ms", name, elapsed);
+    });
+}
+
+void LLMChatWarmup::OnModels(LLMBackend& backend, LLMHttpResult const& result)
+{
+    if (!result.success || result.status != 200)
+    {
+        LOG_DEBUG("module", "[LLMChat] Backend {}: no model list ({})", backend.name,
+            result.success ? fmt::format("HTTP {}", result.status) : result.error);
+        return;
+    }
+
+    try
+    {
+        // Ollama: {"models":[{"name":...}]}; OpenAI: {"data":[{"id":...}]}
+        auto document = nlohmann::json::parse(result.body);
+        bool ollama = document.contains("models");
+        auto const& models = ollama ? document["models"] : document.value("data", nlohmann::json::array());
+        std::vector<std::string> names;
+        for (auto const& model : models)
+        {
+            std::string name = model.value(ollama ? "name" : "id", "");
+            if (!name.empty())
+                names.push_back(std::move(name));
+        }
+
+        // Ollama names an untagged model "<name>:latest"
+        bool found = std::any_of(names.begin(), names.end(), [&backend](std::string const& name) {
+            return name == backend.model || name == backend.model + ":latest";
+        });
+        if (found)
+            LOG_INFO("module", "[LLMChat] Backend {}: serves {} models, including {}", backend.name, names.size(), backend.model);
+        else
+            LOG_ERROR("module", "[LLMChat] Backend {}: model {} is not among the {} it serves; requests will fail until it is "
+                "installed", backend.name, backend.model, names.size());
+    }
+    catch (const std::exception& e)
+    {
+        LOG_DEBUG("module", "[LLMChat] Backend {}: unreadable model list: {}", backend.name, e.what());
+    }
+}
+
+void LLMChatWarmup::OnShow(LLMBackend& backend, LLMHttpResult const& result)
+{
+    if (!result.success || result.status != 200)
+        return;
+
+    try
+    {
+        auto document = nlohmann::json::parse(result.body);
+
+        // The context the model was trained with, e.g. "llama.context_length"
+        uint32 trained = 0;
+        if (document.contains("model_info") && document["model_info"].is_object())
+        {
+            auto const& info = document["model_info"];
+            std::string key = info.value("general.architecture", "") + ".context_length";
+            if (info.contains(key) && info[key].is_number_unsigned())
+                trained = info[key].get<uint32>();
+        }
+
+        // A num_ctx set in the Modelfile is what the server actually allocates
+        uint32 configured = 0;
+        std::istringstream parameters(document.value("parameters", ""));
+        std::string line;
+        while (std::getline(parameters, line))
+        {
+            std::istringstream fields(line);
+            std::string name;
+            if (fields >> name && name == "num_ctx")
+                fields >> configured;
+        }
+
+        uint32 context = configured ? configured : trained;
+        if (!context)
+            return;
+
+        backend.contextLength = context;
+        LOG_INFO("module", "[LLMChat] Backend {}: context of {} tokens (model trained for {})", backend.name, context, trained);
+    }
+    catch (const std::exception& e)
+    {
+        LOG_DEBUG("module", "[LLMChat] Backend {}: unreadable model details: {}", backend.name, e.what());
+    }
+}
+
+void LLMChatWarmup::OnProps(LLMBackend& backend, LLMHttpResult const& result)
+{
+    if (!result.success || result.status != 200)
+        return;
+
+    try
+    {
+        // llama.cpp server: {"total_slots":4,"default_generation_settings":{"n_ctx":8192}}
+        auto document = nlohmann::json::parse(result.body);
+        if (document.contains("default_generation_settings") && document["default_generation_settings"].is_object())
+        {
+            uint32 context = document["default_generation_settings"].value("n_ctx", 0u);
+            if (context)
+            {
+                backend.contextLength = context;
+                LOG_INFO("module", "[LLMChat] Backend {}: context of {} tokens", backend.name, context);
+            }
+        }
+
+        if (uint32 slots = document.value("total_slots", 0u))
+            ApplySlots(backend, slots);
+    }
+    catch (const std::exception& e)
+    {
+        LOG_DEBUG("module", "[LLMChat] Backend {}: unreadable server properties: {}", backend.name, e.what());
+    }
+}
+
+void LLMChatWarmup::ApplySlots(LLMBackend& backend, uint32 slots)
+{
+    // Requests beyond the server's slots only wait in its own queue, out of our sight
+    backend.slots = slots;
+    backend.limit.SetMaxLimit(slots);
+    LOG_INFO("module", "[LLMChat] Backend {}: {} parallel slots, concurrency limited to {}", backend.name, slots,
+        backend.limit.Get());
+}
@@ -0,0 +1,43 @@
+#ifndef MOD_LLM_CHAT_WARMUP_H
+#define MOD_LLM_CHAT_WARMUP_H
+
+#include "Define.h"
+#include "LLMChatEngine.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+struct LLMBackend;
+
+// Gets the backends ready before the first player message: asks each one what it serves
+// (models, context length, parallel slots), loads the model with a short generation and
+// keeps it loaded through quiet periods. All of it runs on the request engine, so world
+// startup does not wait for a cold model load.
+class LLMChatWarmup
+{
+public:
+    // After the engine has started
+    static void Initialize();
+    // World thread: pings the backends that had no request during the last ping interval
+    static void Update();
+
+private:
+    static bool IsOllama(LLMBackend const& backend);
+    static void Send(std::shared_ptr<LLMBackend> const& backend, std::string const& target, std::string body,
+        std::function<void(LLMHttpResult const&)> onComplete);
+    static void Discover(std::shared_ptr<LLMBackend> const& backend);
+    static void WarmUp(std::shared_ptr<LLMBackend> const& backend, bool ping, LLMConfig const& config);
+    // Response handlers; each one tolerates a backend that does not know the route
+    static void OnModels(LLMBackend& backend, LLMHttpResult const& result);
+    static void OnShow(LLMBackend& backend, LLMHttpResult const& result);
+    static void OnProps(LLMBackend& backend, LLMHttpResult const& result);
+    static void ApplySlots(LLMBackend& backend, uint32 slots);
+
+    static std::chrono::steady_clock::time_point s_nextPing;
+    // Request count of each backend at the last ping check; world thread only
+    static std::unordered_map<LLMBackend const*, uint64> s_requestsAtPing;
+};
+
+#endif // MOD_LLM_CHAT_WARMUP_H
@@ -2,14 +2,80 @@
 #define MOD_LLM_CHAT_CONFIG_H
 
 #include "Define.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
-#include <cstdint>
+#include <vector>
 
+class LLMPromptTemplates;
+
+// Dispatch order of queued messages; lower values are served first
+enum LLMChatPriority : uint8
+{
+    LLM_PRIORITY_WHISPER = 0,   // Whispers
+    LLM_PRIORITY_GROUP   = 1,   // Party, raid and battleground chat
+    LLM_PRIORITY_LOCAL   = 2,   // Say, yell and emotes
+    LLM_PRIORITY_CHANNEL = 3,   // Guild and global channels
+    LLM_PRIORITY_COUNT
+};
+
+// Chat a message was said in, mapped from its ChatMsg once when it is queued
+enum LLMChatType : uint8
+{
+    LLM_CHAT_SAY = 0,
+    LLM_CHAT_YELL,
+    LLM_CHAT_EMOTE,
+    LLM_CHAT_TEXT_EMOTE,
+    LLM_CHAT_WHISPER,
+    LLM_CHAT_PARTY,
+    LLM_CHAT_PARTY_LEADER,
+    LLM_CHAT_RAID,
+    LLM_CHAT_RAID_LEADER,
+    LLM_CHAT_RAID_WARNING,
+    LLM_CHAT_BATTLEGROUND,
+    LLM_CHAT_BATTLEGROUND_LEADER,
+    LLM_CHAT_GUILD,
+    LLM_CHAT_OFFICER,
+    LLM_CHAT_CHANNEL,
+    LLM_CHAT_OTHER,         // AFK, DND and the rest; answered in say
+    LLM_CHAT_TYPE_COUNT
+};
+
+enum LLMBalancerStrategy : uint8
+{
+    LLM_BALANCER_LEAST_OUTSTANDING = 0,     // Fewest requests in flight per unit of weight
+    LLM_BALANCER_EWMA              = 1,     // Lowest smoothed latency times requests in flight, per unit of weight
+};
+
+// Endpoint URL split into its connection parameters
+struct LLMEndpoint
+{
+    bool useSsl = false;
+    std::string host;
+    std::string port;
+    std::string target;
+
+    static bool Parse(std::string const& url, LLMEndpoint& endpoint);
+};
+
+// One "url|model|weight" entry of LLMChat.Endpoints
+struct LLMEndpointConfig
+{
+    std::string url;
+    LLMEndpoint endpoint;
+    std::string model;
+    uint32 weight = 1;
+};
+
+// The module's settings, parsed once from the .conf file. A published snapshot is never
+// modified: a reload builds a new one, and code still holding the previous one finishes
+// with it.
 struct LLMConfig
 {
     struct Chat
     {
-        bool Enable = true;
         bool Announce = true;
         bool LogBotDetection = true;  // Whether to log detailed bot detection info
         uint32_t ResponseCooldown = 1;   // Cooldown between responses in seconds
@@ -19,11 +85,13 @@ struct LLMConfig
 
     struct API
     {
-        std::string Endpoint = "http://localhost:11434/api/chat";
-        std::string Model = "mistral";
+        std::vector<LLMEndpointConfig> Endpoints;   // Valid entries only, in configured order
+        std::string Model = "mistral";              // For entries that name none
         std::string APIKey = "";
-        uint32_t MaxTokens = 100;
-        float Temperature = 0.7f;
+        uint32_t MaxTokens = 100;                   // num_predict of one reply; 0 for the backend's default
+        double Temperature = 0.7;
+        std::vector<std::string> StopSequences;     // Sent with single replies, not with JSON group replies
+        uint32_t PromptTokens = 1024;               // Prompt budget, further capped by the backend's context
     };
 
     struct Database
@@ -37,17 +105,204 @@ struct LLMConfig
         uint32_t LogLevel = 3;  // Set to maximum debug level
         bool LogToConsole = true;
         bool LogToFile = false;
-        std::string LogFile = "llm_chat.log";
+        std::string LogFile = "llm_chat.log";       // Resolved against the server's LogsDir
+        std::string TranscriptFile;                 // JSON Lines, one reply per line; empty for none
+        uint64 MaxFileSize = 10 * 1024 * 1024;      // Rotated past this size; 0 never rotates
+        uint32_t MaxFiles = 5;                      // Rotated files kept
+        uint32_t SampleEvery = 10;                  // Of the sampled debug lines, one in this many is logged
+        uint32_t QueueSize = 8192;                  // Lines waiting for the writer; sized at startup
+    };
+
+    // Shards, ShardCapacity and MailboxCapacity size the rings at startup; the rest is read per message
+    struct Queue
+    {
+        uint32_t Shards = 8;
+        uint32_t ShardCapacity = 1024;
+        uint32_t MailboxCapacity = 4096;
+        std::chrono::seconds ReportInterval{60};    // 0 never reports
+        bool Supersede = true;                      // A newer message drops the pending reply to an older one
+        bool Coalesce = true;
+        uint32_t CoalesceMaxSpeakers = 5;
+        uint32_t MaxResponses = 3;                  // Bots answering one message; 0 for no limit
+        uint32_t GlobalCooldown = 1000;             // ms per reply, all bots together
+        uint32_t GlobalBurst = 3;
+        uint32_t SenderBurst = 1;                   // Refilled by Chat.ResponseCooldown
+        uint32_t BotCooldown = 5000;                // ms per reply of one bot
+        uint32_t BotBurst = 1;
+    };
+
+    struct PriorityClass
+    {
+        uint32_t Capacity = 0;                      // Maximum queued messages of this class
+        std::chrono::milliseconds MaxAge{0};        // Older messages are dropped instead of dispatched
+        std::chrono::milliseconds Deadline{0};      // Queue wait plus generation; 0 for no limit
+        bool Hedge = false;                         // Race slow requests against a second backend
+    };
+
+    struct Priority
+    {
+        std::array<PriorityClass, LLM_PRIORITY_COUNT> Classes;   // Indexed by LLMChatPriority
+        uint32_t HighWaterMark = 256;               // Queued messages in all classes before shedding
+        LLMChatPriority ShedFrom = LLM_PRIORITY_LOCAL;
+        bool ShedWithTemplate = false;
+        uint32_t ReservedSlots = 4;                 // Engine slots kept for the classes above ShedFrom
+    };
+
+    struct Stream
+    {
+        bool Enable = true;
+        uint32_t MaxLineLength = 255;
+        uint32_t FirstLineDelay = 0;                // ms
+        uint32_t LineDelay = 2000;                  // ms
+    };
+
+    struct Cache
+    {
+        bool Enable = true;
+        size_t MaxBytes = 8 * 1024 * 1024;
+        uint32_t Variants = 3;
+        std::array<std::chrono::seconds, LLM_PRIORITY_COUNT> TTL{};    // Per class; 0 caches none
+    };
+
+    struct Similarity
+    {
+        bool Enable = true;
+        float Threshold = 0.9f;
+        uint32_t MaxDistance = 6;                   // Highest Hamming distance still counted as similar
+        uint32_t MinTokens = 3;                     // Shorter messages are left to the exact-match cache
+        uint32_t EntriesPerProfile = 32;
+        uint32_t MaxProfiles = 4096;
+        std::chrono::seconds TTL{600};
+    };
+
+    // Threads, MaxInFlight and InitialInFlight apply at startup; the rest is read per request
+    struct Engine
+    {
+        uint32_t Threads = 2;
+        uint32_t MaxInFlight = 64;
+        // Longest single phase of an exchange (resolve/connect, write, read, silence between
+        // streamed pieces); the request deadline may cut any of them shorter
+        std::chrono::milliseconds PhaseTimeout{30000};
+        uint32_t MaxResponseBytes = 4 * 1024 * 1024; // Largest response body read before the request fails
+        bool AdaptiveLimit = true;                  // Per-backend AIMD limit on requests in flight
+        uint32_t MinInFlight = 1;
+        uint32_t InitialInFlight = 8;
+        float LatencyTolerance = 2.0f;              // Latency above baseline * tolerance counts as queueing in the backend
+        float Backoff = 0.9f;                       // Factor the limit is cut by on overload
+        uint32_t BaselineWindow = 100;              // Samples after which the baseline is re-learnt
+    };
+
+    struct Balancer
+    {
+        LLMBalancerStrategy Strategy = LLM_BALANCER_LEAST_OUTSTANDING;
+        uint32_t EjectAfter = 3;                    // Consecutive failures; 0 never ejects
+        std::chrono::milliseconds EjectTime{10000};
+        std::chrono::milliseconds MaxEjectTime{120000};
+    };
+
+    struct Breaker
+    {
+        bool Enable = true;
+        uint32_t Window = 10;                       // Seconds; outcomes older than this no longer count
+        uint32_t MinRequests = 10;                  // Fewer outcomes in the window never trip it
+        float FailureRate = 0.5f;                   // Share of failed requests that opens it
+        std::chrono::milliseconds SlowCall{20000};  // Responses slower than this count as slow
+        float SlowCallRate = 0.8f;                  // Share of slow responses that opens it
+        std::chrono::milliseconds OpenDuration{15000};
+        uint32_t HalfOpenProbes = 2;                // Successful probes needed to close again
+    };
+
+    struct Hedge
+    {
+        float Percentile = 0.95f;                   // Share of recent first bytes that arrive before a hedge goes out
+        std::chrono::milliseconds MinDelay{1000};   // Never hedge sooner than this
+        uint32_t MinSamples = 20;                   // Fewer samples never hedge
+        float MaxRate = 0.05f;                      // Hedges per request, at most
+    };
+
+    struct Pool
+    {
+        uint32_t MaxIdle = 32;                      // Per endpoint
+        std::chrono::seconds IdleTimeout{30};
+        std::chrono::seconds DnsTtl{300};
+    };
+
+    struct Tls
+    {
+        bool Verify = true;
+        std::string CaFile;                         // Trusted on top of the system store
+    };
+
+    struct Warmup
+    {
+        bool Enable = true;
+        std::string Prompt = "Hello";
+        std::string KeepAlive = "30m";              // Sent with every Ollama request; empty for the server's default
+        std::chrono::seconds PingInterval{600};     // 0 never pings
+    };
+
+    struct Presence
+    {
+        std::chrono::milliseconds RefreshInterval{500};
+    };
+
+    struct Metrics
+    {
+        std::string File;                           // Prometheus text file; empty for none
+        std::chrono::seconds Interval{15};
+    };
+
+    // File starts the trace writer at startup; the rest is read per trace
+    struct Trace
+    {
+        std::string File;
+        double TailFraction = 0.01;                 // Slowest share of requests written in full
+        uint32_t SampleEvery = 10;                  // Of the rest, one in this many keeps its timings; 0 for none
+        uint64 MaxFileSize = 100 * 1024 * 1024;     // Started afresh past this size; 0 for no limit
     };
 
     Chat Chat;
     API API;
     Database Database;
     Logging Logging;
+    Queue Queue;
+    Priority Priority;
+    Stream Stream;
+    Cache Cache;
+    Similarity Similarity;
+    Engine Engine;
+    Balancer Balancer;
+    Breaker Breaker;
+    Hedge Hedge;
+    Pool Pool;
+    Tls Tls;
+    Warmup Warmup;
+    Presence Presence;
+    Metrics Metrics;
+    Trace Trace;
     bool Enable = true;
+    std::shared_ptr<LLMPromptTemplates const> Prompts;  // Compiled from LLMChat.Prompt.Directory
+
+    static std::shared_ptr<LLMConfig const> Load();
+    // Names the class in its LLMChat.Priority.* and LLMChat.Cache.*.TTL options and in the stats
+    static char const* GetPriorityClassName(LLMChatPriority priority);
+};
+
+// Publishes the current LLMConfig snapshot. Readers keep the snapshot they last saw in a
+// thread-local and only go back to the shared pointer after a reload, so reading settings
+// on a hot path never locks or parses anything.
+class LLMChatConfig
+{
+public:
+    // World thread: at startup and on .reload config
+    static void Load();
+    static std::shared_ptr<LLMConfig const> Get();
+
+private:
+    static std::atomic<std::shared_ptr<LLMConfig const>> s_config;
+    static std::atomic<uint32> s_generation;
 };
 
-// Global configuration instance
-extern LLMConfig LLM_Config;
+#define sLLMConfig LLMChatConfig::Get()
 
-#endif // MOD_LLM_CHAT_CONFIG_H 
\ No newline at end of file
+#endif // MOD_LLM_CHAT_CONFIG_H
@@ -6,45 +6,78 @@
 
 #include "mod-llm-chat-config.h"
 #include "LLMChatQueue.h"
+#include "LLMChatEngine.h"
 #include "LLMChatEvents.h"
+#include "LLMChatLogger.h"
+#include "LLMChatPresence.h"
+#include "LLMChatTrace.h"
+#include "LLMChatWarmup.h"
 #include "Config.h"
 #include "Log.h"
 #include "ScriptMgr.h"
 #include "World.h"
 #include "WorldSessionMgr.h"
 
-// Define the global configuration instance
-LLMConfig LLM_Config;
-
 class LLMChat : public WorldScript
 {
 public:
     LLMChat() : WorldScript("LLMChat") {}
 
+    void OnAfterConfigLoad(bool reload) override
+    {
+        // Settings read through the snapshot apply at once; the engine, queue and backends
+        // keep the sizes and endpoints they were started with
+        LLMChatConfig::Load();
+        if (reload)
+            LOG_INFO("module", "[LLMChat] Configuration reloaded");
+    }
+
     void OnStartup() override
     {
         LOG_INFO("module", "[LLMChat] Starting module...");
         
-        if (!LLM_Config.Enable)
+        if (!sLLMConfig->Enable)
         {
             LOG_INFO("module", "[LLMChat] Module is disabled in config");
             return;
         }
 
+        // Everything after this logs through the writer thread
+        LLMChatLogger::Initialize();
+        LLMChatTrace::Initialize();
+
+        // Start the request engine before the queue that feeds it
+        LLMChatEngine::Initialize();
+
         // Initialize the chat queue
         LLMChatQueue::Initialize();
 
-        if (LLM_Config.Chat.Announce)
+        // Load the models now rather than on the first player message
+        LLMChatWarmup::Initialize();
+
+        if (sLLMConfig->Chat.Announce)
         {
             LOG_INFO("module", "[LLMChat] Module started successfully");
             sWorldSessionMgr->SendServerMessage(SERVER_MSG_STRING, "LLM Chat module loaded");
         }
     }
 
+    void OnShutdown() override
+    {
+        LLMChatQueue::Shutdown();
+        LLMChatEngine::Shutdown();
+        // Last, so it writes out the requests the queue and the engine let go of
+        LLMChatTrace::Shutdown();
+        LLMChatLogger::Shutdown();
+    }
+
     void OnUpdate([[maybe_unused]] uint32 /*diff*/) override
     {
-        // No need for timer-based queue processing anymore
-        // Queue is processed by worker thread
+        // Generation runs off the world thread; players' whereabouts are sampled and
+        // finished replies are posted here
+        LLMChatPresence::Update();
+        LLMChatQueue::ProcessCompletions();
+        LLMChatWarmup::Update();
     }
 };
 
@@ -68,16 +101,19 @@ public:
 
     void OnPlayerChat(Player* player, uint32 type, uint32 lang, std::string& msg) override
     {
-        if (!LLM_Config.Enable || !chatEvents)
+        if (!sLLMConfig->Enable || !chatEvents)
             return;
 
         chatEvents->OnPlayerChat(player, type, lang, msg);
     }
 };
 
+void AddLLMChatCommandScripts();
+
 // Add all scripts
 void Addmod_llm_chatScripts()
 {
     new LLMChat();
     new LLMChatPlayerScript();
+    AddLLMChatCommandScripts();
 } 